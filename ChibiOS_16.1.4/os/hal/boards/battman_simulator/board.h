@@ -0,0 +1,89 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+#ifndef _BOARD_H_
+#define _BOARD_H_
+
+/*
+ * Setup for the BattMan running on the Linux simulator.
+ * The two virtual I/O ports stand for GPIOA and GPIOB, pad numbers are the
+ * same of the real board.
+ */
+
+/*
+ * Board identifier.
+ */
+#define BOARD_BATTMAN_SIMULATOR
+#define BOARD_NAME                  "BattMan simulator"
+
+/*
+ * GPIO ports.
+ */
+#define GPIOA                       IOPORT1
+#define GPIOB                       IOPORT2
+
+/*
+ * Initial input levels, the inputs not listed here read low.
+ */
+#define VAL_GPIOA_PIN               0x00000000
+#define VAL_GPIOB_PIN               ((1U << 7) |    /* RTCC_INT, idle.      */\
+                                     (1U << 12))    /* CURR_ALERT, idle.    */
+
+/*
+ * STM32 specific PAL modes used by the application, the virtual ports have
+ * no alternate functions nor electrical settings.
+ */
+#define PAL_MODE_ALTERNATE(n)       PAL_MODE_RESET
+#define PAL_STM32_OTYPE_PUSHPULL    0U
+#define PAL_STM32_OTYPE_OPENDRAIN   0U
+#define PAL_STM32_OSPEED_LOWEST     0U
+#define PAL_STM32_OSPEED_MID1       0U
+#define PAL_STM32_OSPEED_MID2       0U
+#define PAL_STM32_OSPEED_HIGHEST    0U
+#define PAL_STM32_PUPDR_FLOATING    0U
+#define PAL_STM32_PUPDR_PULLUP      0U
+#define PAL_STM32_PUPDR_PULLDOWN    0U
+
+/*
+ * STM32 peripheral register bits used in the drivers configurations, the
+ * simulated drivers ignore them.
+ */
+#define SPI_CR1_CPHA                (1U << 0)
+#define SPI_CR1_CPOL                (1U << 1)
+#define SPI_CR1_BR_0                (1U << 3)
+#define SPI_CR1_BR_1                (1U << 4)
+#define SPI_CR1_BR_2                (1U << 5)
+#define SPI_CR2_DS_0                (1U << 8)
+#define SPI_CR2_DS_1                (1U << 9)
+#define SPI_CR2_DS_2                (1U << 10)
+#define SPI_CR2_DS_3                (1U << 11)
+
+#define CAN_MCR_TXFP                (1U << 2)
+#define CAN_MCR_AWUM                (1U << 5)
+#define CAN_MCR_ABOM                (1U << 6)
+
+#if !defined(_FROM_ASM_)
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void boardInit(void);
+  void sim_board_init(void);
+#ifdef __cplusplus
+}
+#endif
+#endif /* _FROM_ASM_ */
+
+#endif /* _BOARD_H_ */
@@ -0,0 +1,5 @@
+# List of all the BattMan simulator board related files.
+BOARDSRC = ${CHIBIOS}/os/hal/boards/battman_simulator/board.c
+
+# Required include directories
+BOARDINC = ${CHIBIOS}/os/hal/boards/battman_simulator
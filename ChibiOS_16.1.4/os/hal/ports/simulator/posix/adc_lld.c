@@ -0,0 +1,281 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    adc_lld.c
+ * @brief   Posix simulator ADC subsystem low level driver source.
+ *
+ * @addtogroup POSIX_ADC
+ * @{
+ */
+
+#include "hal.h"
+
+#if HAL_USE_ADC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief ADC1 driver identifier.*/
+#if SIM_ADC_USE_ADC1 || defined(__DOXYGEN__)
+ADCDriver ADCD1;
+#endif
+
+/** @brief ADC2 driver identifier.*/
+#if SIM_ADC_USE_ADC2 || defined(__DOXYGEN__)
+ADCDriver ADCD2;
+#endif
+
+/** @brief ADC3 driver identifier.*/
+#if SIM_ADC_USE_ADC3 || defined(__DOXYGEN__)
+ADCDriver ADCD3;
+#endif
+
+/** @brief ADC4 driver identifier.*/
+#if SIM_ADC_USE_ADC4 || defined(__DOXYGEN__)
+ADCDriver ADCD4;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void init_driver(ADCDriver *adcp) {
+
+  adcObjectInit(adcp);
+  adcp->model   = NULL;
+  adcp->pending = false;
+}
+
+/**
+ * @brief   Decodes the n-th channel of the regular sequence.
+ */
+static uint32_t sequence_channel(const ADCConversionGroup *grpp, unsigned n) {
+
+  /* SQR1 holds the sequence length in its first slot, SQ1..SQ4 follow.*/
+  n++;
+  return (grpp->sqr[n / 5U] >> ((n % 5U) * 6U)) & 0x1FU;
+}
+
+/**
+ * @brief   Checks a sample against the analog watchdog 1 window.
+ *
+ * @return              @p true if the watchdog is triggered.
+ */
+static bool awd1_triggered(const ADCConversionGroup *grpp,
+                           uint32_t channel, adcsample_t s) {
+
+  if ((grpp->cfgr & ADC_CFGR_AWD1_ALL) == 0U)
+    return false;
+  if (((grpp->cfgr & (1U << 22)) != 0U) &&
+      (((grpp->cfgr >> 26) & 0x1FU) != channel))
+    return false;
+  return (s < (grpp->tr1 & 0xFFFU)) || (s > ((grpp->tr1 >> 16) & 0xFFFU));
+}
+
+/**
+ * @brief   Fills the buffer with the samples of the model.
+ *
+ * @return              @p true if the analog watchdog 1 is triggered, the
+ *                      buffer is filled up to the triggering sample.
+ */
+static bool fill_buffer(ADCDriver *adcp) {
+  const ADCConversionGroup *grpp = adcp->grpp;
+  size_t i;
+  unsigned ch;
+
+  for (i = 0; i < adcp->depth; i++) {
+    for (ch = 0; ch < grpp->num_channels; ch++) {
+      uint32_t channel = sequence_channel(grpp, ch);
+      adcsample_t s = 0;
+      if ((adcp->model != NULL) && (adcp->model->sample != NULL))
+        s = adcp->model->sample(adcp, channel);
+      adcp->samples[i * grpp->num_channels + ch] = s & 0xFFFU;
+      if (awd1_triggered(grpp, channel, s & 0xFFFU))
+        return true;
+    }
+  }
+  return false;
+}
+
+static bool serve_interrupt(ADCDriver *adcp) {
+  systime_t now;
+
+  if (!adcp->pending)
+    return false;
+
+  if (adcp->grpp->circular) {
+    /* A circular group is refilled once per system tick, the real
+       hardware would keep the bus busy continuously.*/
+    now = osalOsGetSystemTimeX();
+    if (now == adcp->last)
+      return false;
+    adcp->last = now;
+
+    if (fill_buffer(adcp)) {
+      _adc_isr_error_code(adcp, ADC_ERR_AWD1);
+      return true;
+    }
+    if (adcp->depth > 1)
+      _adc_isr_half_code(adcp);
+    _adc_isr_full_code(adcp);
+  }
+  else {
+    adcp->pending = false;
+    if (fill_buffer(adcp)) {
+      _adc_isr_error_code(adcp, ADC_ERR_AWD1);
+      return true;
+    }
+    _adc_isr_full_code(adcp);
+  }
+
+  return true;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level ADC driver initialization.
+ *
+ * @notapi
+ */
+void adc_lld_init(void) {
+
+#if SIM_ADC_USE_ADC1
+  init_driver(&ADCD1);
+#endif
+#if SIM_ADC_USE_ADC2
+  init_driver(&ADCD2);
+#endif
+#if SIM_ADC_USE_ADC3
+  init_driver(&ADCD3);
+#endif
+#if SIM_ADC_USE_ADC4
+  init_driver(&ADCD4);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the ADC peripheral.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_start(ADCDriver *adcp) {
+
+  adcp->pending = false;
+}
+
+/**
+ * @brief   Deactivates the ADC peripheral.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_stop(ADCDriver *adcp) {
+
+  adcp->pending = false;
+}
+
+/**
+ * @brief   Starts an ADC conversion.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_start_conversion(ADCDriver *adcp) {
+
+  adcp->last    = osalOsGetSystemTimeX() - 1;
+  adcp->pending = true;
+}
+
+/**
+ * @brief   Stops an ongoing conversion.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ *
+ * @notapi
+ */
+void adc_lld_stop_conversion(ADCDriver *adcp) {
+
+  adcp->pending = false;
+}
+
+/**
+ * @brief   ADC interrupt simulation.
+ * @details Fills the buffers of the active conversions from the attached
+ *          analog front ends.
+ *
+ * @return              @p true if an interrupt has been served.
+ *
+ * @notapi
+ */
+bool adc_lld_interrupt_pending(void) {
+  bool b = false;
+
+  CH_IRQ_PROLOGUE();
+
+#if SIM_ADC_USE_ADC1
+  b = serve_interrupt(&ADCD1) || b;
+#endif
+#if SIM_ADC_USE_ADC2
+  b = serve_interrupt(&ADCD2) || b;
+#endif
+#if SIM_ADC_USE_ADC3
+  b = serve_interrupt(&ADCD3) || b;
+#endif
+#if SIM_ADC_USE_ADC4
+  b = serve_interrupt(&ADCD4) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+/**
+ * @brief   Attaches an analog front end model to an ADC.
+ *
+ * @param[in] adcp      pointer to the @p ADCDriver object
+ * @param[in] model     pointer to the model or @p NULL to detach
+ *
+ * @api
+ */
+void adcSimSetModel(ADCDriver *adcp, const ADCSimModel *model) {
+
+  adcp->model = model;
+}
+
+#endif /* HAL_USE_ADC */
+
+/** @} */
@@ -0,0 +1,304 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    can_lld.c
+ * @brief   Posix simulator CAN subsystem low level driver source.
+ *
+ * @addtogroup POSIX_CAN
+ * @{
+ */
+
+#include "hal.h"
+
+#if HAL_USE_CAN || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief CAN1 driver identifier.*/
+#if SIM_CAN_USE_CAN1 || defined(__DOXYGEN__)
+CANDriver CAND1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void init_driver(CANDriver *canp) {
+
+  canObjectInit(canp);
+  canp->model     = NULL;
+  canp->txcnt     = 0;
+  canp->rxrd      = 0;
+  canp->rxcnt     = 0;
+  canp->rxpending = false;
+}
+
+static bool serve_interrupt(CANDriver *canp) {
+  bool b = false;
+  unsigned i;
+
+  osalSysLockFromISR();
+
+  if (canp->txcnt > 0) {
+    /* The mailboxes are emptied in order, one bus slot each.*/
+    for (i = 0; i < canp->txcnt; i++) {
+      if ((canp->model != NULL) && (canp->model->transmit != NULL))
+        canp->model->transmit(canp, &canp->txbuf[i]);
+    }
+    canp->txcnt = 0;
+    osalThreadDequeueAllI(&canp->txqueue, MSG_OK);
+    osalEventBroadcastFlagsI(&canp->txempty_event,
+                             CAN_MAILBOX_TO_MASK(1U) |
+                             CAN_MAILBOX_TO_MASK(2U) |
+                             CAN_MAILBOX_TO_MASK(3U));
+    b = true;
+  }
+
+  if (canp->rxpending) {
+    canp->rxpending = false;
+    osalThreadDequeueAllI(&canp->rxqueue, MSG_OK);
+    osalEventBroadcastFlagsI(&canp->rxfull_event, CAN_MAILBOX_TO_MASK(1U));
+    b = true;
+  }
+
+  osalSysUnlockFromISR();
+
+  return b;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level CAN driver initialization.
+ *
+ * @notapi
+ */
+void can_lld_init(void) {
+
+#if SIM_CAN_USE_CAN1
+  init_driver(&CAND1);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the CAN peripheral.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_start(CANDriver *canp) {
+
+  canp->txcnt     = 0;
+  canp->rxrd      = 0;
+  canp->rxcnt     = 0;
+  canp->rxpending = false;
+}
+
+/**
+ * @brief   Deactivates the CAN peripheral.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_stop(CANDriver *canp) {
+
+  canp->txcnt     = 0;
+  canp->rxcnt     = 0;
+  canp->rxpending = false;
+}
+
+/**
+ * @brief   Determines whether a frame can be transmitted.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] mailbox   mailbox number, @p CAN_ANY_MAILBOX for any mailbox
+ *
+ * @return              The queue space availability.
+ * @retval FALSE        no space in the transmit queue.
+ * @retval TRUE         transmit slot available.
+ *
+ * @notapi
+ */
+bool can_lld_is_tx_empty(CANDriver *canp, canmbx_t mailbox) {
+
+  (void)mailbox;
+
+  return canp->txcnt < CAN_TX_MAILBOXES;
+}
+
+/**
+ * @brief   Inserts a frame into the transmit queue.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] ctfp      pointer to the CAN frame to be transmitted
+ * @param[in] mailbox   mailbox number,  @p CAN_ANY_MAILBOX for any mailbox
+ *
+ * @notapi
+ */
+void can_lld_transmit(CANDriver *canp,
+                      canmbx_t mailbox,
+                      const CANTxFrame *ctfp) {
+
+  (void)mailbox;
+
+  canp->txbuf[canp->txcnt++] = *ctfp;
+}
+
+/**
+ * @brief   Determines whether a frame has been received.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] mailbox   mailbox number, @p CAN_ANY_MAILBOX for any mailbox
+ *
+ * @return              The queue space availability.
+ * @retval FALSE        no space in the transmit queue.
+ * @retval TRUE         transmit slot available.
+ *
+ * @notapi
+ */
+bool can_lld_is_rx_nonempty(CANDriver *canp, canmbx_t mailbox) {
+
+  (void)mailbox;
+
+  return canp->rxcnt > 0;
+}
+
+/**
+ * @brief   Receives a frame from the input queue.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] mailbox   mailbox number, @p CAN_ANY_MAILBOX for any mailbox
+ * @param[out] crfp     pointer to the buffer where the CAN frame is copied
+ *
+ * @notapi
+ */
+void can_lld_receive(CANDriver *canp,
+                     canmbx_t mailbox,
+                     CANRxFrame *crfp) {
+
+  (void)mailbox;
+
+  *crfp = canp->rxbuf[canp->rxrd];
+  canp->rxrd = (canp->rxrd + 1U) % SIM_CAN_RX_FIFO_SIZE;
+  canp->rxcnt--;
+}
+
+#if CAN_USE_SLEEP_MODE || defined(__DOXYGEN__)
+/**
+ * @brief   Enters the sleep mode.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_sleep(CANDriver *canp) {
+
+  (void)canp;
+}
+
+/**
+ * @brief   Enforces leaving the sleep mode.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ *
+ * @notapi
+ */
+void can_lld_wakeup(CANDriver *canp) {
+
+  (void)canp;
+}
+#endif /* CAN_USE_SLEEP_MODE */
+
+/**
+ * @brief   CAN interrupt simulation.
+ * @details Hands the queued frames to the bus model and signals the frames
+ *          received from it.
+ *
+ * @return              @p true if an interrupt has been served.
+ *
+ * @notapi
+ */
+bool can_lld_interrupt_pending(void) {
+  bool b = false;
+
+  CH_IRQ_PROLOGUE();
+
+#if SIM_CAN_USE_CAN1
+  b = serve_interrupt(&CAND1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+/**
+ * @brief   Attaches a bus model to the simulated controller.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] model     pointer to the model or @p NULL to detach
+ *
+ * @api
+ */
+void canSimSetModel(CANDriver *canp, const CANSimModel *model) {
+
+  canp->model = model;
+}
+
+/**
+ * @brief   Puts a frame in the receive FIFO as if it came from the bus.
+ * @details The receive event is raised on the next simulated interrupt.
+ *
+ * @param[in] canp      pointer to the @p CANDriver object
+ * @param[in] crfp      pointer to the frame
+ * @return              @p false if the frame has been lost because the FIFO
+ *                      is full.
+ *
+ * @iclass
+ */
+bool canSimInjectI(CANDriver *canp, const CANRxFrame *crfp) {
+
+  if ((canp->state != CAN_READY) || (canp->rxcnt >= SIM_CAN_RX_FIFO_SIZE))
+    return false;
+
+  canp->rxbuf[(canp->rxrd + canp->rxcnt) % SIM_CAN_RX_FIFO_SIZE] = *crfp;
+  canp->rxcnt++;
+  canp->rxpending = true;
+
+  return true;
+}
+
+#endif /* HAL_USE_CAN */
+
+/** @} */
@@ -0,0 +1,308 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    can_lld.h
+ * @brief   Posix simulator CAN subsystem low level driver header.
+ *
+ * @addtogroup POSIX_CAN
+ * @{
+ */
+
+#ifndef _CAN_LLD_H_
+#define _CAN_LLD_H_
+
+#if HAL_USE_CAN || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Number of transmit mailboxes.
+ */
+#define CAN_TX_MAILBOXES            3
+
+/**
+ * @brief   Number of receive mailboxes.
+ */
+#define CAN_RX_MAILBOXES            1
+
+/**
+ * @name    CAN registers helper macros
+ * @note    Same encoding of the STM32 CANv1 driver, the bit timing is
+ *          ignored by the simulated bus.
+ * @{
+ */
+#define CAN_BTR_BRP(n)              (n)         /**< @brief BRP field macro.*/
+#define CAN_BTR_TS1(n)              ((n) << 16) /**< @brief TS1 field macro.*/
+#define CAN_BTR_TS2(n)              ((n) << 20) /**< @brief TS2 field macro.*/
+#define CAN_BTR_SJW(n)              ((n) << 24) /**< @brief SJW field macro.*/
+
+#define CAN_IDE_STD                 0           /**< @brief Standard id.    */
+#define CAN_IDE_EXT                 1           /**< @brief Extended id.    */
+
+#define CAN_RTR_DATA                0           /**< @brief Data frame.     */
+#define CAN_RTR_REMOTE              1           /**< @brief Remote frame.   */
+/** @} */
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    Configuration options
+ * @{
+ */
+/**
+ * @brief   CAN1 driver enable switch.
+ * @details If set to @p TRUE the support for CAN1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(SIM_CAN_USE_CAN1) || defined(__DOXYGEN__)
+#define SIM_CAN_USE_CAN1                    TRUE
+#endif
+
+/**
+ * @brief   Depth of the simulated receive FIFO.
+ */
+#if !defined(SIM_CAN_RX_FIFO_SIZE) || defined(__DOXYGEN__)
+#define SIM_CAN_RX_FIFO_SIZE                16
+#endif
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a transmission mailbox index.
+ */
+typedef uint32_t canmbx_t;
+
+/**
+ * @brief   CAN transmission frame.
+ * @note    Accessing the frame data as word16 or word32 is not portable because
+ *          machine data endianness, it can be still useful for a quick filling.
+ */
+typedef struct {
+  /*lint -save -e46 [6.1] Standard types are fine too.*/
+  uint8_t                   DLC:4;          /**< @brief Data length.        */
+  uint8_t                   RTR:1;          /**< @brief Frame type.         */
+  uint8_t                   IDE:1;          /**< @brief Identifier type.    */
+  union {
+    uint32_t                SID:11;         /**< @brief Standard identifier.*/
+    uint32_t                EID:29;         /**< @brief Extended identifier.*/
+    uint32_t                _align1;
+  };
+  /*lint -restore*/
+  union {
+    uint8_t                 data8[8];       /**< @brief Frame data.         */
+    uint16_t                data16[4];      /**< @brief Frame data.         */
+    uint32_t                data32[2];      /**< @brief Frame data.         */
+  };
+} CANTxFrame;
+
+/**
+ * @brief   CAN received frame.
+ * @note    Accessing the frame data as word16 or word32 is not portable because
+ *          machine data endianness, it can be still useful for a quick filling.
+ */
+typedef struct {
+  /*lint -save -e46 [6.1] Standard types are fine too.*/
+  uint8_t                   FMI;            /**< @brief Filter id.          */
+  uint16_t                  TIME;           /**< @brief Time stamp.         */
+  uint8_t                   DLC:4;          /**< @brief Data length.        */
+  uint8_t                   RTR:1;          /**< @brief Frame type.         */
+  uint8_t                   IDE:1;          /**< @brief Identifier type.    */
+  union {
+    uint32_t                SID:11;         /**< @brief Standard identifier.*/
+    uint32_t                EID:29;         /**< @brief Extended identifier.*/
+    uint32_t                _align1;
+  };
+  /*lint -restore*/
+  union {
+    uint8_t                 data8[8];       /**< @brief Frame data.         */
+    uint16_t                data16[4];      /**< @brief Frame data.         */
+    uint32_t                data32[2];      /**< @brief Frame data.         */
+  };
+} CANRxFrame;
+
+/**
+ * @brief   Driver configuration structure.
+ * @note    Same layout of the STM32 CANv1 driver, the fields are ignored.
+ */
+typedef struct {
+  /**
+   * @brief   CAN MCR register initialization data.
+   */
+  uint32_t                  mcr;
+  /**
+   * @brief   CAN BTR register initialization data.
+   */
+  uint32_t                  btr;
+} CANConfig;
+
+/**
+ * @brief   Type of a structure representing an CAN driver.
+ */
+typedef struct CANDriver CANDriver;
+
+/**
+ * @brief   Simulated bus, the rest of the network as seen by the node.
+ */
+typedef struct {
+  /**
+   * @brief   Frame put on the bus by the node, can be @p NULL.
+   * @note    Called from the simulated interrupt, replies can be queued
+   *          using @p canSimInjectI().
+   */
+  void                      (*transmit)(CANDriver *canp,
+                                        const CANTxFrame *ctfp);
+} CANSimModel;
+
+/**
+ * @brief   Structure representing an CAN driver.
+ */
+struct CANDriver {
+  /**
+   * @brief   Driver state.
+   */
+  canstate_t                state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const CANConfig           *config;
+  /**
+   * @brief   Transmission threads queue.
+   */
+  threads_queue_t           txqueue;
+  /**
+   * @brief   Receive threads queue.
+   */
+  threads_queue_t           rxqueue;
+  /**
+   * @brief   One or more frames become available.
+   * @note    After broadcasting this event it will not be broadcasted again
+   *          until the received frames queue has been completely emptied. It
+   *          is <b>not</b> broadcasted for each received frame. It is
+   *          responsibility of the application to empty the queue by
+   *          repeatedly invoking @p chReceive() when listening to this event.
+   *          This behavior minimizes the interrupt served by the system
+   *          because CAN traffic.
+   * @note    The flags associated to the listeners will indicate which
+   *          receive mailboxes become non-empty.
+   */
+  event_source_t            rxfull_event;
+  /**
+   * @brief   One or more transmission mailbox become available.
+   * @note    The flags associated to the listeners will indicate which
+   *          transmit mailboxes become empty.
+   *
+   */
+  event_source_t            txempty_event;
+  /**
+   * @brief   A CAN bus error happened.
+   * @note    The flags associated to the listeners will indicate the
+   *          error(s) that have occurred.
+   */
+  event_source_t            error_event;
+#if CAN_USE_SLEEP_MODE || defined(__DOXYGEN__)
+  /**
+   * @brief   Entering sleep state event.
+   */
+  event_source_t            sleep_event;
+  /**
+   * @brief   Exiting sleep state event.
+   */
+  event_source_t            wakeup_event;
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Attached bus model or @p NULL.
+   */
+  const CANSimModel         *model;
+  /**
+   * @brief   Frames waiting to be put on the bus.
+   */
+  CANTxFrame                txbuf[CAN_TX_MAILBOXES];
+  /**
+   * @brief   Number of frames in @p txbuf.
+   */
+  unsigned                  txcnt;
+  /**
+   * @brief   Receive FIFO.
+   */
+  CANRxFrame                rxbuf[SIM_CAN_RX_FIFO_SIZE];
+  /**
+   * @brief   Receive FIFO read index.
+   */
+  unsigned                  rxrd;
+  /**
+   * @brief   Number of frames in the receive FIFO.
+   */
+  unsigned                  rxcnt;
+  /**
+   * @brief   Frames have been received since the last interrupt.
+   */
+  bool                      rxpending;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_CAN_USE_CAN1 && !defined(__DOXYGEN__)
+extern CANDriver CAND1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void can_lld_init(void);
+  void can_lld_start(CANDriver *canp);
+  void can_lld_stop(CANDriver *canp);
+  bool can_lld_is_tx_empty(CANDriver *canp, canmbx_t mailbox);
+  void can_lld_transmit(CANDriver *canp,
+                        canmbx_t mailbox,
+                        const CANTxFrame *ctfp);
+  bool can_lld_is_rx_nonempty(CANDriver *canp, canmbx_t mailbox);
+  void can_lld_receive(CANDriver *canp,
+                       canmbx_t mailbox,
+                       CANRxFrame *crfp);
+#if CAN_USE_SLEEP_MODE
+  void can_lld_sleep(CANDriver *canp);
+  void can_lld_wakeup(CANDriver *canp);
+#endif
+  bool can_lld_interrupt_pending(void);
+  void canSimSetModel(CANDriver *canp, const CANSimModel *model);
+  bool canSimInjectI(CANDriver *canp, const CANRxFrame *crfp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_CAN */
+
+#endif /* _CAN_LLD_H_ */
+
+/** @} */
@@ -0,0 +1,224 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    ext_lld.c
+ * @brief   Posix simulator EXT subsystem low level driver source.
+ *
+ * @addtogroup POSIX_EXT
+ * @{
+ */
+
+#include "hal.h"
+
+#if HAL_USE_EXT || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   EXTD1 driver identifier.
+ */
+#if SIM_EXT_USE_EXT1 || defined(__DOXYGEN__)
+EXTDriver EXTD1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Samples the line of an EXT channel.
+ */
+static bool read_line(EXTDriver *extp, expchannel_t channel) {
+  ioportid_t port;
+
+  switch (extp->config->channels[channel].mode & EXT_MODE_GPIO_MASK) {
+  case EXT_MODE_GPIOB:
+    port = IOPORT2;
+    break;
+  default:
+    port = IOPORT1;
+    break;
+  }
+
+  return (palReadPort(port) & PAL_PORT_BIT(channel)) != 0U;
+}
+
+static uint32_t read_levels(EXTDriver *extp) {
+  uint32_t levels = 0;
+  expchannel_t channel;
+
+  for (channel = 0; channel < PAL_IOPORTS_WIDTH; channel++) {
+    if (((extp->enabled >> channel) & 1U) && read_line(extp, channel))
+      levels |= 1U << channel;
+  }
+
+  return levels;
+}
+
+static bool serve_interrupt(EXTDriver *extp) {
+  uint32_t levels, changed;
+  expchannel_t channel;
+  bool b = false;
+
+  if (extp->state != EXT_ACTIVE)
+    return false;
+
+  levels = read_levels(extp);
+  changed = levels ^ extp->levels;
+  extp->levels = levels;
+
+  for (channel = 0; changed != 0U; channel++, changed >>= 1) {
+    const EXTChannelConfig *chcfg = &extp->config->channels[channel];
+    bool rising = ((levels >> channel) & 1U) != 0U;
+
+    if (!(changed & 1U) || (chcfg->cb == NULL))
+      continue;
+
+    if ((rising && (chcfg->mode & EXT_CH_MODE_RISING_EDGE)) ||
+        (!rising && (chcfg->mode & EXT_CH_MODE_FALLING_EDGE))) {
+      chcfg->cb(extp, channel);
+      b = true;
+    }
+  }
+
+  return b;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level EXT driver initialization.
+ *
+ * @notapi
+ */
+void ext_lld_init(void) {
+
+#if SIM_EXT_USE_EXT1
+  extObjectInit(&EXTD1);
+  EXTD1.enabled = 0;
+  EXTD1.levels  = 0;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the EXT peripheral.
+ *
+ * @param[in] extp      pointer to the @p EXTDriver object
+ *
+ * @notapi
+ */
+void ext_lld_start(EXTDriver *extp) {
+  expchannel_t channel;
+
+  extp->enabled = 0;
+  for (channel = 0; channel < PAL_IOPORTS_WIDTH; channel++) {
+    if (extp->config->channels[channel].mode & EXT_CH_MODE_AUTOSTART)
+      extp->enabled |= 1U << channel;
+  }
+  extp->levels = read_levels(extp);
+}
+
+/**
+ * @brief   Deactivates the EXT peripheral.
+ *
+ * @param[in] extp      pointer to the @p EXTDriver object
+ *
+ * @notapi
+ */
+void ext_lld_stop(EXTDriver *extp) {
+
+  extp->enabled = 0;
+}
+
+/**
+ * @brief   Enables an EXT channel.
+ *
+ * @param[in] extp      pointer to the @p EXTDriver object
+ * @param[in] channel   channel to be enabled
+ *
+ * @notapi
+ */
+void ext_lld_channel_enable(EXTDriver *extp, expchannel_t channel) {
+
+  if (channel >= PAL_IOPORTS_WIDTH)
+    return;
+
+  extp->enabled |= 1U << channel;
+  if (read_line(extp, channel))
+    extp->levels |= 1U << channel;
+  else
+    extp->levels &= ~(1U << channel);
+}
+
+/**
+ * @brief   Disables an EXT channel.
+ *
+ * @param[in] extp      pointer to the @p EXTDriver object
+ * @param[in] channel   channel to be disabled
+ *
+ * @notapi
+ */
+void ext_lld_channel_disable(EXTDriver *extp, expchannel_t channel) {
+
+  if (channel >= PAL_IOPORTS_WIDTH)
+    return;
+
+  extp->enabled &= ~(1U << channel);
+  extp->levels  &= ~(1U << channel);
+}
+
+/**
+ * @brief   EXT interrupt simulation.
+ * @details Invokes the callbacks of the channels whose line changed level
+ *          in the configured direction.
+ *
+ * @return              @p true if an interrupt has been served.
+ *
+ * @notapi
+ */
+bool ext_lld_interrupt_pending(void) {
+  bool b = false;
+
+  CH_IRQ_PROLOGUE();
+
+#if SIM_EXT_USE_EXT1
+  b = serve_interrupt(&EXTD1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+#endif /* HAL_USE_EXT */
+
+/** @} */
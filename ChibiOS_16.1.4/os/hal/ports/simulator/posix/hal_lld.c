@@ -0,0 +1,145 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    hal_lld.c
+ * @brief   Posix simulator HAL subsystem low level driver code.
+ *
+ * @addtogroup POSIX_HAL
+ * @{
+ */
+
+#include <time.h>
+
+#include "hal.h"
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+static uint64_t nextcnt;
+static uint64_t slice;
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static uint64_t get_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief Low level HAL driver initialization.
+ */
+void hal_lld_init(void) {
+
+  printf("ChibiOS/RT simulator (Linux)\n");
+  slice = 1000000000ULL / CH_CFG_ST_FREQUENCY;
+  nextcnt = get_ns() + slice;
+
+  fflush(stdout);
+}
+
+/**
+ * @brief   Interrupt simulation.
+ * @details Serves, in order, the simulated peripherals with a completed
+ *          operation and then the system tick. When nothing is pending the
+ *          host thread sleeps until the next tick so that an idle firmware
+ *          does not consume a whole host core.
+ */
+void _sim_check_for_interrupts(void) {
+  bool int_occurred = false;
+  uint64_t n;
+
+#if HAL_USE_SERIAL
+  if (sd_lld_interrupt_pending()) {
+    int_occurred = true;
+  }
+#endif
+#if HAL_USE_SPI
+  if (spi_lld_interrupt_pending()) {
+    int_occurred = true;
+  }
+#endif
+#if HAL_USE_I2C
+  if (i2c_lld_interrupt_pending()) {
+    int_occurred = true;
+  }
+#endif
+#if HAL_USE_ADC
+  if (adc_lld_interrupt_pending()) {
+    int_occurred = true;
+  }
+#endif
+#if HAL_USE_CAN
+  if (can_lld_interrupt_pending()) {
+    int_occurred = true;
+  }
+#endif
+#if HAL_USE_EXT
+  if (ext_lld_interrupt_pending()) {
+    int_occurred = true;
+  }
+#endif
+
+  /* Interrupt Timer simulation.*/
+  n = get_ns();
+  if (n >= nextcnt) {
+    nextcnt += slice;
+
+    CH_IRQ_PROLOGUE();
+
+    chSysLockFromISR();
+    chSysTimerHandlerI();
+    chSysUnlockFromISR();
+
+    CH_IRQ_EPILOGUE();
+
+    int_occurred = true;
+  }
+  else if (!int_occurred) {
+    struct timespec ts;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long)(nextcnt - n);
+    nanosleep(&ts, NULL);
+  }
+
+  if (int_occurred) {
+    _dbg_check_lock();
+    if (chSchIsPreemptionRequired())
+      chSchDoReschedule();
+    _dbg_check_unlock();
+  }
+}
+
+/** @} */
@@ -0,0 +1,256 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    i2c_lld.c
+ * @brief   Posix simulator I2C subsystem low level driver source.
+ *
+ * @addtogroup POSIX_I2C
+ * @{
+ */
+
+#include "hal.h"
+
+#if HAL_USE_I2C || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief I2C1 driver identifier.*/
+#if SIM_I2C_USE_I2C1 || defined(__DOXYGEN__)
+I2CDriver I2CD1;
+#endif
+
+/** @brief I2C2 driver identifier.*/
+#if SIM_I2C_USE_I2C2 || defined(__DOXYGEN__)
+I2CDriver I2CD2;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void init_driver(I2CDriver *i2cp) {
+
+  i2cObjectInit(i2cp);
+  i2cp->thread  = NULL;
+  i2cp->devices = NULL;
+  i2cp->pending = false;
+}
+
+static msg_t start_transaction(I2CDriver *i2cp, i2caddr_t addr,
+                               const uint8_t *txbuf, size_t txbytes,
+                               uint8_t *rxbuf, size_t rxbytes,
+                               systime_t timeout) {
+  msg_t msg;
+
+  i2cp->addr    = addr;
+  i2cp->txbuf   = txbuf;
+  i2cp->txbytes = txbytes;
+  i2cp->rxbuf   = rxbuf;
+  i2cp->rxbytes = rxbytes;
+  i2cp->pending = true;
+
+  msg = osalThreadSuspendTimeoutS(&i2cp->thread, timeout);
+
+  /* On timeout the transaction is abandoned.*/
+  i2cp->pending = false;
+
+  return msg;
+}
+
+static bool serve_interrupt(I2CDriver *i2cp) {
+  I2CSimDevice *devp;
+  msg_t msg;
+
+  if (!i2cp->pending)
+    return false;
+
+  i2cp->pending = false;
+  devp = i2cp->devices;
+  while ((devp != NULL) && (devp->addr != i2cp->addr))
+    devp = devp->next;
+
+  if (devp == NULL)
+    msg = MSG_RESET;
+  else
+    msg = devp->transfer(devp, i2cp->txbuf, i2cp->txbytes,
+                         i2cp->rxbuf, i2cp->rxbytes);
+
+  if (msg != MSG_OK) {
+    i2cp->errors |= I2C_ACK_FAILURE;
+    _i2c_wakeup_error_isr(i2cp);
+  }
+  else {
+    _i2c_wakeup_isr(i2cp);
+  }
+
+  return true;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level I2C driver initialization.
+ *
+ * @notapi
+ */
+void i2c_lld_init(void) {
+
+#if SIM_I2C_USE_I2C1
+  init_driver(&I2CD1);
+#endif
+#if SIM_I2C_USE_I2C2
+  init_driver(&I2CD2);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the I2C peripheral.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+void i2c_lld_start(I2CDriver *i2cp) {
+
+  i2cp->pending = false;
+}
+
+/**
+ * @brief   Deactivates the I2C peripheral.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+void i2c_lld_stop(I2CDriver *i2cp) {
+
+  i2cp->pending = false;
+}
+
+/**
+ * @brief   Receives data via the I2C bus as master.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The operation status.
+ * @retval MSG_OK       if the function succeeded.
+ * @retval MSG_RESET    if one or more I2C errors occurred, the errors can
+ *                      be retrieved using @p i2cGetErrors().
+ * @retval MSG_TIMEOUT  if a timeout occurred before operation end.
+ *
+ * @notapi
+ */
+msg_t i2c_lld_master_receive_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                     uint8_t *rxbuf, size_t rxbytes,
+                                     systime_t timeout) {
+
+  return start_transaction(i2cp, addr, NULL, 0, rxbuf, rxbytes, timeout);
+}
+
+/**
+ * @brief   Transmits data via the I2C bus as master.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] addr      slave device address
+ * @param[in] txbuf     pointer to the transmit buffer
+ * @param[in] txbytes   number of bytes to be transmitted
+ * @param[out] rxbuf    pointer to the receive buffer
+ * @param[in] rxbytes   number of bytes to be received
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_INFINITE no timeout.
+ *                      .
+ * @return              The operation status.
+ * @retval MSG_OK       if the function succeeded.
+ * @retval MSG_RESET    if one or more I2C errors occurred, the errors can
+ *                      be retrieved using @p i2cGetErrors().
+ * @retval MSG_TIMEOUT  if a timeout occurred before operation end.
+ *
+ * @notapi
+ */
+msg_t i2c_lld_master_transmit_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                      const uint8_t *txbuf, size_t txbytes,
+                                      uint8_t *rxbuf, size_t rxbytes,
+                                      systime_t timeout) {
+
+  return start_transaction(i2cp, addr, txbuf, txbytes, rxbuf, rxbytes,
+                           timeout);
+}
+
+/**
+ * @brief   I2C interrupt simulation.
+ * @details Runs the pending transactions against the attached devices.
+ *
+ * @return              @p true if an interrupt has been served.
+ *
+ * @notapi
+ */
+bool i2c_lld_interrupt_pending(void) {
+  bool b = false;
+
+  CH_IRQ_PROLOGUE();
+
+#if SIM_I2C_USE_I2C1
+  b = serve_interrupt(&I2CD1) || b;
+#endif
+#if SIM_I2C_USE_I2C2
+  b = serve_interrupt(&I2CD2) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+/**
+ * @brief   Attaches a simulated slave to the bus.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ * @param[in] devp      pointer to the device, its @p addr field must be set
+ *
+ * @api
+ */
+void i2cSimAttachDevice(I2CDriver *i2cp, I2CSimDevice *devp) {
+
+  devp->next    = i2cp->devices;
+  i2cp->devices = devp;
+}
+
+#endif /* HAL_USE_I2C */
+
+/** @} */
@@ -0,0 +1,245 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    i2c_lld.h
+ * @brief   Posix simulator I2C subsystem low level driver header.
+ *
+ * @addtogroup POSIX_I2C
+ * @{
+ */
+
+#ifndef _I2C_LLD_H_
+#define _I2C_LLD_H_
+
+#if HAL_USE_I2C || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @name    TIMINGR register definitions
+ * @note    Accepted for compatibility with the STM32 I2Cv2 driver, the
+ *          simulated bus has no timing.
+ * @{
+ */
+#define STM32_TIMINGR_PRESC_MASK        (15U << 28)
+#define STM32_TIMINGR_PRESC(n)          ((n) << 28)
+#define STM32_TIMINGR_SCLDEL_MASK       (15U << 20)
+#define STM32_TIMINGR_SCLDEL(n)         ((n) << 20)
+#define STM32_TIMINGR_SDADEL_MASK       (15U << 16)
+#define STM32_TIMINGR_SDADEL(n)         ((n) << 16)
+#define STM32_TIMINGR_SCLH_MASK         (255U << 8)
+#define STM32_TIMINGR_SCLH(n)           ((n) << 8)
+#define STM32_TIMINGR_SCLL_MASK         (255U << 0)
+#define STM32_TIMINGR_SCLL(n)           ((n) << 0)
+/** @} */
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    Configuration options
+ * @{
+ */
+/**
+ * @brief   I2C1 driver enable switch.
+ * @details If set to @p TRUE the support for I2C1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(SIM_I2C_USE_I2C1) || defined(__DOXYGEN__)
+#define SIM_I2C_USE_I2C1                    TRUE
+#endif
+
+/**
+ * @brief   I2C2 driver enable switch.
+ * @details If set to @p TRUE the support for I2C2 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(SIM_I2C_USE_I2C2) || defined(__DOXYGEN__)
+#define SIM_I2C_USE_I2C2                    TRUE
+#endif
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type representing an I2C address.
+ */
+typedef uint16_t i2caddr_t;
+
+/**
+ * @brief   Type of I2C Driver condition flags.
+ */
+typedef uint32_t i2cflags_t;
+
+/**
+ * @brief   Type of I2C driver configuration structure.
+ * @note    Same layout of the STM32 I2Cv2 driver, the fields are ignored.
+ */
+typedef struct {
+  /**
+   * @brief TIMINGR register initialization.
+   */
+  uint32_t                  timingr;
+  /**
+   * @brief CR1 register initialization.
+   */
+  uint32_t                  cr1;
+  /**
+   * @brief CR2 register initialization.
+   */
+  uint32_t                  cr2;
+} I2CConfig;
+
+/**
+ * @brief   Type of a structure representing an I2C driver.
+ */
+typedef struct I2CDriver I2CDriver;
+
+/**
+ * @brief   Type of a simulated I2C slave.
+ */
+typedef struct I2CSimDevice I2CSimDevice;
+
+/**
+ * @brief   Simulated I2C slave.
+ * @details A write phase of @p txn bytes is optionally followed by a
+ *          repeated start and a read phase of @p rxn bytes, either count
+ *          can be zero.
+ */
+struct I2CSimDevice {
+  /**
+   * @brief 7 bits slave address.
+   */
+  i2caddr_t                 addr;
+  /**
+   * @brief Transaction handler, returns @p MSG_OK or @p MSG_RESET on NACK.
+   */
+  msg_t                     (*transfer)(I2CSimDevice *devp,
+                                        const uint8_t *txbuf, size_t txn,
+                                        uint8_t *rxbuf, size_t rxn);
+  /**
+   * @brief Next device on the same bus.
+   */
+  I2CSimDevice              *next;
+};
+
+/**
+ * @brief   Structure representing an I2C driver.
+ */
+struct I2CDriver {
+  /**
+   * @brief   Driver state.
+   */
+  i2cstate_t                state;
+  /**
+   * @brief   Current configuration data.
+   */
+  const I2CConfig           *config;
+  /**
+   * @brief   Error flags.
+   */
+  i2cflags_t                errors;
+#if I2C_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+  mutex_t                   mutex;
+#endif
+#if defined(I2C_DRIVER_EXT_FIELDS)
+  I2C_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Thread waiting for I/O completion.
+   */
+  thread_reference_t        thread;
+  /**
+   * @brief   Devices attached to the bus.
+   */
+  I2CSimDevice              *devices;
+  /**
+   * @brief   A transaction is waiting for the simulated interrupt.
+   */
+  bool                      pending;
+  /**
+   * @brief   Current slave address.
+   */
+  i2caddr_t                 addr;
+  /**
+   * @brief   Pending transaction buffers.
+   */
+  const uint8_t             *txbuf;
+  size_t                    txbytes;
+  uint8_t                   *rxbuf;
+  size_t                    rxbytes;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Get errors from I2C driver.
+ *
+ * @param[in] i2cp      pointer to the @p I2CDriver object
+ *
+ * @notapi
+ */
+#define i2c_lld_get_errors(i2cp) ((i2cp)->errors)
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if !defined(__DOXYGEN__)
+#if SIM_I2C_USE_I2C1
+extern I2CDriver I2CD1;
+#endif
+#if SIM_I2C_USE_I2C2
+extern I2CDriver I2CD2;
+#endif
+#endif /* !defined(__DOXYGEN__) */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void i2c_lld_init(void);
+  void i2c_lld_start(I2CDriver *i2cp);
+  void i2c_lld_stop(I2CDriver *i2cp);
+  msg_t i2c_lld_master_transmit_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                        const uint8_t *txbuf, size_t txbytes,
+                                        uint8_t *rxbuf, size_t rxbytes,
+                                        systime_t timeout);
+  msg_t i2c_lld_master_receive_timeout(I2CDriver *i2cp, i2caddr_t addr,
+                                       uint8_t *rxbuf, size_t rxbytes,
+                                       systime_t timeout);
+  bool i2c_lld_interrupt_pending(void);
+  void i2cSimAttachDevice(I2CDriver *i2cp, I2CSimDevice *devp);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_I2C */
+
+#endif /* _I2C_LLD_H_ */
+
+/** @} */
@@ -0,0 +1,64 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    posix/pal_lld.h
+ * @brief   Posix simulator PAL subsystem low level driver header.
+ * @details The virtual I/O ports of the generic simulator driver are used
+ *          unchanged, the modes not supported by the virtual ports are
+ *          mapped on the nearest supported one instead of being removed so
+ *          that code written for a real board builds without changes.
+ *
+ * @addtogroup POSIX_PAL
+ * @{
+ */
+
+#ifndef _POSIX_PAL_LLD_H_
+#define _POSIX_PAL_LLD_H_
+
+#include "../pal_lld.h"
+
+#if HAL_USE_PAL || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Unsupported modes and specific modes                                      */
+/*===========================================================================*/
+
+/**
+ * @brief   Input with pull-up, the virtual port has no pull resistors.
+ */
+#define PAL_MODE_INPUT_PULLUP           PAL_MODE_INPUT
+
+/**
+ * @brief   Input with pull-down, the virtual port has no pull resistors.
+ */
+#define PAL_MODE_INPUT_PULLDOWN         PAL_MODE_INPUT
+
+/**
+ * @brief   Analog input, the virtual port treats it as a digital input.
+ */
+#define PAL_MODE_INPUT_ANALOG           PAL_MODE_INPUT
+
+/**
+ * @brief   Open-drain output, the virtual port drives both levels.
+ */
+#define PAL_MODE_OUTPUT_OPENDRAIN       PAL_MODE_OUTPUT_PUSHPULL
+
+#endif /* HAL_USE_PAL */
+
+#endif /* _POSIX_PAL_LLD_H_ */
+
+/** @} */
@@ -0,0 +1,16 @@
+# List of all the Posix platform files.
+PLATFORMSRC = ${CHIBIOS}/os/hal/ports/simulator/posix/hal_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/posix/serial_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/posix/adc_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/posix/can_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/posix/ext_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/posix/i2c_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/posix/pwm_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/posix/spi_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/console.c \
+              ${CHIBIOS}/os/hal/ports/simulator/pal_lld.c \
+              ${CHIBIOS}/os/hal/ports/simulator/st_lld.c
+
+# Required include directories
+PLATFORMINC = ${CHIBIOS}/os/hal/ports/simulator/posix \
+              ${CHIBIOS}/os/hal/ports/simulator
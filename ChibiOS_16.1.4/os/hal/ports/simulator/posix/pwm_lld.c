@@ -0,0 +1,203 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+/**
+ * @file    pwm_lld.c
+ * @brief   Posix simulator PWM subsystem low level driver source.
+ *
+ * @addtogroup POSIX_PWM
+ * @{
+ */
+
+#include "hal.h"
+
+#if HAL_USE_PWM || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief PWMD1 driver identifier.*/
+#if SIM_PWM_USE_PWM1 || defined(__DOXYGEN__)
+PWMDriver PWMD1;
+#endif
+
+/** @brief PWMD2 driver identifier.*/
+#if SIM_PWM_USE_PWM2 || defined(__DOXYGEN__)
+PWMDriver PWMD2;
+#endif
+
+/** @brief PWMD3 driver identifier.*/
+#if SIM_PWM_USE_PWM3 || defined(__DOXYGEN__)
+PWMDriver PWMD3;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void init_driver(PWMDriver *pwmp) {
+
+  pwmObjectInit(pwmp);
+  pwmp->channels = PWM_CHANNELS;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level PWM driver initialization.
+ *
+ * @notapi
+ */
+void pwm_lld_init(void) {
+
+#if SIM_PWM_USE_PWM1
+  init_driver(&PWMD1);
+#endif
+#if SIM_PWM_USE_PWM2
+  init_driver(&PWMD2);
+#endif
+#if SIM_PWM_USE_PWM3
+  init_driver(&PWMD3);
+#endif
+}
+
+/**
+ * @brief   Configures and activates the PWM peripheral.
+ *
+ * @param[in] pwmp      pointer to the @p PWMDriver object
+ *
+ * @notapi
+ */
+void pwm_lld_start(PWMDriver *pwmp) {
+  pwmchannel_t i;
+
+  pwmp->period = pwmp->config->period;
+  for (i = 0; i < PWM_CHANNELS; i++)
+    pwmp->widths[i] = 0;
+}
+
+/**
+ * @brief   Deactivates the PWM peripheral.
+ *
+ * @param[in] pwmp      pointer to the @p PWMDriver object
+ *
+ * @notapi
+ */
+void pwm_lld_stop(PWMDriver *pwmp) {
+
+  (void)pwmp;
+}
+
+/**
+ * @brief   Enables a PWM channel.
+ *
+ * @param[in] pwmp      pointer to a @p PWMDriver object
+ * @param[in] channel   PWM channel identifier (0...channels-1)
+ * @param[in] width     PWM pulse width as clock pulses number
+ *
+ * @notapi
+ */
+void pwm_lld_enable_channel(PWMDriver *pwmp,
+                            pwmchannel_t channel,
+                            pwmcnt_t width) {
+
+  pwmp->widths[channel] = width;
+}
+
+/**
+ * @brief   Disables a PWM channel and its notification.
+ *
+ * @param[in] pwmp      pointer to a @p PWMDriver object
+ * @param[in] channel   PWM channel identifier (0...channels-1)
+ *
+ * @notapi
+ */
+void pwm_lld_disable_channel(PWMDriver *pwmp, pwmchannel_t channel) {
+
+  pwmp->widths[channel] = 0;
+}
+
+/**
+ * @brief   Enables the periodic activation edge notification.
+ *
+ * @param[in] pwmp      pointer to a @p PWMDriver object
+ *
+ * @notapi
+ */
+void pwm_lld_enable_periodic_notification(PWMDriver *pwmp) {
+
+  (void)pwmp;
+}
+
+/**
+ * @brief   Disables the periodic activation edge notification.
+ *
+ * @param[in] pwmp      pointer to a @p PWMDriver object
+ *
+ * @notapi
+ */
+void pwm_lld_disable_periodic_notification(PWMDriver *pwmp) {
+
+  (void)pwmp;
+}
+
+/**
+ * @brief   Enables a channel de-activation edge notification.
+ *
+ * @param[in] pwmp      pointer to a @p PWMDriver object
+ * @param[in] channel   PWM channel identifier (0...channels-1)
+ *
+ * @notapi
+ */
+void pwm_lld_enable_channel_notification(PWMDriver *pwmp,
+                                         pwmchannel_t channel) {
+
+  (void)pwmp;
+  (void)channel;
+}
+
+/**
+ * @brief   Disables a channel de-activation edge notification.
+ *
+ * @param[in] pwmp      pointer to a @p PWMDriver object
+ * @param[in] channel   PWM channel identifier (0...channels-1)
+ *
+ * @notapi
+ */
+void pwm_lld_disable_channel_notification(PWMDriver *pwmp,
+                                          pwmchannel_t channel) {
+
+  (void)pwmp;
+  (void)channel;
+}
+
+#endif /* HAL_USE_PWM */
+
+/** @} */
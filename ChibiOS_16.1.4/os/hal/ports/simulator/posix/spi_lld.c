@@ -0,0 +1,271 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    spi_lld.c
+ * @brief   Posix simulator SPI subsystem low level driver source.
+ *
+ * @addtogroup POSIX_SPI
+ * @{
+ */
+
+#include "hal.h"
+
+#if HAL_USE_SPI || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/** @brief SPI1 driver identifier.*/
+#if SIM_SPI_USE_SPI1 || defined(__DOXYGEN__)
+SPIDriver SPID1;
+#endif
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+static void start_transfer(SPIDriver *spip, size_t n,
+                           const void *txbuf, void *rxbuf) {
+
+  spip->n       = n;
+  spip->txbuf   = txbuf;
+  spip->rxbuf   = rxbuf;
+  spip->pending = true;
+}
+
+static uint8_t exchange_frame(SPIDriver *spip, uint8_t frame) {
+
+  if ((spip->model != NULL) && (spip->model->exchange != NULL))
+    return spip->model->exchange(spip, frame);
+
+  /* Nothing on the bus, MISO floats high.*/
+  return 0xFFU;
+}
+
+static bool serve_interrupt(SPIDriver *spip) {
+  size_t i;
+
+  if (!spip->pending)
+    return false;
+
+  spip->pending = false;
+  for (i = 0; i < spip->n; i++) {
+    uint8_t rx = exchange_frame(spip,
+                                spip->txbuf != NULL ? spip->txbuf[i] : 0xFFU);
+    if (spip->rxbuf != NULL)
+      spip->rxbuf[i] = rx;
+  }
+  _spi_isr_code(spip);
+
+  return true;
+}
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level SPI driver initialization.
+ *
+ * @notapi
+ */
+void spi_lld_init(void) {
+
+#if SIM_SPI_USE_SPI1
+  spiObjectInit(&SPID1);
+  SPID1.model   = NULL;
+  SPID1.pending = false;
+#endif
+}
+
+/**
+ * @brief   Configures and activates the SPI peripheral.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_start(SPIDriver *spip) {
+
+  spip->pending = false;
+}
+
+/**
+ * @brief   Deactivates the SPI peripheral.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_stop(SPIDriver *spip) {
+
+  spip->pending = false;
+}
+
+/**
+ * @brief   Asserts the slave select signal and prepares for transfers.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_select(SPIDriver *spip) {
+
+  palClearPad(spip->config->ssport, spip->config->sspad);
+  if ((spip->model != NULL) && (spip->model->select != NULL))
+    spip->model->select(spip);
+}
+
+/**
+ * @brief   Deasserts the slave select signal.
+ * @details The previously selected peripheral is unselected.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ *
+ * @notapi
+ */
+void spi_lld_unselect(SPIDriver *spip) {
+
+  palSetPad(spip->config->ssport, spip->config->sspad);
+  if ((spip->model != NULL) && (spip->model->unselect != NULL))
+    spip->model->unselect(spip);
+}
+
+/**
+ * @brief   Ignores data on the SPI bus.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to be ignored
+ *
+ * @notapi
+ */
+void spi_lld_ignore(SPIDriver *spip, size_t n) {
+
+  start_transfer(spip, n, NULL, NULL);
+}
+
+/**
+ * @brief   Exchanges data on the SPI bus.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to be exchanged
+ * @param[in] txbuf     the pointer to the transmit buffer
+ * @param[out] rxbuf    the pointer to the receive buffer
+ *
+ * @notapi
+ */
+void spi_lld_exchange(SPIDriver *spip, size_t n,
+                      const void *txbuf, void *rxbuf) {
+
+  start_transfer(spip, n, txbuf, rxbuf);
+}
+
+/**
+ * @brief   Sends data over the SPI bus.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to send
+ * @param[in] txbuf     the pointer to the transmit buffer
+ *
+ * @notapi
+ */
+void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf) {
+
+  start_transfer(spip, n, txbuf, NULL);
+}
+
+/**
+ * @brief   Receives data from the SPI bus.
+ * @post    At the end of the operation the configured callback is invoked.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] n         number of words to receive
+ * @param[out] rxbuf    the pointer to the receive buffer
+ *
+ * @notapi
+ */
+void spi_lld_receive(SPIDriver *spip, size_t n, void *rxbuf) {
+
+  start_transfer(spip, n, NULL, rxbuf);
+}
+
+/**
+ * @brief   Exchanges one frame using a polled wait.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] frame     the data frame to send over the SPI bus
+ * @return              The received data frame from the SPI bus.
+ */
+uint16_t spi_lld_polled_exchange(SPIDriver *spip, uint16_t frame) {
+
+  return exchange_frame(spip, (uint8_t)frame);
+}
+
+/**
+ * @brief   SPI interrupt simulation.
+ * @details Completes the pending transfers against the attached models.
+ *
+ * @return              @p true if an interrupt has been served.
+ *
+ * @notapi
+ */
+bool spi_lld_interrupt_pending(void) {
+  bool b = false;
+
+  CH_IRQ_PROLOGUE();
+
+#if SIM_SPI_USE_SPI1
+  b = serve_interrupt(&SPID1) || b;
+#endif
+
+  CH_IRQ_EPILOGUE();
+
+  return b;
+}
+
+/**
+ * @brief   Attaches a device model to the simulated bus.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object
+ * @param[in] model     pointer to the device model or @p NULL to detach
+ *
+ * @api
+ */
+void spiSimSetModel(SPIDriver *spip, const SPISimModel *model) {
+
+  spip->model = model;
+}
+
+#endif /* HAL_USE_SPI */
+
+/** @} */
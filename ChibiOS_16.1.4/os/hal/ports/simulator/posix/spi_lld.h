@@ -0,0 +1,210 @@
+/*
+    ChibiOS - Copyright (C) 2006..2015 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    spi_lld.h
+ * @brief   Posix simulator SPI subsystem low level driver header.
+ *
+ * @addtogroup POSIX_SPI
+ * @{
+ */
+
+#ifndef _SPI_LLD_H_
+#define _SPI_LLD_H_
+
+#if HAL_USE_SPI || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    Configuration options
+ * @{
+ */
+/**
+ * @brief   SPI1 driver enable switch.
+ * @details If set to @p TRUE the support for SPI1 is included.
+ * @note    The default is @p TRUE.
+ */
+#if !defined(SIM_SPI_USE_SPI1) || defined(__DOXYGEN__)
+#define SIM_SPI_USE_SPI1                    TRUE
+#endif
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a structure representing an SPI driver.
+ */
+typedef struct SPIDriver SPIDriver;
+
+/**
+ * @brief   SPI notification callback type.
+ *
+ * @param[in] spip      pointer to the @p SPIDriver object triggering the
+ *                      callback
+ */
+typedef void (*spicallback_t)(SPIDriver *spip);
+
+/**
+ * @brief   Simulated SPI slave.
+ * @details The device model sees the bus one 8 bits frame at a time, the
+ *          select hooks are invoked on slave select assertion and
+ *          de-assertion.
+ */
+typedef struct {
+  /**
+   * @brief Slave select asserted, can be @p NULL.
+   */
+  void                      (*select)(SPIDriver *spip);
+  /**
+   * @brief Slave select de-asserted, can be @p NULL.
+   */
+  void                      (*unselect)(SPIDriver *spip);
+  /**
+   * @brief Full duplex exchange of a single frame.
+   */
+  uint8_t                   (*exchange)(SPIDriver *spip, uint8_t frame);
+} SPISimModel;
+
+/**
+ * @brief   Driver configuration structure.
+ * @note    The layout is the same of the STM32 SPIv2 driver so that board
+ *          code builds unchanged, the @p cr1 and @p cr2 fields are ignored
+ *          and frames are always 8 bits wide.
+ */
+typedef struct {
+  /**
+   * @brief Operation complete callback or @p NULL.
+   */
+  spicallback_t             end_cb;
+  /* End of the mandatory fields.*/
+  /**
+   * @brief The chip select line port.
+   */
+  ioportid_t                ssport;
+  /**
+   * @brief The chip select line pad number.
+   */
+  uint16_t                  sspad;
+  /**
+   * @brief SPI CR1 register initialization data.
+   */
+  uint16_t                  cr1;
+  /**
+   * @brief SPI CR2 register initialization data.
+   */
+  uint16_t                  cr2;
+} SPIConfig;
+
+/**
+ * @brief   Structure representing an SPI driver.
+ */
+struct SPIDriver {
+  /**
+   * @brief Driver state.
+   */
+  spistate_t                state;
+  /**
+   * @brief Current configuration data.
+   */
+  const SPIConfig           *config;
+#if SPI_USE_WAIT || defined(__DOXYGEN__)
+  /**
+   * @brief   Waiting thread.
+   */
+  thread_reference_t        thread;
+#endif
+#if SPI_USE_MUTUAL_EXCLUSION || defined(__DOXYGEN__)
+  /**
+   * @brief   Mutex protecting the peripheral.
+   */
+  mutex_t                   mutex;
+#endif
+#if defined(SPI_DRIVER_EXT_FIELDS)
+  SPI_DRIVER_EXT_FIELDS
+#endif
+  /* End of the mandatory fields.*/
+  /**
+   * @brief   Attached device model or @p NULL.
+   */
+  const SPISimModel         *model;
+  /**
+   * @brief   A transfer is waiting for the simulated interrupt.
+   */
+  bool                      pending;
+  /**
+   * @brief   Number of frames of the pending transfer.
+   */
+  size_t                    n;
+  /**
+   * @brief   Transmit buffer of the pending transfer or @p NULL.
+   */
+  const uint8_t             *txbuf;
+  /**
+   * @brief   Receive buffer of the pending transfer or @p NULL.
+   */
+  uint8_t                   *rxbuf;
+};
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if SIM_SPI_USE_SPI1 && !defined(__DOXYGEN__)
+extern SPIDriver SPID1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void spi_lld_init(void);
+  void spi_lld_start(SPIDriver *spip);
+  void spi_lld_stop(SPIDriver *spip);
+  void spi_lld_select(SPIDriver *spip);
+  void spi_lld_unselect(SPIDriver *spip);
+  void spi_lld_ignore(SPIDriver *spip, size_t n);
+  void spi_lld_exchange(SPIDriver *spip, size_t n,
+                        const void *txbuf, void *rxbuf);
+  void spi_lld_send(SPIDriver *spip, size_t n, const void *txbuf);
+  void spi_lld_receive(SPIDriver *spip, size_t n, void *rxbuf);
+  uint16_t spi_lld_polled_exchange(SPIDriver *spip, uint16_t frame);
+  bool spi_lld_interrupt_pending(void);
+  void spiSimSetModel(SPIDriver *spip, const SPISimModel *model);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_SPI */
+
+#endif /* _SPI_LLD_H_ */
+
+/** @} */
@@ -25,7 +25,11 @@
  * @{
  */
 
+#if defined(WIN32)
 #include <windows.h>
+#else
+#include <time.h>
+#endif
 
 #include "ch.h"
 
@@ -110,11 +114,19 @@ void _port_thread_start(msg_t (*pf)(void *), void *p) {
  * @return              The realtime counter value.
  */
 rtcnt_t port_rt_get_counter_value(void) {
+#if defined(WIN32)
   LARGE_INTEGER n;
 
   QueryPerformanceCounter(&n);
 
   return (rtcnt_t)(n.QuadPart / 1000LL);
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (rtcnt_t)((ts.tv_sec * 1000000000ULL + ts.tv_nsec) / 1000ULL);
+#endif
 }
 
 /** @} */
@@ -2,18 +2,45 @@
 #include "hal.h"
 #include "hw_conf.h"
 #include "faults.h"
-#include <math.h>
+#include "thermistor.h"
+#include "fast_trip.h"
 
-static const ADCConversionGroup adc3 = {
-    FALSE,
+// The ADCs convert continuously into circular DMA buffers. Each half buffer
+// is averaged in the DMA callback, which oversamples the inputs and adds
+// 4 bits of resolution. analog_update converts the latest averages and the
+// readers only return the converted values, nothing waits on a conversion.
+// The analog watchdog of ADC3 can watch the discharge output, it stops the
+// conversions when it trips and analog_update restarts them. A restart
+// after an overflow or a DMA error keeps the window of the watchdog, only
+// a trip clears it until analog_set_discharge_watchdog sets it again.
+
+#define ADC_OVERSAMPLING 32 // Samples averaged per channel, a half buffer
+#define ADC_DEPTH (2 * ADC_OVERSAMPLING)
+#define ADC_FRACTION_BITS 4
+#define ADC_FULL_SCALE (4095 << ADC_FRACTION_BITS)
+
+// Longest sampling time, one round of conversions every ~17us
+#define ADC_SMPR1(ch) ((ch) < 10 ? ADC_SMPR_SMP_601P5 << ((ch) * 3) : 0)
+#define ADC_SMPR2(ch) ((ch) >= 10 ? ADC_SMPR_SMP_601P5 << (((ch) - 10) * 3) : 0)
+
+#define DSG_SENSE_GAIN ((200000.0 + 100 + 2500 + 10000.0) / 10000.0)
+
+static void adc3_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n);
+static void adc4_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n);
+static void adc3_error_cb(ADCDriver *adcp, adcerror_t err);
+static void adc3_start(void);
+
+// CFGR and TR1 are set from dischargeWatchdog by adc3_start
+static ADCConversionGroup adc3 = {
+    TRUE,
     2,
-    NULL,
-    NULL,
-    0,                        /* CFGR    */
+    adc3_cb,
+    adc3_error_cb,
+    ADC_CFGR_CONT,            /* CFGR    */
     ADC_TR(0, 4095),          /* TR1     */
     {                         /* SMPR[2] */
-        0,
-        0
+        ADC_SMPR1(CHG_SENSE_CHANNEL) | ADC_SMPR1(DSG_SENSE_CHANNEL),
+        ADC_SMPR2(CHG_SENSE_CHANNEL) | ADC_SMPR2(DSG_SENSE_CHANNEL)
     },
     {                         /* SQR[4]  */
         ADC_SQR1_SQ1_N(CHG_SENSE_CHANNEL) | ADC_SQR1_SQ2_N(DSG_SENSE_CHANNEL),
@@ -24,15 +51,15 @@ static const ADCConversionGroup adc3 = {
 };
 
 static const ADCConversionGroup adc4 = {
-    FALSE,
+    TRUE,
     1,
+    adc4_cb,
     NULL,
-    NULL,
-    0,                        /* CFGR    */
+    ADC_CFGR_CONT,            /* CFGR    */
     ADC_TR(0, 4095),          /* TR1     */
     {                         /* SMPR[2] */
-        0,
-        0
+        ADC_SMPR1(TEMP_SENSE_CHANNEL),
+        ADC_SMPR2(TEMP_SENSE_CHANNEL)
     },
     {                         /* SQR[4]  */
         ADC_SQR1_SQ1_N(TEMP_SENSE_CHANNEL),
@@ -42,45 +69,129 @@ static const ADCConversionGroup adc4 = {
     }
 };
 
+static adcsample_t samples3[ADC_DEPTH * 2];
+static adcsample_t samples4[ADC_DEPTH];
+
+// Averages with ADC_FRACTION_BITS extra bits
 static volatile uint16_t charger_input_voltage;
 static volatile uint16_t thermistor;
 static volatile uint16_t discharge_voltage;
 
+// Lowest code of the discharge output, 0 when the watchdog is off
+static volatile uint16_t dischargeWatchdog;
+
+static volatile float chargerInputVoltage;
+static volatile float temperature;
+static volatile float dischargeVoltage;
+
 void analog_init(void)
 {
     adcStart(&ADCD3, NULL);
     adcStart(&ADCD4, NULL);
-    adcsample_t samples[2];
-    adcConvert(&ADCD3, &adc3, samples, 1);
-    charger_input_voltage = samples[0];
-    discharge_voltage = samples[1];
+    dischargeWatchdog = 0;
+    adc3_start();
+    adcStartConversion(&ADCD4, &adc4, samples4, ADC_DEPTH);
+
+    // Until the first half buffers are averaged
+    chThdSleepMilliseconds(2);
+    analog_update();
 }
 
 void analog_update(void)
 {
-    adcsample_t samples3[2];
-    adcConvert(&ADCD3, &adc3, samples3, 1);
-    charger_input_voltage = samples3[0];
-    discharge_voltage = samples3[1];
-    adcsample_t samples4[1];
-    adcConvert(&ADCD4, &adc4, samples4, 1);
-    thermistor = samples4[0];
-    if (analog_temperature() > 100) //To move in temperature control
+    chargerInputVoltage = (float)charger_input_voltage / ADC_FULL_SCALE * 3.3 * (51000.0 + 18000.0 + 4700.0) / 4700.0;
+    dischargeVoltage = (float)discharge_voltage * (3.3 / ADC_FULL_SCALE) * DSG_SENSE_GAIN;
+
+    // Stopped by the watchdog or by an overflow
+    if (ADCD3.state == ADC_READY)
+        adc3_start();
+
+    temperature = thermistor_board_temperature(((uint32_t)thermistor << THERMISTOR_RATIO_BITS) / ADC_FULL_SCALE);
+
+    if (temperature > 100) //To move in temperature control
         faults_set_fault(FAULT_BOARD_TEMP);
 }
 
 float analog_charger_input_voltage(void)
 {
-    return (float)charger_input_voltage / 4095.0 * 3.3 * (51000.0 + 18000.0 + 4700.0) / 4700.0;
+    return chargerInputVoltage;
 }
 
 float analog_temperature(void)
 {
-    return (1.0 / ((logf(((4095.0 * 10000.0) / thermistor - 10000.0) / 10000.0) / 3434.0) + (1.0 / 298.15)) - 273.15);
+    return temperature;
 }
 
 float analog_discharge_voltage(void)
 {
-    return (float)discharge_voltage * (3.3 / 4095.0) * (200000.0 + 100 + 2500 + 10000.0) / 10000.0;
+    return dischargeVoltage;
+}
+
+// Trips the fast trip when the discharge output falls below minVoltage,
+// disabled with 0. The conversions are restarted with the new window.
+void analog_set_discharge_watchdog(float minVoltage)
+{
+    float code = minVoltage / DSG_SENSE_GAIN / 3.3 * 4095.0;
+    uint16_t low = 0;
+    if (code >= 4095.0)
+        low = 4095;
+    else if (code > 0.0)
+        low = code;
+
+    adcStopConversion(&ADCD3);
+    dischargeWatchdog = low;
+    adc3_start();
+}
+
+static void adc3_start(void)
+{
+    uint16_t low = dischargeWatchdog;
+    if (low > 0)
+    {
+        adc3.cfgr = ADC_CFGR_CONT | ADC_CFGR_AWD1_SINGLE(DSG_SENSE_CHANNEL);
+        adc3.tr1 = ADC_TR(low, 4095);
+    }
+    else
+    {
+        adc3.cfgr = ADC_CFGR_CONT;
+        adc3.tr1 = ADC_TR(0, 4095);
+    }
+    adcStartConversion(&ADCD3, &adc3, samples3, ADC_DEPTH);
+}
 
+// Called with each half of the buffer, n rounds of conversions
+static void adc3_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n)
+{
+    (void)adcp;
+    uint32_t charger = 0;
+    uint32_t discharge = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        charger += buffer[2 * i];
+        discharge += buffer[2 * i + 1];
+    }
+    charger_input_voltage = (charger << ADC_FRACTION_BITS) / n;
+    discharge_voltage = (discharge << ADC_FRACTION_BITS) / n;
+}
+
+static void adc3_error_cb(ADCDriver *adcp, adcerror_t err)
+{
+    (void)adcp;
+    if (err == ADC_ERR_AWD1)
+    {
+        // The output stays low until the fault is cleared
+        dischargeWatchdog = 0;
+        chSysLockFromISR();
+        fast_trip_trigger_i(FAST_TRIP_OUTPUT_SHORT);
+        chSysUnlockFromISR();
+    }
+}
+
+static void adc4_cb(ADCDriver *adcp, adcsample_t *buffer, size_t n)
+{
+    (void)adcp;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += buffer[i];
+    thermistor = (sum << ADC_FRACTION_BITS) / n;
 }
@@ -8,5 +8,6 @@ void analog_update(void);
 float analog_charger_input_voltage(void);
 float analog_temperature(void);
 float analog_discharge_voltage(void);
+void analog_set_discharge_watchdog(float minVoltage);
 
 #endif /* _ANALOG_H_ */
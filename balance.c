@@ -0,0 +1,200 @@
+#include "balance.h"
+#include <math.h>
+
+// Each cell has to bleed its excess charge through its balance resistor,
+// which takes t = Q / I at full duty. Bleeding every cell at full duty
+// would not finish sooner than the cell with the most excess, so each cell
+// gets the duty that makes it finish at the same time H, the shortest time
+// that keeps the average bleed power under the budget:
+//   H = max(max(t), sum(P.t) / Pmax), duty = t / H
+// The duties are turned into on/off slots by a first order sigma-delta
+// modulator per cell, called at a fixed rate.
+//
+// The bleed resistors and switches of a device heat its die. Odd and even
+// cells bleed in alternate slots, so neighbouring resistors are never on
+// together, and at most maxChannels cells of a device bleed in a slot, the
+// ones that are the most behind. The horizon is stretched until the duties
+// fit in these slots. On top of the plan, an integral controller per device
+// scales the duties down to hold the die at a target temperature, which
+// keeps the highest bleed current the die can sustain instead of bleeding
+// at full power until the LTC6803 shuts down.
+
+// 1/(degree C.s), a die 10 degree C too hot sheds 10% of its duty per second
+#define BALANCE_THERMAL_GAIN 0.01
+// degree C above the target at which a device stops bleeding at once
+#define BALANCE_THERMAL_MARGIN 10.0
+// Slots a cell may fall behind its duty when its device is full
+#define BALANCE_MAX_DEBT 2.0
+
+// Picks the policy that applies to the pack right now among the enabled
+// ones, from its lowest and highest cell in V and its discharge current in
+// A. Top balancing runs while charging and at rest once a cell reaches
+// startVoltage, bottom balancing at rest once every cell is below
+// bottomVoltage, and discharge balancing while the load stays under
+// dischargeCurrent. Nothing runs near the low voltage cutoff.
+BalanceMode balance_mode(const BalancePolicy *policy, float minVoltage, float maxVoltage, float current,
+        bool charging)
+{
+    bool topVoltage = maxVoltage >= policy->startVoltage;
+
+    if (minVoltage <= policy->lowVoltage)
+        return BALANCE_MODE_NONE;
+    if (policy->drain)
+        return BALANCE_MODE_DRAIN;
+    if (charging)
+        return (policy->modes & BALANCE_MODE_TOP) && topVoltage ? BALANCE_MODE_TOP : BALANCE_MODE_NONE;
+    if (fabsf(current) <= policy->restCurrent)
+    {
+        if ((policy->modes & BALANCE_MODE_TOP) && topVoltage)
+            return BALANCE_MODE_TOP;
+        if ((policy->modes & BALANCE_MODE_BOTTOM) && maxVoltage <= policy->bottomVoltage)
+            return BALANCE_MODE_BOTTOM;
+    }
+    else if ((policy->modes & BALANCE_MODE_DISCHARGE) && current > 0.0 && current <= policy->dischargeCurrent)
+    {
+        return BALANCE_MODE_DISCHARGE;
+    }
+    return BALANCE_MODE_NONE;
+}
+
+// Spread in V between the lowest and highest cell that starts a mode
+float balance_threshold(const BalancePolicy *policy, BalanceMode mode)
+{
+    switch (mode)
+    {
+        case BALANCE_MODE_TOP:
+            return policy->topDifference;
+        case BALANCE_MODE_BOTTOM:
+            return policy->bottomDifference;
+        case BALANCE_MODE_DISCHARGE:
+            return policy->dischargeDifference;
+        default:
+            return 0.0;
+    }
+}
+
+void balance_init(BalancePlan *plan)
+{
+    plan->numCells = 0;
+    plan->maxChannels = BALANCE_CELLS_PER_DEVICE;
+    plan->phase = 0;
+    for (uint8_t i = 0; i < BALANCE_MAX_CELLS; i++)
+    {
+        plan->duty[i] = 0.0;
+        plan->modulator[i] = 0.0;
+    }
+    for (uint8_t d = 0; d < BALANCE_MAX_DEVICES; d++)
+        plan->thermalScale[d] = 1.0;
+    plan->completionTime = 0.0;
+    plan->power = 0.0;
+}
+
+// excess in mAh and voltage in V of each cell, bleedResistance in Ohm,
+// maxPower in W for all the resistors and maxChannels the cells of a device
+// bleeding at once
+void balance_plan(BalancePlan *plan, const float *excess, const float *voltage, uint8_t numCells,
+        float bleedResistance, float maxPower, uint8_t maxChannels)
+{
+    float time[BALANCE_MAX_CELLS];
+    float groupTime[BALANCE_MAX_DEVICES][BALANCE_PHASES] = {{0.0}};
+    float maxTime = 0.0;
+    float energy = 0.0;
+
+    if (numCells > BALANCE_MAX_CELLS)
+        numCells = BALANCE_MAX_CELLS;
+    if (maxChannels < 1)
+        maxChannels = 1;
+    plan->numCells = numCells;
+    plan->maxChannels = maxChannels;
+
+    for (uint8_t i = 0; i < numCells; i++)
+    {
+        time[i] = 0.0;
+        if (excess[i] > 0.0 && voltage[i] > 0.0)
+        {
+            time[i] = excess[i] * 3.6 * bleedResistance / voltage[i];
+            energy += voltage[i] * voltage[i] / bleedResistance * time[i];
+        }
+        if (time[i] > maxTime)
+            maxTime = time[i];
+        groupTime[i / BALANCE_CELLS_PER_DEVICE][i % BALANCE_PHASES] += time[i];
+    }
+
+    // A cell only gets the slots of its phase, and the cells of a phase
+    // share maxChannels switches
+    float horizon = maxTime * BALANCE_PHASES;
+    for (uint8_t d = 0; d < BALANCE_MAX_DEVICES; d++)
+    {
+        for (uint8_t p = 0; p < BALANCE_PHASES; p++)
+        {
+            if (groupTime[d][p] * BALANCE_PHASES / maxChannels > horizon)
+                horizon = groupTime[d][p] * BALANCE_PHASES / maxChannels;
+        }
+    }
+    if (maxPower > 0.0 && energy / maxPower > horizon)
+        horizon = energy / maxPower;
+
+    plan->completionTime = horizon;
+    plan->power = horizon > 0.0 ? energy / horizon : 0.0;
+    for (uint8_t i = 0; i < numCells; i++)
+        plan->duty[i] = horizon > 0.0 ? time[i] / horizon : 0.0;
+}
+
+// Updates the share of the duty a device may bleed from its die
+// temperature, both in degree C, dt in s since the last update
+void balance_thermal(BalancePlan *plan, uint8_t device, float dieTemp, float targetTemp, float dt)
+{
+    if (device >= BALANCE_MAX_DEVICES)
+        return;
+
+    float scale = plan->thermalScale[device] + BALANCE_THERMAL_GAIN * (targetTemp - dieTemp) * dt;
+    if (dieTemp >= targetTemp + BALANCE_THERMAL_MARGIN || scale < 0.0)
+        scale = 0.0;
+    else if (scale > 1.0)
+        scale = 1.0;
+    plan->thermalScale[device] = scale;
+}
+
+// Cells to bleed until the next call, bit 0 for the first cell
+uint64_t balance_next(BalancePlan *plan)
+{
+    uint64_t mask = 0;
+
+    for (uint8_t first = 0; first < plan->numCells; first += BALANCE_CELLS_PER_DEVICE)
+    {
+        uint8_t last = first + BALANCE_CELLS_PER_DEVICE;
+        float scale = plan->thermalScale[first / BALANCE_CELLS_PER_DEVICE];
+        if (last > plan->numCells)
+            last = plan->numCells;
+
+        for (uint8_t i = first + plan->phase; i < last; i += BALANCE_PHASES)
+        {
+            if (plan->duty[i] <= 0.0)
+            {
+                plan->modulator[i] = 0.0;
+                continue;
+            }
+            plan->modulator[i] += plan->duty[i] * BALANCE_PHASES * scale;
+            if (plan->modulator[i] > BALANCE_MAX_DEBT)
+                plan->modulator[i] = BALANCE_MAX_DEBT;
+        }
+
+        // The cells the most behind get the switches of the slot
+        for (uint8_t channel = 0; channel < plan->maxChannels; channel++)
+        {
+            int8_t next = -1;
+            for (uint8_t i = first + plan->phase; i < last; i += BALANCE_PHASES)
+            {
+                if (!(mask & ((uint64_t)1 << i)) && plan->modulator[i] >= 1.0 &&
+                        (next < 0 || plan->modulator[i] > plan->modulator[next]))
+                    next = i;
+            }
+            if (next < 0)
+                break;
+            plan->modulator[next] -= 1.0;
+            mask |= (uint64_t)1 << next;
+        }
+    }
+    plan->phase = (plan->phase + 1) % BALANCE_PHASES;
+    return mask;
+}
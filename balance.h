@@ -0,0 +1,59 @@
+#ifndef _BALANCE_H_
+#define _BALANCE_H_
+
+// No ChibiOS dependency, the planner also builds on a host
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BALANCE_MAX_CELLS 36 // LTC6803_MAX_CELLS
+#define BALANCE_CELLS_PER_DEVICE 12 // LTC6803_CELLS_PER_DEVICE
+#define BALANCE_MAX_DEVICES (BALANCE_MAX_CELLS / BALANCE_CELLS_PER_DEVICE)
+#define BALANCE_PHASES 2 // Odd and even cells bleed in turn
+
+// Balancing policies, Config.balanceModes is a mask of them
+typedef enum
+{
+    BALANCE_MODE_NONE = 0x00,
+    BALANCE_MODE_TOP = 0x01, // While charging and at rest near full
+    BALANCE_MODE_BOTTOM = 0x02, // At rest near empty
+    BALANCE_MODE_DISCHARGE = 0x04, // During light discharge
+    BALANCE_MODE_DRAIN = 0x08 // Every cell, from the console only
+} BalanceMode;
+
+// When each policy runs, from the configuration
+typedef struct
+{
+    uint8_t modes;              // BalanceMode mask of the enabled policies
+    bool drain;
+    float lowVoltage;           // V, nothing runs with a cell below
+    float startVoltage;         // V, top balancing above it
+    float bottomVoltage;        // V, bottom balancing below it
+    float restCurrent;          // A, at rest below it
+    float dischargeCurrent;     // A, discharge balancing below it
+    float topDifference;        // V, spread that starts each policy
+    float bottomDifference;
+    float dischargeDifference;
+} BalancePolicy;
+
+typedef struct
+{
+    uint8_t numCells;
+    uint8_t maxChannels;                // Per device and slot
+    uint8_t phase;
+    float duty[BALANCE_MAX_CELLS];      // Fraction of the time bleeding
+    float modulator[BALANCE_MAX_CELLS];
+    float thermalScale[BALANCE_MAX_DEVICES]; // Fraction of the duty the die allows
+    float completionTime;               // s, until the last cell is balanced
+    float power;                        // W, average bleed power
+} BalancePlan;
+
+BalanceMode balance_mode(const BalancePolicy *policy, float minVoltage, float maxVoltage, float current,
+        bool charging);
+float balance_threshold(const BalancePolicy *policy, BalanceMode mode);
+void balance_init(BalancePlan *plan);
+void balance_plan(BalancePlan *plan, const float *excess, const float *voltage, uint8_t numCells,
+        float bleedResistance, float maxPower, uint8_t maxChannels);
+void balance_thermal(BalancePlan *plan, uint8_t device, float dieTemp, float targetTemp, float dt);
+uint64_t balance_next(BalancePlan *plan);
+
+#endif /* _BALANCE_H_ */
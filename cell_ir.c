@@ -0,0 +1,140 @@
+#include "cell_ir.h"
+#include "cell_stats.h"
+#include "current_monitor.h"
+#include "seqlock.h"
+#include <string.h>
+
+// Internal resistance of each cell. Every new LTC6803 scan is paired with
+// the average current measured while the cells were converted, and a
+// recursive least squares fit of V = OCV - R * I is updated per cell. The
+// forgetting factor makes it a sliding window of about 100 scans so the
+// open circuit voltage can follow the state of charge. The fit only moves
+// when the current changes, the covariance is bounded so that it does not
+// wind up during long periods of constant current.
+
+#define FORGETTING_FACTOR 0.99
+#define INITIAL_COVARIANCE 1.0
+#define MAX_COVARIANCE 100.0
+#define MIN_CURRENT_STEP 0.5 // A, current change needed to update the fit
+#define MIN_RESISTANCE 0.0 // Ohm
+#define MAX_RESISTANCE 1.0 // Ohm
+
+typedef struct
+{
+    float ocv; // V
+    float resistance; // Ohm
+    float p[3]; // Covariance: p00, p01, p11
+} CellFit;
+
+static CellFit fits[LTC6803_MAX_CELLS];
+static float resistances[LTC6803_MAX_CELLS];
+static seqlock_t resistancesLock;
+static uint8_t numCells;
+static uint32_t lastSeq;
+static float lastCurrent;
+static bool started;
+
+static void cell_ir_reset(CellFit *fit, float voltage);
+static void cell_ir_fit(CellFit *fit, float voltage, float current);
+
+void cell_ir_init(void)
+{
+    seqlock_init(&resistancesLock);
+    memset(resistances, 0, sizeof(resistances));
+    numCells = 0;
+    lastSeq = 0;
+    started = false;
+}
+
+void cell_ir_update(void)
+{
+    CellStats cells;
+    float current;
+    float newResistances[LTC6803_MAX_CELLS];
+
+    cell_stats_get(&cells);
+    if (cells.seq == lastSeq)
+        return;
+    lastSeq = cells.seq;
+    if (!current_monitor_get_average_current(cells.scanStart, cells.scanEnd, &current))
+        return;
+
+    if (!started || cells.numCells != numCells)
+    {
+        for (uint8_t i = 0; i < cells.numCells; i++)
+            cell_ir_reset(&fits[i], cells.cellMv[i] / 1000.0);
+        numCells = cells.numCells;
+        lastCurrent = current;
+        started = true;
+        return;
+    }
+
+    if (current - lastCurrent < MIN_CURRENT_STEP && lastCurrent - current < MIN_CURRENT_STEP)
+        return;
+    lastCurrent = current;
+
+    for (uint8_t i = 0; i < numCells; i++)
+    {
+        cell_ir_fit(&fits[i], cells.cellMv[i] / 1000.0, current);
+        newResistances[i] = fits[i].resistance;
+    }
+    seqlock_publish(&resistancesLock, resistances, newResistances, numCells * sizeof(float));
+}
+
+// Copies the resistance of each cell (Ohm), returns the number of cells
+uint8_t cell_ir_get_resistances(float r[LTC6803_MAX_CELLS])
+{
+    uint8_t n = numCells;
+    seqlock_snapshot(&resistancesLock, r, resistances, n * sizeof(float));
+    return n;
+}
+
+// Average cell resistance (Ohm), 0 until the current has changed
+float cell_ir_get_average(void)
+{
+    float r[LTC6803_MAX_CELLS];
+    uint8_t n = cell_ir_get_resistances(r);
+    float sum = 0.0;
+    for (uint8_t i = 0; i < n; i++)
+        sum += r[i];
+    return n > 0 ? sum / n : 0.0;
+}
+
+static void cell_ir_reset(CellFit *fit, float voltage)
+{
+    fit->ocv = voltage;
+    fit->resistance = 0.0;
+    fit->p[0] = INITIAL_COVARIANCE;
+    fit->p[1] = 0.0;
+    fit->p[2] = INITIAL_COVARIANCE;
+}
+
+// One RLS step with the regressor (1, -I)
+static void cell_ir_fit(CellFit *fit, float voltage, float current)
+{
+    float *p = fit->p;
+    float pPhi0 = p[0] - p[1] * current;
+    float pPhi1 = p[1] - p[2] * current;
+    float denominator = FORGETTING_FACTOR + pPhi0 - current * pPhi1;
+    float k0 = pPhi0 / denominator;
+    float k1 = pPhi1 / denominator;
+    float error = voltage - (fit->ocv - fit->resistance * current);
+
+    fit->ocv += k0 * error;
+    fit->resistance += k1 * error;
+    if (fit->resistance < MIN_RESISTANCE)
+        fit->resistance = MIN_RESISTANCE;
+    else if (fit->resistance > MAX_RESISTANCE)
+        fit->resistance = MAX_RESISTANCE;
+
+    p[0] = (p[0] - k0 * pPhi0) / FORGETTING_FACTOR;
+    p[1] = (p[1] - k0 * pPhi1) / FORGETTING_FACTOR;
+    p[2] = (p[2] - k1 * pPhi1) / FORGETTING_FACTOR;
+    if (p[0] + p[2] > MAX_COVARIANCE)
+    {
+        float scale = MAX_COVARIANCE / (p[0] + p[2]);
+        p[0] *= scale;
+        p[1] *= scale;
+        p[2] *= scale;
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef _CELL_IR_H_
+#define _CELL_IR_H_
+
+#include "ch.h"
+#include "ltc6803.h"
+
+void cell_ir_init(void);
+void cell_ir_update(void);
+uint8_t cell_ir_get_resistances(float resistances[LTC6803_MAX_CELLS]);
+float cell_ir_get_average(void);
+
+#endif /* _CELL_IR_H_ */
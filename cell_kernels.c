@@ -0,0 +1,110 @@
+#include "cell_kernels.h"
+#include "hal.h"
+#include <string.h>
+
+// Integer kernels of the cell voltage pipeline. The voltages are kept in mV
+// from the LTC6803 registers to the protections, two cells are packed in
+// the halfwords of a word and processed together with the Cortex-M4 SIMD
+// instructions. The simulator and other targets use the plain C versions.
+
+#if defined(__ARM_FEATURE_SIMD32)
+#define CELL_KERNELS_SIMD
+#endif
+
+#define CODE_OFFSET 512
+
+#ifdef CELL_KERNELS_SIMD
+// The pairs are moved with memcpy, accessing the uint16_t arrays through a
+// uint32_t lvalue would break strict aliasing. On aligned data it compiles
+// to a single LDR/STR.
+static inline uint32_t load_pair(const uint16_t *mv)
+{
+    uint32_t pair;
+    memcpy(&pair, mv, sizeof(pair));
+    return pair;
+}
+
+static inline void store_pair(uint16_t *mv, uint32_t pair)
+{
+    memcpy(mv, &pair, sizeof(pair));
+}
+#endif
+
+#ifndef CELL_KERNELS_SIMD
+// 1.5mV per LSB with a 512 offset, codes below the offset read 0
+static inline uint16_t code_to_mv(uint16_t code)
+{
+    if (code <= CODE_OFFSET)
+        return 0;
+    code -= CODE_OFFSET;
+    return code + (code >> 1);
+}
+#endif
+
+// Converts the cell voltage register, two 12 bits codes per 3 bytes, num
+// must be even
+void cell_kernels_unpack(const uint8_t *reg, uint16_t *mv, uint8_t num)
+{
+    for (uint8_t k = 0; k < num; k += 2, reg += 3)
+    {
+#ifdef CELL_KERNELS_SIMD
+        uint32_t codes = reg[0] | ((uint32_t)(reg[1] & 0x0F) << 8) |
+                ((uint32_t)(reg[1] >> 4) << 16) | ((uint32_t)reg[2] << 20);
+        codes = __UQSUB16(codes, (CODE_OFFSET << 16) | CODE_OFFSET);
+        store_pair(&mv[k], __UADD16(codes, (codes >> 1) & 0x7FFF7FFF));
+#else
+        mv[k] = code_to_mv(reg[0] | ((uint16_t)(reg[1] & 0x0F) << 8));
+        mv[k + 1] = code_to_mv((reg[1] >> 4) | ((uint16_t)reg[2] << 4));
+#endif
+    }
+}
+
+void cell_kernels_min_max(const uint16_t *mv, uint8_t num, uint16_t *min, uint16_t *max)
+{
+    uint16_t lowest = 0xFFFF;
+    uint16_t highest = 0;
+    uint8_t k = 0;
+
+#ifdef CELL_KERNELS_SIMD
+    uint32_t low = 0xFFFFFFFF;
+    uint32_t high = 0;
+    for (; k + 1 < num; k += 2)
+    {
+        uint32_t pair = load_pair(&mv[k]);
+        // USUB16 sets the GE flags of the halfwords where pair >= operand
+        __USUB16(pair, low);
+        low = __SEL(low, pair);
+        __USUB16(pair, high);
+        high = __SEL(pair, high);
+    }
+    lowest = (low & 0xFFFF) < (low >> 16) ? (low & 0xFFFF) : (low >> 16);
+    highest = (high & 0xFFFF) > (high >> 16) ? (high & 0xFFFF) : (high >> 16);
+#endif
+    for (; k < num; k++)
+    {
+        if (mv[k] < lowest)
+            lowest = mv[k];
+        if (mv[k] > highest)
+            highest = mv[k];
+    }
+    if (num == 0)
+        lowest = 0;
+    *min = lowest;
+    *max = highest;
+}
+
+uint32_t cell_kernels_sum(const uint16_t *mv, uint8_t num)
+{
+    uint32_t sum = 0;
+    uint8_t k = 0;
+
+#ifdef CELL_KERNELS_SIMD
+    // The cell voltages stay below 32768mV, the signed dual multiply
+    // accumulate adds both halfwords at once
+    for (; k + 1 < num; k += 2)
+        sum = __SMLAD(load_pair(&mv[k]), 0x00010001, sum);
+#endif
+    for (; k < num; k++)
+        sum += mv[k];
+    return sum;
+}
@@ -0,0 +1,14 @@
+#ifndef _CELL_KERNELS_H_
+#define _CELL_KERNELS_H_
+
+#include "ch.h"
+
+// The cell arrays are processed two cells per word, they must be 32 bits
+// aligned
+#define CELL_KERNELS_ALIGNED __attribute__((aligned(4)))
+
+void cell_kernels_unpack(const uint8_t *reg, uint16_t *mv, uint8_t num);
+void cell_kernels_min_max(const uint16_t *mv, uint8_t num, uint16_t *min, uint16_t *max);
+uint32_t cell_kernels_sum(const uint16_t *mv, uint8_t num);
+
+#endif /* _CELL_KERNELS_H_ */
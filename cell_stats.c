@@ -0,0 +1,62 @@
+#include "cell_stats.h"
+#include "seqlock.h"
+#include <string.h>
+
+// Statistics of the cell voltages, computed once per LTC6803 scan. The
+// measurement thread publishes a new snapshot after each scan and the
+// other modules copy it instead of reading the cell array of the driver,
+// so they all see the cells and their statistics of the same scan.
+
+static CellStats published;
+static CellStats work;
+static seqlock_t publishedLock;
+
+static uint8_t cell_stats_find(const uint16_t *cellMv, uint8_t numCells, uint16_t mv);
+
+void cell_stats_init(void)
+{
+    memset(&published, 0, sizeof(published));
+    seqlock_init(&publishedLock);
+}
+
+// Called by the LTC6803 driver with the cells of a new scan
+void cell_stats_update(const uint16_t *cellMv, uint8_t numCells, systime_t scanStart, systime_t scanEnd)
+{
+    if (numCells > LTC6803_MAX_CELLS)
+        numCells = LTC6803_MAX_CELLS;
+
+    work.numCells = numCells;
+    memcpy(work.cellMv, cellMv, numCells * sizeof(uint16_t));
+    cell_kernels_min_max(work.cellMv, numCells, &work.minMv, &work.maxMv);
+    work.minCell = cell_stats_find(work.cellMv, numCells, work.minMv);
+    work.maxCell = cell_stats_find(work.cellMv, numCells, work.maxMv);
+    work.sumMv = cell_kernels_sum(work.cellMv, numCells);
+    work.meanMv = numCells > 0 ? work.sumMv / numCells : 0;
+    work.spreadMv = work.maxMv - work.minMv;
+    work.scanStart = scanStart;
+    work.scanEnd = scanEnd;
+
+    work.seq = published.seq + 1;
+    seqlock_publish(&publishedLock, &published, &work, sizeof(published));
+}
+
+void cell_stats_get(CellStats *stats)
+{
+    seqlock_snapshot(&publishedLock, stats, &published, sizeof(published));
+}
+
+// Sequence number of the last snapshot, 0 before the first scan
+uint32_t cell_stats_get_seq(void)
+{
+    return published.seq;
+}
+
+static uint8_t cell_stats_find(const uint16_t *cellMv, uint8_t numCells, uint16_t mv)
+{
+    for (uint8_t i = 0; i < numCells; i++)
+    {
+        if (cellMv[i] == mv)
+            return i;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef _CELL_STATS_H_
+#define _CELL_STATS_H_
+
+#include "ch.h"
+#include "ltc6803.h"
+#include "cell_kernels.h"
+
+// Cell voltages and statistics of one LTC6803 scan, in mV. The cell
+// numbers are 0 based, the cells were converted between scanStart and
+// scanEnd.
+typedef struct
+{
+    uint32_t seq;
+    uint8_t numCells;
+    uint16_t cellMv[LTC6803_MAX_CELLS] CELL_KERNELS_ALIGNED;
+    uint16_t minMv;
+    uint16_t maxMv;
+    uint8_t minCell;
+    uint8_t maxCell;
+    uint16_t meanMv;
+    uint16_t spreadMv;
+    uint32_t sumMv;
+    systime_t scanStart;
+    systime_t scanEnd;
+} CellStats;
+
+void cell_stats_init(void);
+void cell_stats_update(const uint16_t *cellMv, uint8_t numCells, systime_t scanStart, systime_t scanEnd);
+void cell_stats_get(CellStats *stats);
+uint32_t cell_stats_get_seq(void);
+
+#endif /* _CELL_STATS_H_ */
@@ -0,0 +1,57 @@
+#include "charge_control.h"
+
+// CC/CV charge controller. The charger output is set to the voltage that
+// drives the target current into the pack, fed forward from its open
+// circuit voltage and its resistance, plus a PI correction on the current
+// error:
+//   V = (Vpack - I.Rpack) + Itarget.Rpack + Kp.e + integral
+// The pack voltage follows the charger output, feeding it forward without
+// taking the drop of the current out would close a second loop.
+// The output is limited to the charge voltage, which is the CV phase: the
+// current tapers off by itself as the pack reaches it. It is also slew
+// rate limited so the charger does not overshoot when it starts. While the
+// output is limited, back-calculation bleeds the integral towards the
+// limited output with the time constant of the PI (Kp / Ki), so it does
+// not wind up and the CV to CC transition is bumpless.
+
+void charge_control_init(ChargeControl *control, float output)
+{
+    control->integral = 0.0;
+    control->output = output;
+    control->cv = false;
+}
+
+// Currents in A, positive into the pack, voltages in V, packResistance in
+// Ohm and dt in s since the last update. Returns the charger output.
+float charge_control_update(ChargeControl *control, const ChargeControlParams *params, float targetCurrent,
+        float current, float packVoltage, float packResistance, float dt)
+{
+    float error = targetCurrent - current;
+    float openCircuit = packVoltage - current * packResistance;
+    float output = openCircuit + targetCurrent * packResistance + params->gainP * error + control->integral;
+    float limited = output;
+
+    control->cv = false;
+    if (limited >= params->chargeVoltage)
+    {
+        limited = params->chargeVoltage;
+        control->cv = true;
+    }
+    if (params->slewRate > 0.0)
+    {
+        float step = params->slewRate * dt;
+        if (limited > control->output + step)
+            limited = control->output + step;
+        else if (limited < control->output - step)
+            limited = control->output - step;
+    }
+    if (limited < 0.0)
+        limited = 0.0;
+
+    float tracking = params->gainP > 0.0 ? params->gainI / params->gainP : params->gainI;
+    if (tracking * dt > 1.0)
+        tracking = 1.0 / dt;
+    control->integral += (params->gainI * error + tracking * (limited - output)) * dt;
+    control->output = limited;
+    return limited;
+}
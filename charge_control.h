@@ -0,0 +1,27 @@
+#ifndef _CHARGE_CONTROL_H_
+#define _CHARGE_CONTROL_H_
+
+// No ChibiOS dependency, the controller also builds on a host
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    float gainP;         // V/A
+    float gainI;         // V/(A.s)
+    float chargeVoltage; // V, CV setpoint and highest output
+    float slewRate;      // V/s, 0 for no limit
+} ChargeControlParams;
+
+typedef struct
+{
+    float integral; // V
+    float output;   // V, charger output setpoint
+    bool cv;        // The output is held at the charge voltage
+} ChargeControl;
+
+void charge_control_init(ChargeControl *control, float output);
+float charge_control_update(ChargeControl *control, const ChargeControlParams *params, float targetCurrent,
+        float current, float packVoltage, float packResistance, float dt);
+
+#endif /* _CHARGE_CONTROL_H_ */
@@ -5,11 +5,29 @@
 #include "current_monitor.h"
 #include "power.h"
 #include "ltc6803.h"
+#include "cell_stats.h"
 #include "analog.h"
+#include "cell_ir.h"
+#include "soc.h"
+#include "balance.h"
+#include "charge_control.h"
+#include "i2c_bus.h"
 #include <math.h>
 
+#if !defined(BALANCE_RESISTANCE) || !defined(BALANCE_MAX_POWER) || !defined(BALANCE_MAX_CHANNELS) || \
+        !defined(BALANCE_DIE_TEMP)
+#error "No balancing parameters for this board, add the BALANCE_* defines to its hw_conf"
+#endif
+
 #define I2C_ADDRESS 0x1F
 
+// The excess charge of each cell over the lowest one is estimated from
+// their open circuit voltages, corrected with the cell resistances for the
+// charge current, and the planner of balance.c spreads the bleeding so
+// that all the cells finish together within the power budget of the
+// resistors. Charging goes on while balancing, unless the board is
+// already warm.
+
 static volatile Config *config;
 static volatile float charge_voltage;
 static volatile bool is_charging;
@@ -17,14 +35,22 @@ static volatile float input_voltage;
 static volatile float output_voltage;
 static volatile bool charge_enabled = true;
 static volatile bool storage = false;
-static volatile float current_control_integral = 0.0;
+static ChargeControl control;
+static volatile bool controlActive = false;
+static bool controlRunning = false;
 static volatile systime_t lastTime;
 static volatile bool balancing = false;
-static volatile systime_t balanceUpdateTime;
+static volatile BalanceMode balanceMode = BALANCE_MODE_NONE;
+static volatile bool drain = false;
+static BalancePlan balancePlan;
+static uint64_t balanceMask;
 static volatile bool chargeComplete = false;
 static volatile uint8_t chargeCompleteCounter = 0;
 
 static void set_voltage(float voltage);
+static void charger_balance_policy(BalancePolicy *policy);
+static BalanceMode charger_balance_mode(const CellStats *cells, bool charging);
+static void charger_balance(const CellStats *cells, BalanceMode mode, float dt);
 
 void charger_init(void)
 {
@@ -32,92 +58,39 @@ void charger_init(void)
     palSetPad(CHG_SW_GPIO, CHG_SW_PIN);
 #ifdef BATTMAN_4_0
     uint8_t tx[2];
-    uint8_t rx[2];
     tx[0] = 0x07 << 2;
     tx[1] = 0x01 << 1;
-    i2cMasterTransmitTimeout(&I2C_DEV, 0x2E, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_CHARGER, 0x2E, tx, 2, NULL, 0);
 #endif
     set_voltage(config->chargeVoltage);
     lastTime = chVTGetSystemTime();
-    balanceUpdateTime = chVTGetSystemTime();
+    balance_init(&balancePlan);
 }
 
 void charger_update(void)
 {
     input_voltage = analog_charger_input_voltage();
     is_charging = input_voltage > 6.0;
+    float dt = ST2US(chVTTimeElapsedSinceX(lastTime)) / 1e6;
+    CellStats cells;
+    cell_stats_get(&cells);
     if (charge_enabled && is_charging && !chargeComplete)
     {
         /*power_disable_discharge();*/
-        float currentErr;
-        float chargeVoltage;
-        float dt = ST2US(chVTTimeElapsedSinceX(lastTime)) / 1e6;
-        float* cells;
-        cells = ltc6803_get_cell_voltages();
-        float highestCellV = 0.0;
-        float lowestCellV = 999.0;
-        uint8_t lowestCellNum;
-        if (!balancing)
-        {
-            for (uint8_t i = 0; i < config->numCells; i++)
-            {
-                if (cells[i] > highestCellV)
-                {
-                    highestCellV = cells[i];
-                }
-                if (cells[i] < lowestCellV)
-                {
-                    lowestCellV = cells[i];
-                    lowestCellNum = i;
-                }
-            }
-            if ((highestCellV >= config->balanceStartVoltage && highestCellV - lowestCellV > config->balanceDifferenceThreshold) && ST2MS(chVTTimeElapsedSinceX(balanceUpdateTime)) > 10000 && !chargeComplete)
-            {
-                balancing = true;
-                balanceUpdateTime = chVTGetSystemTime();
-            }
-        }
-        if (balancing)
+        charger_balance(&cells, charger_balance_mode(&cells, true), dt);
+        if (balancing && analog_temperature() >= config->tempBoardWarning)
         {
+            controlActive = false;
             palClearPad(CHG_SW_GPIO, CHG_SW_PIN);
-            balancing = true;
-            if (ST2MS(chVTTimeElapsedSinceX(balanceUpdateTime)) > 500)
-            {
-                bool continueBalance = false;
-                for (uint8_t i = 0; i < config->numCells; i++)
-                {
-                    if (cells[i] > cells[lowestCellNum])
-                    {
-                        ltc6803_enable_balance(i + 1);
-                        continueBalance = true;
-                    }
-                    else
-                    {
-                        ltc6803_disable_balance(i + 1);
-                    }
-                }
-                balancing = continueBalance;
-                balanceUpdateTime = chVTGetSystemTime();
-            }
         }
-        else if (highestCellV < config->highVoltageCutoff)
+        else if (cells.maxMv < (uint16_t)(config->highVoltageCutoff * 1000.0))
         {
             palSetPad(CHG_SW_GPIO, CHG_SW_PIN);
+            controlActive = config->chargeMode == CURRENT_CONTROL;
             switch(config->chargeMode)
             {
                 case CURRENT_CONTROL:
-
-                    currentErr = config->chargeCurrent - (-current_monitor_get_current());
-                    current_control_integral += currentErr * dt;
-                    // Windup protection
-                    if (current_control_integral > 0)
-                        current_control_integral = 0;
-                    else if (current_control_integral < -config->chargeVoltage)
-                        current_control_integral = -config->chargeVoltage;
-                    chargeVoltage = config->chargeVoltage + currentErr * config->chargeCurrentGain_P + current_control_integral * config->chargeCurrentGain_I;
-                    if (chargeVoltage > config->chargeVoltage)
-                        chargeVoltage = config->chargeVoltage;
-                    set_voltage(chargeVoltage);
+                    // charger_control_update sets the output
                     break;
                 case FULL_CURRENT:
                     set_voltage(config->chargeVoltage);
@@ -129,7 +102,7 @@ void charger_update(void)
                     set_voltage(0);
                     break;
             }
-            if (current_monitor_get_bus_voltage() >= config->chargeVoltage && fabs(current_monitor_get_current()) < config->chargeCurrent / 10.0)
+            if (!balancing && current_monitor_get_bus_voltage() >= config->chargeVoltage && fabs(current_monitor_get_current()) < config->chargeCurrent / 10.0)
             {
                 chargeCompleteCounter++;
                 if (chargeCompleteCounter > 100)
@@ -142,11 +115,13 @@ void charger_update(void)
         }
         else
         {
+            controlActive = false;
             palClearPad(CHG_SW_GPIO, CHG_SW_PIN);
         }
     }
     else
     {
+        controlActive = false;
         if (!is_charging)
         {
             palSetPad(CHG_SW_GPIO, CHG_SW_PIN);
@@ -155,9 +130,7 @@ void charger_update(void)
         }
         else
             palClearPad(CHG_SW_GPIO, CHG_SW_PIN);
-        current_control_integral = 0.0;
-        balancing = false;
-        ltc6803_disable_balance_all();
+        charger_balance(&cells, charger_balance_mode(&cells, false), dt);
     }
     lastTime = chVTGetSystemTime();
 	
@@ -165,6 +138,42 @@ void charger_update(void)
 	
 }
 
+// Current control of the charger output, at a fixed rate so that the
+// loop does not depend on the timing of charger_update
+void charger_control_update(void)
+{
+    if (!controlActive)
+    {
+        controlRunning = false;
+        return;
+    }
+
+    CellStats cells;
+    float resistances[LTC6803_MAX_CELLS];
+    float packResistance = 0.0;
+    cell_stats_get(&cells);
+    uint8_t numResistances = cell_ir_get_resistances(resistances);
+    for (uint8_t i = 0; i < numResistances; i++)
+        packResistance += resistances[i];
+    float packVoltage = cells.numCells > 0 ? cells.sumMv / 1000.0 : current_monitor_get_bus_voltage();
+
+    // Start from the pack voltage, no current flows into it yet
+    if (!controlRunning)
+    {
+        charge_control_init(&control, packVoltage);
+        controlRunning = true;
+    }
+
+    ChargeControlParams params = {
+        .gainP = config->chargeCurrentGain_P,
+        .gainI = config->chargeCurrentGain_I,
+        .chargeVoltage = config->chargeVoltage,
+        .slewRate = config->chargeSlewRate
+    };
+    set_voltage(charge_control_update(&control, &params, config->chargeCurrent, -current_monitor_get_current(),
+            packVoltage, packResistance, CHARGER_CONTROL_PERIOD / 1000.0));
+}
+
 bool charger_is_charging(void)
 {
     return is_charging && !chargeComplete;
@@ -175,6 +184,143 @@ bool charger_is_balancing(void)
     return balancing;
 }
 
+BalanceMode charger_get_balance_mode(void)
+{
+    return balancing ? balanceMode : BALANCE_MODE_NONE;
+}
+
+// Bleeds every cell through the balance scheduler, down to the low voltage
+// cutoff
+void charger_drain(bool enable)
+{
+    drain = enable;
+}
+
+// Duty of each cell and time to the end of the balancing
+void charger_get_balance_plan(BalancePlan *plan)
+{
+    *plan = balancePlan;
+}
+
+// The policies of the configuration and the drain request of the console
+static void charger_balance_policy(BalancePolicy *policy)
+{
+    policy->modes = config->balanceModes;
+    policy->drain = drain;
+    policy->lowVoltage = config->lowVoltageCutoff;
+    policy->startVoltage = config->balanceStartVoltage;
+    policy->bottomVoltage = config->balanceBottomVoltage;
+    policy->restCurrent = config->balanceRestCurrent;
+    policy->dischargeCurrent = config->balanceDischargeCurrent;
+    policy->topDifference = config->balanceDifferenceThreshold;
+    policy->bottomDifference = config->balanceBottomDifference;
+    policy->dischargeDifference = config->balanceDischargeDifference;
+}
+
+// The balancing policy of the configuration that applies to the pack right
+// now
+static BalanceMode charger_balance_mode(const CellStats *cells, bool charging)
+{
+    BalancePolicy policy;
+
+    if (cells->numCells == 0)
+        return BALANCE_MODE_NONE;
+    charger_balance_policy(&policy);
+    return balance_mode(&policy, cells->minMv / 1000.0, cells->maxMv / 1000.0, current_monitor_get_current(),
+            charging);
+}
+
+// Starts when the cells differ by more than the threshold of the mode, a
+// cell bleeds until it is within half of it from the lowest cell. Called
+// every update, one modulation slot.
+static void charger_balance(const CellStats *cells, BalanceMode mode, float dt)
+{
+    BalancePolicy policy;
+
+    charger_balance_policy(&policy);
+    float threshold = balance_threshold(&policy, mode);
+
+    // Leaving the policy the plan was made for ends it, the next one starts
+    // from the spread again
+    if (balancing && mode != balanceMode)
+    {
+        balancing = false;
+        balanceMask = 0;
+        ltc6803_disable_balance_all();
+    }
+    balanceMode = mode;
+    if (!balancing && mode != BALANCE_MODE_NONE &&
+            (mode == BALANCE_MODE_DRAIN || cells->spreadMv > (uint16_t)(threshold * 1000.0)))
+    {
+        balancing = true;
+        balance_init(&balancePlan);
+    }
+    if (!balancing)
+        return;
+
+    float resistances[LTC6803_MAX_CELLS];
+    float voltage[LTC6803_MAX_CELLS];
+    float excess[LTC6803_MAX_CELLS];
+    float ocv[LTC6803_MAX_CELLS];
+    uint8_t numResistances = cell_ir_get_resistances(resistances);
+    float current = current_monitor_get_current();
+    float minOcv = 0.0;
+
+    for (uint8_t i = 0; i < cells->numCells; i++)
+    {
+        voltage[i] = cells->cellMv[i] / 1000.0;
+        ocv[i] = voltage[i];
+        if (i < numResistances)
+            ocv[i] += current * resistances[i];
+        if (i == 0 || ocv[i] < minOcv)
+            minOcv = ocv[i];
+    }
+
+    float minSoc = soc_from_ocv(minOcv);
+    bool needed = false;
+    for (uint8_t i = 0; i < cells->numCells; i++)
+    {
+        excess[i] = 0.0;
+        if (mode == BALANCE_MODE_DRAIN)
+        {
+            excess[i] = soc_from_ocv(ocv[i]) * config->packCapacity;
+            needed = true;
+        }
+        else if (ocv[i] - minOcv > threshold / 2.0)
+        {
+            excess[i] = (soc_from_ocv(ocv[i]) - minSoc) * config->packCapacity;
+            needed = true;
+        }
+    }
+
+    if (!needed)
+    {
+        balancing = false;
+        balanceMask = 0;
+        ltc6803_disable_balance_all();
+        return;
+    }
+
+    float *temp = ltc6803_get_temp();
+    for (uint8_t d = 0; d < ltc6803_get_num_devices(); d++)
+        balance_thermal(&balancePlan, d, temp[d * LTC6803_TEMPS_PER_DEVICE + 2], BALANCE_DIE_TEMP, dt);
+    balance_plan(&balancePlan, excess, voltage, cells->numCells, BALANCE_RESISTANCE, BALANCE_MAX_POWER,
+            BALANCE_MAX_CHANNELS);
+    uint64_t mask = balance_next(&balancePlan);
+    for (uint8_t i = 0; i < cells->numCells; i++)
+    {
+        uint64_t bit = (uint64_t)1 << i;
+        if ((mask ^ balanceMask) & bit)
+        {
+            if (mask & bit)
+                ltc6803_enable_balance(i + 1);
+            else
+                ltc6803_disable_balance(i + 1);
+        }
+    }
+    balanceMask = mask;
+}
+
 float charger_get_input_voltage(void)
 {
     return input_voltage;
@@ -198,15 +344,10 @@ void charger_disable(void)
 
 static void set_voltage(float voltage)
 {
-    i2cAcquireBus(&I2C_DEV);
+    uint16_t value = 0;
 #ifdef BATTMAN_4_0
     float resistance = (5100 * voltage - 1.26 * (5100 + 200000)) / (1.26 - voltage);
-    uint16_t value = (uint16_t)((resistance / 20000) * 1024);
-    uint8_t tx[2];
-    uint8_t rx[2];
-    tx[0] = 0x01 << 2 | ((value >> 8) & 0x03);
-    tx[1] = value & 0xFF;
-    i2cMasterTransmitTimeout(&I2C_DEV, 0x2E, tx, 2, rx, 0, MS2ST(10));
+    value = (uint16_t)((resistance / 20000) * 1024);
 #elif defined(BATTMAN_4_1) || defined(BATTMAN_4_2)
 #if defined(BATTMAN_4_1)
     float dac_voltage = 0.075 * (51.66 - voltage);
@@ -217,14 +358,23 @@ static void set_voltage(float voltage)
         dac_voltage = 0;
     else if (dac_voltage > 3.3)
         dac_voltage = 3.3;
-    uint16_t value = (uint16_t)((dac_voltage / 3.3) * 16383);
+    value = (uint16_t)((dac_voltage / 3.3) * 16383);
+#endif
+    output_voltage = voltage;
+
+    // The bus skips the write when the code has not changed
+#ifdef BATTMAN_4_0
+    uint8_t tx[2];
+    tx[0] = 0x01 << 2 | ((value >> 8) & 0x03); // RDAC write, the command carries the top bits
+    tx[1] = value & 0xFF;
+    i2c_bus_write_register(I2C_BUS_CHARGER, 0x2E, 0x01, tx, 2);
+#elif defined(BATTMAN_4_1) || defined(BATTMAN_4_2)
     uint8_t tx[3];
-    uint8_t rx[2];
     tx[0] = 0x01;
     tx[1] = (uint8_t)(value >> 6);
     tx[2] = (uint8_t)((value & 0xFF) << 2);
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 3, rx, 0, MS2ST(10));
+    i2c_bus_write_register(I2C_BUS_CHARGER, I2C_ADDRESS, tx[0], tx, 3);
+#else
+    (void)value;
 #endif
-    output_voltage = voltage;
-    i2cReleaseBus(&I2C_DEV);
 }
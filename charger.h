@@ -2,11 +2,19 @@
 #define _CHARGER_H_
 
 #include "ch.h"
+#include "balance.h"
+#include "datatypes.h"
+
+#define CHARGER_CONTROL_PERIOD 10 // ms
 
 void charger_init(void);
 void charger_update(void);
+void charger_control_update(void);
 bool charger_is_charging(void);
 bool charger_is_balancing(void);
+BalanceMode charger_get_balance_mode(void);
+void charger_drain(bool enable);
+void charger_get_balance_plan(BalancePlan *plan);
 float charger_get_input_voltage(void);
 float charger_get_output_voltage(void);
 void charger_enable(void);
@@ -524,6 +524,14 @@
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
 
+/*
+ * The idle thread sleeps with WFI until the next interrupt. The core clock
+ * and the DWT cycle counter read by chSysGetRealtimeCounterX() stop in
+ * sleep unless DBGMCU_CR_DBG_SLEEP is set, main() only sets it in the
+ * FW_PROFILING builds of fw_conf.h.
+ */
+#define CORTEX_ENABLE_WFI_IDLE              TRUE
+
 #endif  /* _CHCONF_H_ */
 
 /** @} */
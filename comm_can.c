@@ -7,6 +7,8 @@
 #include "config.h"
 #include "utils.h"
 #include "power.h"
+#include "current_monitor.h"
+#include <math.h>
 
 #define RX_FRAMES_SIZE  100
 
@@ -119,8 +121,18 @@ float comm_can_get_infinity_current(void)
     return (float)infinity_current;
 }
 
+// Overcurrent headroom and thermal current, broadcast for the motor
+// controllers to limit their current before the trip
 void comm_can_update(void)
 {
+    uint8_t data[8];
+    uint32_t ind = 0;
+    I2tState i2t;
+
+    current_monitor_get_i2t(&i2t);
+    utils_append_float32(data, current_monitor_get_headroom(), &ind);
+    utils_append_float32(data, sqrtf(i2t.heat), &ind);
+    comm_can_transmit(CAN_BROADCAST, CAN_PACKET_BATTMAN_OVERCURRENT, data, ind);
 }
 
 void comm_can_transmit(uint8_t receiver, CANPacketID packetID, uint8_t *data, uint8_t len)
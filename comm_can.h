@@ -6,6 +6,9 @@
 
 #define CAN_BROADCAST 0xFF
 
+// BattMan packets not in can_data.h of the infinibatt library
+#define CAN_PACKET_BATTMAN_OVERCURRENT ((CANPacketID)0x80)
+
 void comm_can_init(void);
 void comm_can_update(void);
 void comm_can_transmit(uint8_t receiver, CANPacketID packetID, uint8_t *data, uint8_t len);
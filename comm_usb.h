@@ -1,9 +1,11 @@
 #ifndef _COMM_USB_H_
 #define _COMM_USB_H_
 
+#if HAL_USE_SERIAL_USB
 extern const USBConfig usbcfg;
 extern SerialUSBConfig serusbcfg;
 extern SerialUSBDriver SDU1;
+#endif
 
 void comm_usb_init(void);
 void comm_usb_deinit(void);
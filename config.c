@@ -7,22 +7,29 @@
 #include "utils.h"
 #include <stddef.h>
 #include "current_monitor.h"
+#include "ltc6803.h"
 
 #define EEPROM_BASE              1000
+#define EEPROM_STATE_BASE        2000
 
 // Global variables
 uint16_t VirtAddVarTab[NB_OF_VAR];
 
 static volatile Config config;
+static mutex_t eepromMutex; // The EEPROM emulation is not reentrant
 
 void config_init(void)
 {
+    chMtxObjectInit(&eepromMutex);
     memset(VirtAddVarTab, 0, sizeof(VirtAddVarTab));
 
     int ind = 0;
     for (unsigned int i = 0; i < (sizeof(Config) / 2); i++) {
 	VirtAddVarTab[ind++] = EEPROM_BASE + i;
     }
+    for (unsigned int i = 0; i < (CONFIG_STATE_SIZE / 2); i++) {
+	VirtAddVarTab[ind++] = EEPROM_STATE_BASE + i;
+    }
 
     FLASH_Unlock();
     FLASH_ClearFlag(FLASH_FLAG_WRPERR | FLASH_FLAG_PGERR);
@@ -62,6 +69,17 @@ void config_load_default_configuration(void)
 	//config.tempLTC6803BalCutoff = 85.0; //Hardcoded in temp.c
 	config.isBattTempSensor = false;
 	config.enBuzzer = true;
+    config.cellMeasurementPeriod = 0;
+    config.currentSamplePeriod = 1000;
+    config.currentAveraging = 0;
+    config.balanceModes = BALANCE_MODE_TOP | BALANCE_MODE_DISCHARGE;
+    config.balanceRestCurrent = 0.5;
+    config.balanceBottomVoltage = 3.6;
+    config.balanceBottomDifference = 0.02;
+    config.balanceDischargeCurrent = 5.0;
+    config.balanceDischargeDifference = 0.02;
+    config.chargeSlewRate = 5.0;
+    config.peakCurrentCutoff = 150.0;
 }
 
 Config* config_get_configuration(void)
@@ -71,6 +89,7 @@ Config* config_get_configuration(void)
 
 bool config_write_all(void)
 {
+    chMtxLock(&eepromMutex);
     utils_sys_lock_cnt();
 
     bool is_ok = true;
@@ -90,6 +109,7 @@ bool config_write_all(void)
     }
 
     utils_sys_unlock_cnt();
+    chMtxUnlock(&eepromMutex);
     return is_ok;
 }
 
@@ -101,9 +121,9 @@ bool config_write_field(uint16_t addr, uint8_t *data, uint8_t size)
     }
     else if (addr == offsetof(Config, numCells))
     {
-        if (*data > 12)
+        if (*data > LTC6803_MAX_CELLS)
         {
-            *data = 12;
+            *data = LTC6803_MAX_CELLS;
         }
     }
     else if (addr == offsetof(Config, lowVoltageCutoff))
@@ -133,22 +153,56 @@ bool config_write_field(uint16_t addr, uint8_t *data, uint8_t size)
     }
     else if (addr == offsetof(Config, maxCurrentCutoff))
     {
-        if (*((float*)data) > 150.0)
+        // The i2t curve point, the peak trip is not below it
+        if (*((float*)data) > config.peakCurrentCutoff)
         {
-            *((float*)data) = 150.0;
+            *((float*)data) = config.peakCurrentCutoff;
         }
         else if (*((float*)data) < 1.0)
         {
             *((float*)data) = 1.0;
         }
+    }
+    else if (addr == offsetof(Config, peakCurrentCutoff))
+    {
+        // Limit of the ISL28022 overcurrent threshold
+        if (*((float*)data) > CURRENT_MONITOR_MAX_THRESHOLD)
+        {
+            *((float*)data) = CURRENT_MONITOR_MAX_THRESHOLD;
+        }
+        else if (*((float*)data) < config.maxCurrentCutoff)
+        {
+            *((float*)data) = config.maxCurrentCutoff;
+        }
         current_monitor_set_overcurrent(*((float*)data));
     }
+    else if (addr == offsetof(Config, currentAveraging))
+    {
+        if (*data > 7)
+        {
+            *data = 7;
+        }
+        current_monitor_set_averaging(*data);
+    }
+    else if (addr == offsetof(Config, currentSamplePeriod))
+    {
+        // Time needed to read the shunt and bus voltages
+        if (*((uint16_t*)data) < CURRENT_MONITOR_MIN_PERIOD)
+        {
+            *((uint16_t*)data) = CURRENT_MONITOR_MIN_PERIOD;
+        }
+    }
+    else if (addr == offsetof(Config, balanceModes))
+    {
+        *data &= BALANCE_MODE_TOP | BALANCE_MODE_BOTTOM | BALANCE_MODE_DISCHARGE;
+    }
     else
     {
         /*return false;*/
     }
     memcpy((void*)&config + addr, (void*)data, size);
 
+    chMtxLock(&eepromMutex);
     utils_sys_lock_cnt();
 
     bool is_ok = true;
@@ -168,6 +222,7 @@ bool config_write_field(uint16_t addr, uint8_t *data, uint8_t size)
     }
 
     utils_sys_unlock_cnt();
+    chMtxUnlock(&eepromMutex);
     return is_ok;
 }
 
@@ -192,3 +247,56 @@ void config_read_all(void)
         config_write_all();
     }
 }
+
+// The state variables are stored like the configuration, 16 bits per
+// EEPROM variable. addr and size must be even.
+bool config_write_state(uint16_t addr, const void *data, uint8_t size)
+{
+    const uint8_t *state = (const uint8_t*)data;
+    bool is_ok = true;
+    uint16_t var;
+    uint16_t stored;
+
+    if (addr + size > CONFIG_STATE_SIZE)
+        return false;
+
+    // Only the other EEPROM writers are held off: the protection interrupts
+    // keep running while the flash is programmed
+    chMtxLock(&eepromMutex);
+    FLASH_ClearFlag(FLASH_FLAG_WRPERR | FLASH_FLAG_PGERR);
+
+    for (unsigned int i = 0; i < size; i += 2) {
+        var = (state[i] << 8) & 0xFF00;
+        var |= state[i + 1] & 0xFF;
+
+        // Each write appends to the page, an unchanged variable is skipped
+        if (EE_ReadVariable(EEPROM_STATE_BASE + (addr + i) / 2, &stored) == 0 && stored == var)
+            continue;
+        if (EE_WriteVariable(EEPROM_STATE_BASE + (addr + i) / 2, var) != FLASH_COMPLETE) {
+            is_ok = false;
+            break;
+        }
+    }
+
+    chMtxUnlock(&eepromMutex);
+    return is_ok;
+}
+
+// False if the state was never written, data is then left unchanged
+bool config_read_state(uint16_t addr, void *data, uint8_t size)
+{
+    uint8_t state[CONFIG_STATE_SIZE];
+    uint16_t var;
+
+    if (addr + size > CONFIG_STATE_SIZE)
+        return false;
+
+    for (unsigned int i = 0; i < size; i += 2) {
+        if (EE_ReadVariable(EEPROM_STATE_BASE + (addr + i) / 2, &var) != 0)
+            return false;
+        state[i] = (var >> 8) & 0xFF;
+        state[i + 1] = var & 0xFF;
+    }
+    memcpy(data, state, size);
+    return true;
+}
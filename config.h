@@ -5,11 +5,17 @@
 
 #include "ch.h"
 
+// Runtime state kept across power cycles, byte offsets
+#define CONFIG_STATE_CHARGE 0 // Charge in and out totals, 2 x int64_t
+#define CONFIG_STATE_SIZE 32
+
 void config_init(void);
 Config* config_get_configuration(void);
 void config_load_default_configuration(void);
 bool config_write_all(void);
 bool config_write_field(uint16_t addr, uint8_t *data, uint8_t size);
 void config_read_all(void);
+bool config_write_state(uint16_t addr, const void *data, uint8_t size);
+bool config_read_state(uint16_t addr, void *data, uint8_t size);
 
 #endif /* _CONFIG_H_ */
@@ -6,15 +6,31 @@
 #include "datatypes.h"
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 #include <chprintf.h>
 #include "memstreams.h"
 #include "config.h"
 #include "ltc6803.h"
+#include "cell_stats.h"
+#include "cell_ir.h"
+#include "fast_trip.h"
+#include "precharge.h"
+#include "charger.h"
+#include "soc.h"
 #include "rtcc.h"
 #include "current_monitor.h"
 #include "analog.h"
 #include "power.h"
 #include "comm_can.h"
+#include "scheduler.h"
+#include "i2c_bus.h"
+
+// Saved stack pointer of a thread, the context layout depends on the port
+#if defined(SIMULATOR)
+#define THREAD_STACK_POINTER(tp)    ((uint32_t)(tp)->p_ctx.esp)
+#else
+#define THREAD_STACK_POINTER(tp)    ((uint32_t)(tp)->p_ctx.r13)
+#endif
 
 void console_process_command(char *command)
 {
@@ -52,28 +68,127 @@ void console_process_command(char *command)
         tp = chRegFirstThread();
         do {
             console_printf("%.8lx %.8lx %4lu %4lu %9s %14s %lu\n",
-                    (uint32_t)tp, (uint32_t)tp->p_ctx.r13,
+                    (uint32_t)tp, THREAD_STACK_POINTER(tp),
                     (uint32_t)tp->p_prio, (uint32_t)(tp->p_refs - 1),
                     states[tp->p_state], tp->p_name, (uint32_t)tp->p_time);
             tp = chRegNextThread(tp);
         } while (tp != NULL);
         console_printf("\r\n");
     }
+    else if (strcmp(argv[0], "tasks") == 0) {
+        console_printf("           name prio period       runs     misses  worst us\n");
+        console_printf("----------------------------------------------------------\n");
+        for (uint8_t i = 0; i < scheduler_get_num_tasks(); i++)
+        {
+            const SchedulerTask *task = scheduler_get_task(i);
+            console_printf("%15s %4u %6lu %10lu %10lu %9lu\n",
+                    task->name, task->priority, (uint32_t)ST2MS(task->period),
+                    task->runs, task->deadlineMisses, (uint32_t)ST2US(task->worstCaseTime));
+        }
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "i2c") == 0) {
+        // ST2MS overflows after 2^32 / 1000 ticks
+        float uptimeUs = chVTGetSystemTime() * (1000000.0 / CH_CFG_ST_FREQUENCY);
+        console_printf("           name  transfers    skipped errors  load worst us  wait us\n");
+        console_printf("------------------------------------------------------------------\n");
+        for (uint8_t d = 0; d < I2C_BUS_NUM_DEVICES; d++)
+        {
+            I2cBusStats stats;
+            i2c_bus_get_stats(d, &stats);
+            console_printf("%15s %10lu %10lu %6lu %4.1f%% %8lu %8lu\n",
+                    i2c_bus_get_name(d), stats.transfers, stats.skippedWrites, stats.errors,
+                    uptimeUs > 0.0 ? stats.busTime / uptimeUs * 100.0 : 0.0, stats.worstBusTime, stats.worstWaitTime);
+        }
+        console_printf("\r\n");
+    }
     else if (strcmp(argv[0], "uptime") == 0) {
         console_printf("System uptime: %d seconds\n", ST2S(chVTGetSystemTime()));
         console_printf("\r\n");
     }
     else if (strcmp(argv[0], "cell_voltages") == 0) {
-        Config *config = config_get_configuration();
-        float *cells = ltc6803_get_cell_voltages();
-        for (uint8_t i = 0; i < config->numCells; i++)
+        CellStats cells;
+        cell_stats_get(&cells);
+        for (uint8_t i = 0; i < cells.numCells; i++)
         {
-            console_printf("Cell %d: %.4fV\n", i + 1, cells[i]);
+            console_printf("Cell %d: %.3fV\n", i + 1, cells.cellMv[i] / 1000.0);
         }
+        console_printf("Min: %.3fV (cell %d), max: %.3fV (cell %d)\n", cells.minMv / 1000.0, cells.minCell + 1, cells.maxMv / 1000.0, cells.maxCell + 1);
+        console_printf("Mean: %.3fV, spread: %dmV, scan %d\n", cells.meanMv / 1000.0, cells.spreadMv, cells.seq);
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "cell_ir") == 0) {
+        float resistances[LTC6803_MAX_CELLS];
+        uint8_t n = cell_ir_get_resistances(resistances);
+        for (uint8_t i = 0; i < n; i++)
+        {
+            console_printf("Cell %d: %.1fmOhm\n", i + 1, resistances[i] * 1000.0);
+        }
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "cell_rate") == 0) {
+        console_printf("Cell measurements: %.1f/s, timeouts: %d\n", ltc6803_get_measurement_rate(),
+                ltc6803_get_conversion_timeouts());
         console_printf("\r\n");
     }
     else if (strcmp(argv[0], "current") == 0) {
         console_printf("Battery current: %.2fA\n", current_monitor_get_current());
+        console_printf("Current samples: %d, late: %d, failed: %d\n", current_monitor_get_sample_index(),
+                current_monitor_get_late_samples(), current_monitor_get_failed_samples());
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "overcurrent") == 0) {
+        I2tState i2t;
+        current_monitor_get_i2t(&i2t);
+        console_printf("Headroom: %.1f%%, thermal current: %.1fA\n", current_monitor_get_headroom() * 100.0, sqrtf(i2t.heat));
+        console_printf("Excursions: %d\n", i2t.numEvents);
+        if (i2t.numEvents > 0)
+            console_printf("%s: %.0fA2s, peak %.1fA for %.3fs\n", i2t.inEvent ? "Current" : "Last",
+                    i2t.event.energy, i2t.event.peakCurrent, i2t.event.duration);
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "balance") == 0) {
+        BalancePlan plan;
+        charger_get_balance_plan(&plan);
+        BalanceMode mode = charger_get_balance_mode();
+        console_printf("Balancing: %s, %.0fs left, %.2fW\n", mode == BALANCE_MODE_TOP ? "top" : mode == BALANCE_MODE_BOTTOM ? "bottom" :
+                       mode == BALANCE_MODE_DISCHARGE ? "discharge" : mode == BALANCE_MODE_DRAIN ? "drain" : "no", plan.completionTime, plan.power);
+        for (uint8_t i = 0; i < plan.numCells; i++)
+            console_printf("Cell %d: %.0f%%\n", i + 1, plan.duty[i] * 100.0);
+        for (uint8_t d = 0; d < ltc6803_get_num_devices(); d++)
+            console_printf("LTC6803 %d: %.1fC, %.0f%% of the duty\n", d + 1,
+                    ltc6803_get_temp()[d * LTC6803_TEMPS_PER_DEVICE + 2], plan.thermalScale[d] * 100.0);
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "precharge") == 0) {
+        static const char *states[] = {"idle", "running", "done", "short", "overload"};
+        PrechargeFit fit;
+        precharge_get_fit(&fit);
+        console_printf("Precharge: %s after %.1fms, %d samples\n", states[fit.state], fit.elapsed * 1000.0, fit.samples);
+        console_printf("Tau: %.1fms, final voltage: %.2fV, predicted: %.1fms\n", fit.tau * 1000.0, fit.finalVoltage, fit.predictedTime * 1000.0);
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "fast_trip") == 0) {
+        uint32_t count = fast_trip_get_count();
+        console_printf("Fast trips: %d\n", count);
+        for (uint32_t n = count > FAST_TRIP_LOG_SIZE ? count - FAST_TRIP_LOG_SIZE : 0; n < count; n++) {
+            FastTripEvent e;
+            if (fast_trip_get_event(n, &e))
+                console_printf("%d: %s at %.0fms, DSG_SW write took %dns\n", n,
+                        e.source == FAST_TRIP_OUTPUT_SHORT ? "output short" : "current alert",
+                        e.time * (1000.0 / CH_CFG_ST_FREQUENCY), fast_trip_switch_ns(&e));
+        }
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "charge") == 0) {
+        CurrentMonitorCharge charge;
+        current_monitor_get_charge(&charge);
+        console_printf("Charge in: %.3fmAh\n", current_monitor_charge_to_as(charge.chargeIn) / 3.6);
+        console_printf("Charge out: %.3fmAh\n", current_monitor_charge_to_as(charge.chargeOut) / 3.6);
+        console_printf("\r\n");
+    }
+    else if (strcmp(argv[0], "soc") == 0) {
+        console_printf("State of charge: %.1f%% (+/- %.1f%%)\n", soc_get_relative_soc() * 100.0, soc_get_soc_uncertainty() * 100.0);
         console_printf("\r\n");
     }
     else if (strcmp(argv[0], "voltage") == 0) {
@@ -99,19 +214,13 @@ void console_process_command(char *command)
         console_printf("\r\n");
     }
     else if (strcmp(argv[0], "enable_drain") == 0) {
-        Config *config = config_get_configuration();
-        console_printf("Enabling all balance resistors...\n");
-        for (uint8_t i = 0; i < config->numCells; i++)
-        {
-            ltc6803_enable_balance(i + 1);
-        }
-        ltc6803_lock();
+        console_printf("Draining all cells...\n");
+        charger_drain(true);
         console_printf("\r\n");
     }
     else if (strcmp(argv[0], "disable_drain") == 0) {
         console_printf("Disabling all balance resistors...\n");
-        ltc6803_unlock();
-        ltc6803_disable_balance_all();
+        charger_drain(false);
         console_printf("\r\n");
     }
     else if (strcmp(argv[0], "infinity_current") == 0) {
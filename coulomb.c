@@ -0,0 +1,16 @@
+#include "coulomb.h"
+
+// The current is counted as the raw shunt code over the system ticks it
+// lasted, in integers: the totals are exact until they overflow, after
+// close to 900 years at full scale and 10000 ticks per second. Positive
+// current discharges the battery.
+
+void coulomb_add(CoulombCount *count, int16_t current, uint32_t ticks)
+{
+    int64_t q = (int64_t)current * ticks;
+
+    if (q > 0)
+        count->chargeOut += q;
+    else
+        count->chargeIn -= q;
+}
@@ -0,0 +1,16 @@
+#ifndef _COULOMB_H_
+#define _COULOMB_H_
+
+// No ChibiOS dependency, the counter also builds on a host
+#include <stdint.h>
+
+// Charge totals in current LSB x system ticks, exact and without drift
+typedef struct
+{
+    int64_t chargeIn;
+    int64_t chargeOut;
+} CoulombCount;
+
+void coulomb_add(CoulombCount *count, int16_t current, uint32_t ticks);
+
+#endif /* _COULOMB_H_ */
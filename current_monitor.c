@@ -4,9 +4,14 @@
 #include "config.h"
 #include "power.h"
 #include "faults.h"
+#include "seqlock.h"
+#include "fast_trip.h"
+#include "i2t.h"
+#include "i2c_bus.h"
 #include <math.h>
 
 #define I2C_ADDRESS 0x40
+#define MAX_AVERAGING 7 // 128 samples
 
 static void curr_alert(EXTDriver *extp, expchannel_t channel);
 static const EXTConfig extcfg = {
@@ -37,93 +42,347 @@ static const EXTConfig extcfg = {
     }
 };
 
+// The ISL28022 is read at a fixed rate by a dedicated thread. Each sample
+// is timestamped and pushed into a ring buffer, the consumers keep their own
+// read index so that the protections and the charge counting all see every
+// sample. The buffer holds a little more than 250ms at the default rate.
+// The charge is integrated in the sampling thread from the raw shunt codes
+// and the system ticks between the samples, the 64 bits totals stay exact
+// for years.
+// The continuous current is limited by an I2t thermal model fed with every
+// sample, see i2t.c. Its curve goes through maxCurrentCutoff tripping after
+// continuousCurrentCutoffTime seconds from cold. Above peakCurrentCutoff a
+// single sample trips, and so does the ISL28022 alert in hardware: between
+// maxContinuousCurrent and peakCurrentCutoff only the thermal model acts.
+
 static volatile Config *config;
-static volatile systime_t overContCurrentTime;
-static volatile float current;
-static volatile float coulomb_count;
-static volatile float voltage;
-static volatile float power;
+static I2tState i2t;
+static seqlock_t i2tLock;
+static systime_t i2tTime;
+static CurrentMonitorSample sample;
+static seqlock_t sampleLock;
+static CurrentMonitorSample samples[CURRENT_MONITOR_BUFFER_SIZE];
+static volatile uint32_t sampleCount;
+static uint32_t updateIndex;
+static uint32_t lateSamples;
+static uint32_t failedSamples;
+static volatile bool samplingStopped;
+static thread_t *samplingThread;
+static CurrentMonitorCharge charge;
+static seqlock_t chargeLock;
+static systime_t lastSampleTime;
+
+static THD_WORKING_AREA(sampling_thread_wa, 512);
+static THD_FUNCTION(sampling_thread, arg);
+static bool current_monitor_read(CurrentMonitorSample *s, int16_t *shunt);
+static void current_monitor_integrate(int16_t shunt, systime_t time);
 
 void current_monitor_init(void)
 {
     config = config_get_configuration();
+    seqlock_init(&sampleLock);
+    seqlock_init(&chargeLock);
+    seqlock_init(&i2tLock);
+    i2t_init(&i2t);
+    if (!config_read_state(CONFIG_STATE_CHARGE, &charge, sizeof(charge)))
+    {
+        charge.chargeIn = 0;
+        charge.chargeOut = 0;
+    }
+    sampleCount = 0;
+    updateIndex = 0;
+    lateSamples = 0;
+    failedSamples = 0;
     extStart(&EXTD1, &extcfg);
     extChannelEnable(&EXTD1, 12);
+    current_monitor_configure();
+}
+
+// Writes the ISL28022 registers. Run periodically, a brown out of the
+// ISL28022 would otherwise leave it with its reset configuration and no
+// overcurrent threshold. The bus skips the writes made less than a
+// second ago.
+void current_monitor_configure(void)
+{
     uint8_t tx[3];
-    uint8_t rx[2];
     uint16_t current_cal = 4183;
+    current_monitor_set_averaging(config->currentAveraging);
     tx[0] = 0x05; //Calibration Register access
     tx[1] = (uint8_t)(current_cal >> 7);
     tx[2] = (uint8_t)((current_cal & 0xFF) << 1);
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 3, rx, 0, MS2ST(10));
-    current_monitor_set_overcurrent(config->maxCurrentCutoff);
+    i2c_bus_write_register(I2C_BUS_CURRENT_MONITOR, I2C_ADDRESS, tx[0], tx, 3);
+    current_monitor_set_overcurrent(config->peakCurrentCutoff);
     tx[0] = 0x09; //Aux Control Register access
     tx[1] = 0x00;
     tx[2] = 0x80; //Force ISL28022 Interrupt pin to low
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 3, rx, 0, MS2ST(10));
+    i2c_bus_write_register(I2C_BUS_CURRENT_MONITOR, I2C_ADDRESS, tx[0], tx, 3);
+}
+
+void current_monitor_start(void)
+{
+    samplingStopped = false;
+    lastSampleTime = chVTGetSystemTime();
+    i2tTime = lastSampleTime;
+    samplingThread = chThdCreateStatic(sampling_thread_wa, sizeof(sampling_thread_wa),
+            NORMALPRIO + 4, sampling_thread, NULL);
+}
+
+void current_monitor_stop(void)
+{
+    samplingStopped = true;
+    if (samplingThread != NULL)
+    {
+        chThdWait(samplingThread);
+        samplingThread = NULL;
+    }
+    current_monitor_save_charge();
 }
 
+// Protections, run on every sample taken since the last update
 void current_monitor_update(void)
 {
-    i2cAcquireBus(&I2C_DEV);
+    CurrentMonitorSample s;
+    I2tCurve curve;
+    I2tState state = i2t;
+
+    i2t_curve(&curve, config->maxContinuousCurrent, config->maxCurrentCutoff, config->continuousCurrentCutoffTime);
+
+    if (!palReadPad(CURR_ALERT_GPIO, CURR_ALERT_PIN))
+    {
+        power_disable_discharge();
+        faults_set_fault(FAULT_OVERCURRENT);
+    }
+
+    while (current_monitor_read_samples(&updateIndex, &s, 1) > 0)
+    {
+        if (s.current > config->peakCurrentCutoff)
+        {
+            power_disable_discharge();
+            faults_set_fault(FAULT_OVERCURRENT);
+        }
+
+        float dt = (float)(systime_t)(s.time - i2tTime) / CH_CFG_ST_FREQUENCY;
+        i2tTime = s.time;
+        if (i2t_update(&state, &curve, s.current, dt))
+        {
+            power_disable_discharge();
+            faults_set_fault(FAULT_OVERCURRENT);
+        }
+
+        if (s.current > config->continuousCurrentCutoffWarning) {
+            faults_set_warning(WARNING_OVERCURRENT);
+        }
+    }
+    seqlock_publish(&i2tLock, &i2t, &state, sizeof(state));
+	// TODO : clear warning ?
+}
+
+// Copies up to max samples following *index and advances it. A reader that
+// fell more than the buffer size behind restarts from the oldest sample.
+uint8_t current_monitor_read_samples(uint32_t *index, CurrentMonitorSample *out, uint8_t max)
+{
+    uint32_t count = sampleCount;
+    uint8_t n = 0;
+
+    if (count - *index > CURRENT_MONITOR_BUFFER_SIZE)
+        *index = count - CURRENT_MONITOR_BUFFER_SIZE;
+    __sync_synchronize();
+    while (n < max && *index != count)
+    {
+        out[n] = samples[*index % CURRENT_MONITOR_BUFFER_SIZE];
+        __sync_synchronize();
+        // Dropped if the sampling thread has started to overwrite it meanwhile
+        if (sampleCount - *index < CURRENT_MONITOR_BUFFER_SIZE)
+            n++;
+        (*index)++;
+    }
+    return n;
+}
+
+// Average current of the samples taken between start and end, searched
+// from the newest sample backwards. False if there is none in the buffer.
+bool current_monitor_get_average_current(systime_t start, systime_t end, float *current)
+{
+    uint32_t index = sampleCount;
+    float sum = 0.0;
+    uint16_t n = 0;
+
+    for (uint16_t k = 0; k < CURRENT_MONITOR_BUFFER_SIZE && index != 0; k++)
+    {
+        index--;
+        __sync_synchronize();
+        CurrentMonitorSample s = samples[index % CURRENT_MONITOR_BUFFER_SIZE];
+        __sync_synchronize();
+        if (sampleCount - index >= CURRENT_MONITOR_BUFFER_SIZE)
+            break;
+        if ((int32_t)(s.time - start) < 0)
+            break;
+        if ((int32_t)(s.time - end) <= 0)
+        {
+            sum += s.current;
+            n++;
+        }
+    }
+    if (n == 0)
+        return false;
+    *current = sum / n;
+    return true;
+}
+
+// Index of the next sample, a consumer starting with it only reads new samples
+uint32_t current_monitor_get_sample_index(void)
+{
+    return sampleCount;
+}
+
+uint32_t current_monitor_get_late_samples(void)
+{
+    return lateSamples;
+}
+
+// Reads of the ISL28022 that failed, they never reach the buffer
+uint32_t current_monitor_get_failed_samples(void)
+{
+    return failedSamples;
+}
+
+void current_monitor_get_charge(CurrentMonitorCharge *c)
+{
+    seqlock_snapshot(&chargeLock, c, &charge, sizeof(charge));
+}
+
+// State of the overcurrent thermal model and the last excursion above the
+// continuous current
+void current_monitor_get_i2t(I2tState *state)
+{
+    seqlock_snapshot(&i2tLock, state, &i2t, sizeof(i2t));
+}
+
+// Fraction of the thermal budget left before the overcurrent trip
+float current_monitor_get_headroom(void)
+{
+    I2tCurve curve;
+    I2tState state;
+    i2t_curve(&curve, config->maxContinuousCurrent, config->maxCurrentCutoff, config->continuousCurrentCutoffTime);
+    current_monitor_get_i2t(&state);
+    return i2t_headroom(&state, &curve);
+}
+
+float current_monitor_charge_to_as(int64_t c)
+{
+    return (float)c * CURRENT_MONITOR_CURRENT_LSB / CH_CFG_ST_FREQUENCY;
+}
+
+bool current_monitor_save_charge(void)
+{
+    CurrentMonitorCharge c;
+    current_monitor_get_charge(&c);
+    return config_write_state(CONFIG_STATE_CHARGE, &c, sizeof(c));
+}
+
+static THD_FUNCTION(sampling_thread, arg) {
+    (void)arg;
+    chRegSetThreadName("Current sampling");
+
+    systime_t release = chVTGetSystemTime();
+    while (!samplingStopped)
+    {
+        CurrentMonitorSample *s = &samples[sampleCount % CURRENT_MONITOR_BUFFER_SIZE];
+        int16_t shunt;
+        // A failed read is dropped, the next good sample integrates the
+        // charge from the last good one
+        if (current_monitor_read(s, &shunt))
+        {
+            current_monitor_integrate(shunt, s->time);
+            seqlock_publish(&sampleLock, &sample, s, sizeof(sample));
+            __sync_synchronize();
+            sampleCount++;
+        }
+        else
+        {
+            failedSamples++;
+        }
+
+        // A stored period may predate the floor of config_write_field
+        uint16_t periodUs = config->currentSamplePeriod;
+        if (periodUs < CURRENT_MONITOR_MIN_PERIOD)
+            periodUs = CURRENT_MONITOR_MIN_PERIOD;
+        release += US2ST(periodUs);
+        if ((int32_t)(release - chVTGetSystemTime()) <= 0)
+        {
+            // Restart from now rather than sampling in a burst to catch up
+            lateSamples++;
+            release = chVTGetSystemTime();
+        }
+        else
+        {
+            i2c_bus_set_release(I2C_BUS_CURRENT_MONITOR, release);
+            chThdSleepUntil(release);
+        }
+    }
+}
+
+// The current of a sample is counted from the previous sample
+static void current_monitor_integrate(int16_t shunt, systime_t time)
+{
+    systime_t ticks = time - lastSampleTime;
+    lastSampleTime = time;
+
+    seqlock_write_begin(&chargeLock);
+    coulomb_add(&charge, shunt, ticks);
+    seqlock_write_end(&chargeLock);
+}
+
+// Gives the raw shunt voltage code, false if the transfer failed
+static bool current_monitor_read(CurrentMonitorSample *s, int16_t *shunt)
+{
     uint8_t tx[1];
-    uint8_t rx[2];
+    uint8_t rx[4];
+
     /*tx[0] = 0x04;*/
     /*i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 2, MS2ST(10));*/
     /*int16_t current_value = (rx[0] << 8) | rx[1];*/
     /*current = current_value * 0.01958504192;*/
 	
-    tx[0] = 0x01; //Shunt Voltage register access
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 2, MS2ST(10));
+    // The shunt and bus voltage registers are consecutive, the ISL28022
+    // increments its register pointer after each word so both are read in one
+    // transfer
+    tx[0] = 0x01; //Shunt Voltage register access, then Bus Voltage
+    if (i2c_bus_transfer(I2C_BUS_CURRENT_MONITOR, I2C_ADDRESS, tx, 1, rx, 4) != MSG_OK)
+        return false;
+    s->time = chVTGetSystemTime();
+
     int16_t shunt_value = (rx[0] << 8) | rx[1];
     float shunt_voltage = shunt_value * 1.0e-5; //Resolution 10uV
-    current = shunt_voltage / 0.0005;
-	
-    tx[0] = 0x02; //Bus Voltage register access
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 2, MS2ST(10));
-    int16_t voltage_value = (rx[0] << 6) | (rx[1] >> 2);
-    voltage = voltage_value * 0.004; //Resolution 4mV
-	
-    i2cReleaseBus(&I2C_DEV);
-	
-    if (current > config->maxCurrentCutoff || !palReadPad(CURR_ALERT_GPIO, CURR_ALERT_PIN))
-    {
-        power_disable_discharge();
-        faults_set_fault(FAULT_OVERCURRENT);
-    }
-	
-	if (current <= config->maxContinuousCurrent) {
-		overContCurrentTime = chVTGetSystemTime();	
-	}
-	else {
-		if (chVTTimeElapsedSinceX(overContCurrentTime) >= (config->continuousCurrentCutoffTime * 1000)) {
-			power_disable_discharge();
-			faults_set_fault(FAULT_OVERCURRENT);
-		}
-	}
-	
-	if (current > config->continuousCurrentCutoffWarning) {
-		faults_set_warning(WARNING_OVERCURRENT);
-	
-}
-	// TODO : clear warning ?
-	
+    s->current = shunt_voltage / 0.0005;
 	
+    int16_t voltage_value = (rx[2] << 6) | (rx[3] >> 2);
+    s->voltage = voltage_value * 0.004; //Resolution 4mV
+
+    s->power = s->current * s->voltage;
+    *shunt = shunt_value;
+    return true;
 }
 
 float current_monitor_get_current(void)
 {
-    return current;
+    return sample.current;
 }
 
 float current_monitor_get_bus_voltage(void)
 {
-    return voltage;
+    return sample.voltage;
 }
 
 float current_monitor_get_power(void)
 {
-    return power;
+    return sample.power;
+}
+
+// Current, voltage and power of the same measurement
+void current_monitor_get_sample(CurrentMonitorSample *s)
+{
+    seqlock_snapshot(&sampleLock, s, &sample, sizeof(sample));
 }
 
 static void curr_alert(EXTDriver *extp, expchannel_t channel) {
@@ -131,23 +390,34 @@ static void curr_alert(EXTDriver *extp, expchannel_t channel) {
     (void)channel;
 
     chSysLockFromISR();
-
-    power_disable_discharge();
-    faults_set_fault(FAULT_OVERCURRENT);
-
+    fast_trip_trigger_i(FAST_TRIP_CURRENT_ALERT);
     chSysUnlockFromISR();
 }
 
+// Number of conversions averaged by the ISL28022 for each result, 2^averaging.
+// The shunt and bus voltages are converted continuously, one conversion
+// takes 508us so the sample period should not be shorter than the
+// averaging time.
+void current_monitor_set_averaging(uint8_t averaging)
+{
+    if (averaging > MAX_AVERAGING)
+        averaging = MAX_AVERAGING;
+    uint16_t adc = 0x08 | averaging;
+    uint16_t value = 0x7807 | (adc << 7) | (adc << 3); //60V bus range, 320mV shunt range, shunt and bus continuous
+    uint8_t tx[3];
+    tx[0] = 0x00; //Configuration Register access
+    tx[1] = (uint8_t)(value >> 8);
+    tx[2] = (uint8_t)(value & 0xFF);
+    i2c_bus_write_register(I2C_BUS_CURRENT_MONITOR, I2C_ADDRESS, tx[0], tx, 3);
+}
+
 void current_monitor_set_overcurrent(float current_threshold)
 {
-    i2cAcquireBus(&I2C_DEV);
     int8_t value_max = ceil(current_threshold * 0.0005 / 0.00256);
     int8_t value_min = -value_max;
     uint8_t tx[3];
-    uint8_t rx[2];
     tx[0] = 0x06; //Shunt Voltage Threshold
     tx[1] = *(uint8_t*)&value_max;
     tx[2] = *(uint8_t*)&value_min;
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 3, rx, 0, MS2ST(10));
-    i2cReleaseBus(&I2C_DEV);
+    i2c_bus_write_register(I2C_BUS_CURRENT_MONITOR, I2C_ADDRESS, tx[0], tx, 3);
 }
@@ -2,12 +2,47 @@
 #define _CURRENT_MONITOR_H_
 
 #include "ch.h"
+#include "i2t.h"
+#include "i2c_bus.h"
+#include "coulomb.h"
+
+#define CURRENT_MONITOR_BUFFER_SIZE 256
+#define CURRENT_MONITOR_CURRENT_LSB 0.02 // A, 10uV on the 0.5mOhm shunt
+#define CURRENT_MONITOR_MAX_THRESHOLD 650.0 // A, 127 steps of 2.56mV of the overcurrent threshold
+// us, shortest sample period: the register address and 4 bytes read take
+// ~630us on the bus, with a quarter left for the other devices
+#define CURRENT_MONITOR_MIN_PERIOD (I2C_BUS_TRANSFER_US(5) * 5 / 4)
+
+typedef struct
+{
+    float current;
+    float voltage;
+    float power;
+    systime_t time;
+} CurrentMonitorSample;
+
+typedef CoulombCount CurrentMonitorCharge;
 
 void current_monitor_init(void);
+void current_monitor_start(void);
+void current_monitor_stop(void);
 void current_monitor_update(void);
+void current_monitor_configure(void);
 float current_monitor_get_current(void);
 float current_monitor_get_bus_voltage(void);
 float current_monitor_get_power(void);
+void current_monitor_get_sample(CurrentMonitorSample *sample);
+uint8_t current_monitor_read_samples(uint32_t *index, CurrentMonitorSample *samples, uint8_t max);
+bool current_monitor_get_average_current(systime_t start, systime_t end, float *current);
+uint32_t current_monitor_get_sample_index(void);
+uint32_t current_monitor_get_late_samples(void);
+uint32_t current_monitor_get_failed_samples(void);
+void current_monitor_get_charge(CurrentMonitorCharge *charge);
+void current_monitor_get_i2t(I2tState *state);
+float current_monitor_get_headroom(void);
+float current_monitor_charge_to_as(int64_t charge);
+bool current_monitor_save_charge(void);
+void current_monitor_set_averaging(uint8_t averaging);
 void current_monitor_set_overcurrent(float current_threshold);
 
 #endif /* _CURRENT_MONITOR_H_ */
@@ -2,6 +2,7 @@
 #define _DATATYPES_H_
 
 #include "ch.h"
+#include "balance.h"
 
 typedef enum
 {
@@ -15,7 +16,8 @@ typedef enum
     PACKET_CONFIG_SET_FIELD = 0x07,
     PACKET_CONFIG_GET_FIELD = 0x08,
     PACKET_CONFIG_SET_ALL = 0x09,
-    PACKET_CONFIG_GET_ALL = 0x0A
+    PACKET_CONFIG_GET_ALL = 0x0A,
+    PACKET_GET_OVERCURRENT = 0x0B
 } PacketID;
 
 // typedef enum
@@ -108,7 +110,7 @@ typedef struct __attribute__((__packed__))
     volatile float lowVoltageWarning;
     volatile float highVoltageCutoff;
     volatile float highVoltageWarning;
-    volatile float maxCurrentCutoff;
+    volatile float maxCurrentCutoff; // A, trips after continuousCurrentCutoffTime from cold, see i2t.c
     volatile float maxContinuousCurrent;
     volatile uint8_t continuousCurrentCutoffTime;
     volatile uint8_t continuousCurrentCutoffWarning;
@@ -131,6 +133,17 @@ typedef struct __attribute__((__packed__))
 	//volatile float tempLTC6803BalCutoff; //Hardcoded
 	volatile bool isBattTempSensor; //Added
 	volatile bool enBuzzer; //Added
+    volatile uint16_t cellMeasurementPeriod; // ms, 0 to convert as fast as the LTC6803 can
+    volatile uint16_t currentSamplePeriod; // us
+    volatile uint8_t currentAveraging; // ISL28022 averages 2^currentAveraging conversions
+    volatile uint8_t balanceModes; // BalanceMode mask
+    volatile float balanceRestCurrent; // A, the pack is at rest below it
+    volatile float balanceBottomVoltage; // V, bottom balancing below it
+    volatile float balanceBottomDifference; // V
+    volatile float balanceDischargeCurrent; // A, balancing during discharge below it
+    volatile float balanceDischargeDifference; // V
+    volatile float chargeSlewRate; // V/s, 0 for no limit
+    volatile float peakCurrentCutoff; // A, trips on a single sample and in the ISL28022
 } Config;
 
 typedef struct
@@ -0,0 +1,97 @@
+#include "fast_trip.h"
+#include "hal.h"
+#include "hw_conf.h"
+#include "analog.h"
+#include "current_monitor.h"
+#include "power.h"
+#include "faults.h"
+
+// The discharge switch is cut from the interrupt that detects the fault,
+// without waiting for the protection tasks. Two sources trip it: the
+// overcurrent alert of the ISL28022, and the analog watchdog of the ADC
+// converting the discharge output, which is armed while discharging and
+// trips when a short pulls the output below half of the bus voltage. The
+// watchdog sees each conversion of the output, one every ~17us.
+// The realtime counter is read when the trip callback runs and once
+// DSG_SW is cleared, each trip is logged with both. The callback runs after
+// the HAL has dispatched the interrupt and ChibiOS 16 has no hook before
+// that, so on the board the log only covers the write of DSG_SW. The time
+// from the fault to the callback is measured on the simulator, where the
+// short is injected, see sim/tests/fast_trip.sh.
+
+#define FAST_TRIP_SHORT_RATIO 0.5 // Of the bus voltage
+
+#ifdef SIMULATOR
+#define FAST_TRIP_COUNTER_FREQ 1000000 // The simulator counter runs in us
+#else
+#define FAST_TRIP_COUNTER_FREQ STM32_HCLK
+#endif
+
+static FastTripEvent events[FAST_TRIP_LOG_SIZE];
+static volatile uint32_t tripCount;
+static bool armed;
+
+void fast_trip_init(void)
+{
+    tripCount = 0;
+    armed = false;
+}
+
+// Arms the watchdog of the discharge output while discharging, from the
+// bus voltage of the moment
+void fast_trip_update(void)
+{
+    bool discharging = power_get_status() == DISCHARGING;
+
+    if (discharging && !armed)
+    {
+        analog_set_discharge_watchdog(current_monitor_get_bus_voltage() * FAST_TRIP_SHORT_RATIO);
+        armed = true;
+    }
+    else if (!discharging && armed)
+    {
+        analog_set_discharge_watchdog(0.0);
+        armed = false;
+    }
+}
+
+// Called from the interrupt of the source, the switch is cut before
+// anything else
+void fast_trip_trigger_i(FastTripSource source)
+{
+    rtcnt_t callbackTime = chSysGetRealtimeCounterX();
+    palClearPad(DSG_SW_GPIO, DSG_SW_PIN);
+    rtcnt_t offTime = chSysGetRealtimeCounterX();
+
+    power_disable_discharge();
+    faults_set_fault_i(FAULT_OVERCURRENT);
+
+    FastTripEvent *e = &events[tripCount % FAST_TRIP_LOG_SIZE];
+    e->source = source;
+    e->time = chVTGetSystemTimeX();
+    e->callbackTime = callbackTime;
+    e->offTime = offTime;
+    tripCount++;
+}
+
+uint32_t fast_trip_get_count(void)
+{
+    return tripCount;
+}
+
+// Trip n, counted from 0 since startup, if still in the log
+bool fast_trip_get_event(uint32_t n, FastTripEvent *event)
+{
+    chSysLock();
+    bool valid = n < tripCount && tripCount - n <= FAST_TRIP_LOG_SIZE;
+    if (valid)
+        *event = events[n % FAST_TRIP_LOG_SIZE];
+    chSysUnlock();
+    return valid;
+}
+
+// Time the trip callback took to clear DSG_SW
+uint32_t fast_trip_switch_ns(const FastTripEvent *event)
+{
+    return (uint64_t)(rtcnt_t)(event->offTime - event->callbackTime) * 1000000000 / FAST_TRIP_COUNTER_FREQ;
+}
@@ -0,0 +1,29 @@
+#ifndef _FAST_TRIP_H_
+#define _FAST_TRIP_H_
+
+#include "ch.h"
+
+#define FAST_TRIP_LOG_SIZE 8
+
+typedef enum
+{
+    FAST_TRIP_CURRENT_ALERT = 0, // ISL28022 overcurrent alert
+    FAST_TRIP_OUTPUT_SHORT       // Analog watchdog on the discharge output
+} FastTripSource;
+
+typedef struct
+{
+    FastTripSource source;
+    systime_t time;
+    rtcnt_t callbackTime; // Realtime counter when the trip callback ran
+    rtcnt_t offTime;      // Realtime counter once DSG_SW was cleared
+} FastTripEvent;
+
+void fast_trip_init(void);
+void fast_trip_update(void);
+void fast_trip_trigger_i(FastTripSource source);
+uint32_t fast_trip_get_count(void);
+bool fast_trip_get_event(uint32_t n, FastTripEvent *event);
+uint32_t fast_trip_switch_ns(const FastTripEvent *event);
+
+#endif /* _FAST_TRIP_H_ */
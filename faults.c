@@ -1,10 +1,20 @@
 #include "faults.h"
 #include "datatypes.h"
 
-static uint8_t faults = FAULT_NONE;
-static uint16_t warnings = WARNING_NONE;
+// Set from the fast trip interrupts as well, every change is made with the
+// system locked
+static volatile uint8_t faults = FAULT_NONE;
+static volatile uint16_t warnings = WARNING_NONE;
 
 void faults_set_fault(Fault fault)
+{
+    chSysLock();
+    faults_set_fault_i(fault);
+    chSysUnlock();
+}
+
+// With the system locked, from an interrupt
+void faults_set_fault_i(Fault fault)
 {
     faults |= fault;
 }
@@ -16,7 +26,9 @@ uint8_t faults_get_faults(void)
 
 void faults_clear_fault(Fault fault)
 {
+    chSysLock();
     faults &= ~fault;
+    chSysUnlock();
 }
 
 void faults_clear_all_faults(void)
@@ -31,7 +43,9 @@ bool faults_check_fault(Fault fault)
 
 void faults_set_warning(Warning warning)
 {
+    chSysLock();
     warnings |= warning;
+    chSysUnlock();
 }
 
 uint16_t faults_get_warnings(void)
@@ -41,7 +55,9 @@ uint16_t faults_get_warnings(void)
 
 void faults_clear_warning(Warning warning)
 {
+    chSysLock();
     warnings &= ~warning;
+    chSysUnlock();
 }
 
 void faults_clear_all_warnings(void)
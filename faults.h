@@ -7,6 +7,7 @@
 void faults_init(void);
 void faults_update(void);
 void faults_set_fault(Fault fault);
+void faults_set_fault_i(Fault fault);
 void faults_clear_fault(Fault fault);
 void faults_clear_all_faults(void);
 uint8_t faults_get_faults(void);
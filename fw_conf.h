@@ -6,5 +6,9 @@
 // Define firmware version
 #define FW_VERSION_MAJOR 0
 #define FW_VERSION_MINOR 2
+// Keeps the core clocked while the idle thread sleeps, so that the cycle
+// counter times the I2C bus and the fast trip across idle. Costs most of
+// the sleep saving, for profiling builds only.
+//#define FW_PROFILING
 
 #endif /* _FW_CONF_H_ */
@@ -15,6 +15,23 @@
 #define TEMP_SENSE_PIN 14
 #define TEMP_SENSE_CHANNEL ADC_CHANNEL_IN4
 
+// Thermistors, the tables are generated from these by tools/thermistor_table.py
+#define BOARD_NTC_R25 10000.0
+#define BOARD_NTC_B 3434.0
+#define BOARD_NTC_DIVIDER_R 10000.0
+#define BOARD_NTC_LOW_SIDE 0 // NTC from 3.3V, divider resistor to ground
+#define BATT_NTC_R25 10000.0
+#define BATT_NTC_B 3434.0
+#define BATT_NTC_DIVIDER_R 10000.0
+#define BATT_NTC_LOW_SIDE 1 // Divider resistor from VREF, NTC to V-
+#define BATT_NTC_VREF 3.065
+
+// Balancing
+#define BALANCE_RESISTANCE 33.0 // Ohm, bleed resistor of each cell
+#define BALANCE_MAX_POWER 2.0 // W, all the bleed resistors together
+#define BALANCE_MAX_CHANNELS 4 // Cells of an LTC6803 bleeding at once
+#define BALANCE_DIE_TEMP 75.0 // degree C, LTC6803 die temperature held while bleeding
+
 // SPI
 #define LTC6803_CS_GPIO GPIOA
 #define LTC6803_CS_PIN 4
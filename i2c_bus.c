@@ -0,0 +1,271 @@
+#include "i2c_bus.h"
+#include "hw_conf.h"
+#include <string.h>
+
+// Every transfer on I2C_DEV goes through here. A device has a priority the
+// calling thread is raised to while it waits for the bus and holds it, so
+// the ISL28022 samples go first whoever else is queued. Transfers release
+// the bus in between, a long exchange is split rather than holding it.
+// A periodic device announces its next release, and lower priority
+// transfers that would still be on the bus by then wait until it has
+// taken the bus: they fill the gaps between the samples instead of
+// delaying them.
+// Register writes are remembered per device, writing the value a register
+// already holds is skipped without touching the bus. A device that browns
+// out or resets loses its registers behind our back: a failed transfer
+// forgets what was written to that device, and a remembered write is only
+// trusted for I2C_BUS_REFRESH_PERIOD, after which the same write goes to
+// the bus again, as the LTC6803 configuration is refreshed.
+// The bus time of each device is measured with the realtime counter, which
+// stops while the idle thread sleeps unless FW_PROFILING is defined, the
+// times are only exact in those builds.
+
+#define I2C_BUS_TIMEOUT MS2ST(10)
+#define I2C_BUS_REFRESH_PERIOD 1000 // Rewrite a register even if unchanged (ms)
+
+#ifdef SIMULATOR
+#define I2C_BUS_COUNTER_FREQ 1000000 // The simulator counter runs in us
+#else
+#define I2C_BUS_COUNTER_FREQ STM32_HCLK
+#endif
+
+typedef struct
+{
+    const char *name;
+    tprio_t priority;
+} I2cBusDeviceInfo;
+
+typedef struct
+{
+    bool valid;
+    uint8_t reg;
+    uint8_t size;
+    uint8_t data[I2C_BUS_MAX_WRITE_SIZE];
+    systime_t time; // Of the write
+} I2cBusRegister;
+
+static const I2cBusDeviceInfo devices[I2C_BUS_NUM_DEVICES] = {
+    {"ISL28022", NORMALPRIO + 4},
+    {"Charger DAC", NORMALPRIO + 2},
+    {"RTCC", NORMALPRIO}
+};
+
+static I2cBusStats stats[I2C_BUS_NUM_DEVICES];
+static I2cBusRegister cache[I2C_BUS_NUM_DEVICES][I2C_BUS_CACHE_SIZE];
+static volatile systime_t releases[I2C_BUS_NUM_DEVICES];
+static volatile bool periodic[I2C_BUS_NUM_DEVICES];
+
+static void i2c_bus_wait_slot(I2cBusDevice device, size_t bytes);
+static msg_t i2c_bus_run(I2cBusDevice device, i2caddr_t address, const uint8_t *tx, size_t txn,
+        uint8_t *rx, size_t rxn, uint8_t reg, bool cached);
+static I2cBusRegister* i2c_bus_find_register(I2cBusDevice device, uint8_t reg);
+static I2cBusRegister* i2c_bus_new_register(I2cBusDevice device);
+static bool i2c_bus_holds(const I2cBusRegister *r, const uint8_t *tx, size_t txn);
+static void i2c_bus_forget(I2cBusDevice device);
+static uint32_t i2c_bus_counter_us(rtcnt_t ticks);
+
+void i2c_bus_init(void)
+{
+    memset(stats, 0, sizeof(stats));
+    memset(cache, 0, sizeof(cache));
+    for (uint8_t d = 0; d < I2C_BUS_NUM_DEVICES; d++)
+        periodic[d] = false;
+}
+
+msg_t i2c_bus_transfer(I2cBusDevice device, i2caddr_t address, const uint8_t *tx, size_t txn,
+        uint8_t *rx, size_t rxn)
+{
+    return i2c_bus_run(device, address, tx, txn, rx, rxn, 0, false);
+}
+
+// Writes tx, the value of the register reg, unless the register already
+// holds it. reg identifies the register for the cache, it does not have to
+// be the first byte of tx.
+msg_t i2c_bus_write_register(I2cBusDevice device, i2caddr_t address, uint8_t reg, const uint8_t *tx,
+        size_t txn)
+{
+    if (txn > I2C_BUS_MAX_WRITE_SIZE)
+        return i2c_bus_transfer(device, address, tx, txn, NULL, 0);
+
+    // Checked again with the bus held, this only spares the wait
+    bool skip = false;
+    chSysLock();
+    I2cBusRegister *r = i2c_bus_find_register(device, reg);
+    if (i2c_bus_holds(r, tx, txn))
+    {
+        stats[device].skippedWrites++;
+        skip = true;
+    }
+    chSysUnlock();
+    if (skip)
+        return MSG_OK;
+
+    return i2c_bus_run(device, address, tx, txn, NULL, 0, reg, true);
+}
+
+// Forgets the register writes of the device, the next ones go to the bus.
+// For a device known to have been reset or powered down.
+void i2c_bus_invalidate(I2cBusDevice device)
+{
+    i2cAcquireBus(&I2C_DEV);
+    chSysLock();
+    i2c_bus_forget(device);
+    chSysUnlock();
+    i2cReleaseBus(&I2C_DEV);
+}
+
+// The next time a periodic device will use the bus
+void i2c_bus_set_release(I2cBusDevice device, systime_t release)
+{
+    releases[device] = release;
+    periodic[device] = true;
+}
+
+const char* i2c_bus_get_name(I2cBusDevice device)
+{
+    return devices[device].name;
+}
+
+void i2c_bus_get_stats(I2cBusDevice device, I2cBusStats *s)
+{
+    chSysLock();
+    *s = stats[device];
+    chSysUnlock();
+}
+
+// Waits for the release of any periodic device of higher priority that the
+// transfer would delay
+static void i2c_bus_wait_slot(I2cBusDevice device, size_t bytes)
+{
+    systime_t duration = US2ST(I2C_BUS_TRANSFER_US(bytes));
+
+    for (uint8_t d = 0; d < device; d++)
+    {
+        if (!periodic[d])
+            continue;
+        systime_t release = releases[d];
+        int32_t left = (int32_t)(release - chVTGetSystemTime());
+        if (left > 0 && (systime_t)left <= duration)
+            chThdSleepUntil(release);
+    }
+}
+
+static msg_t i2c_bus_run(I2cBusDevice device, i2caddr_t address, const uint8_t *tx, size_t txn,
+        uint8_t *rx, size_t rxn, uint8_t reg, bool cached)
+{
+    rtcnt_t request = chSysGetRealtimeCounterX();
+    tprio_t priority = chThdGetPriorityX();
+    msg_t result = MSG_OK;
+    bool skipped = false;
+
+    i2c_bus_wait_slot(device, txn + rxn);
+    if (devices[device].priority > priority)
+        chThdSetPriority(devices[device].priority);
+    i2cAcquireBus(&I2C_DEV);
+    rtcnt_t start = chSysGetRealtimeCounterX();
+
+    I2cBusRegister *r = NULL;
+    if (cached)
+    {
+        r = i2c_bus_find_register(device, reg);
+        skipped = i2c_bus_holds(r, tx, txn);
+    }
+    if (!skipped)
+    {
+        result = i2cMasterTransmitTimeout(&I2C_DEV, address, tx, txn, rx, rxn, I2C_BUS_TIMEOUT);
+        // A timeout leaves the driver locked until it is restarted
+        if (result == MSG_TIMEOUT)
+        {
+            const I2CConfig *config = I2C_DEV.config;
+            i2cStop(&I2C_DEV);
+            i2cStart(&I2C_DEV, config);
+        }
+    }
+    rtcnt_t end = chSysGetRealtimeCounterX();
+
+    chSysLock();
+    // Whatever failed, the registers of the device can't be trusted anymore
+    if (result != MSG_OK)
+    {
+        i2c_bus_forget(device);
+    }
+    else if (cached && !skipped)
+    {
+        if (r == NULL)
+            r = i2c_bus_new_register(device);
+        r->valid = true;
+        r->reg = reg;
+        r->size = txn;
+        memcpy(r->data, tx, txn);
+        r->time = chVTGetSystemTimeX();
+    }
+    I2cBusStats *s = &stats[device];
+    if (skipped)
+    {
+        s->skippedWrites++;
+    }
+    else
+    {
+        uint32_t busTime = i2c_bus_counter_us(end - start);
+        uint32_t waitTime = i2c_bus_counter_us(start - request);
+        s->transfers++;
+        if (result != MSG_OK)
+            s->errors++;
+        s->busTime += busTime;
+        if (busTime > s->worstBusTime)
+            s->worstBusTime = busTime;
+        if (waitTime > s->worstWaitTime)
+            s->worstWaitTime = waitTime;
+    }
+    chSysUnlock();
+
+    i2cReleaseBus(&I2C_DEV);
+    if (devices[device].priority > priority)
+        chThdSetPriority(priority);
+    return result;
+}
+
+// The cache only changes with both the bus and the system locked, either
+// is enough to look it up
+static I2cBusRegister* i2c_bus_find_register(I2cBusDevice device, uint8_t reg)
+{
+    for (uint8_t i = 0; i < I2C_BUS_CACHE_SIZE; i++)
+    {
+        I2cBusRegister *r = &cache[device][i];
+        if (r->valid && r->reg == reg)
+            return r;
+    }
+    return NULL;
+}
+
+// A free entry, or the first one remembered which the others move over
+static I2cBusRegister* i2c_bus_new_register(I2cBusDevice device)
+{
+    for (uint8_t i = 0; i < I2C_BUS_CACHE_SIZE; i++)
+    {
+        if (!cache[device][i].valid)
+            return &cache[device][i];
+    }
+    memmove(&cache[device][0], &cache[device][1], sizeof(I2cBusRegister) * (I2C_BUS_CACHE_SIZE - 1));
+    return &cache[device][I2C_BUS_CACHE_SIZE - 1];
+}
+
+// Whether the last write to the register was tx, recently enough to still
+// believe it
+static bool i2c_bus_holds(const I2cBusRegister *r, const uint8_t *tx, size_t txn)
+{
+    return r != NULL && r->valid && r->size == txn && memcmp(r->data, tx, txn) == 0 &&
+            chVTTimeElapsedSinceX(r->time) < MS2ST(I2C_BUS_REFRESH_PERIOD);
+}
+
+// Called with the bus and the system locked
+static void i2c_bus_forget(I2cBusDevice device)
+{
+    for (uint8_t i = 0; i < I2C_BUS_CACHE_SIZE; i++)
+        cache[device][i].valid = false;
+}
+
+static uint32_t i2c_bus_counter_us(rtcnt_t ticks)
+{
+    return (uint64_t)ticks * 1000000 / I2C_BUS_COUNTER_FREQ;
+}
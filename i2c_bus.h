@@ -0,0 +1,43 @@
+#ifndef _I2C_BUS_H_
+#define _I2C_BUS_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#define I2C_BUS_CACHE_SIZE 4 // Registers remembered per device
+#define I2C_BUS_MAX_WRITE_SIZE 3 // Bytes of a remembered write, register address included
+#define I2C_BUS_BITRATE 100000 // Hz, from the timing of i2cconfig in main.c
+#define I2C_BUS_OVERHEAD_BYTES 2 // Addresses, start, restart and stop
+// us on the bus for a transfer of bytes, 9 bits each
+#define I2C_BUS_TRANSFER_US(bytes) (((bytes) + I2C_BUS_OVERHEAD_BYTES) * 9 * 1000000 / I2C_BUS_BITRATE)
+
+// Ordered by priority, the first one has the bus first
+typedef enum
+{
+    I2C_BUS_CURRENT_MONITOR = 0, // ISL28022, sampled periodically
+    I2C_BUS_CHARGER,             // Charger output DAC
+    I2C_BUS_RTCC,
+    I2C_BUS_NUM_DEVICES
+} I2cBusDevice;
+
+typedef struct
+{
+    uint32_t transfers;
+    uint32_t skippedWrites; // Same value as the last write to the register
+    uint32_t errors;
+    uint64_t busTime;       // us holding the bus
+    uint32_t worstBusTime;  // us
+    uint32_t worstWaitTime; // us from the request to holding the bus
+} I2cBusStats;
+
+void i2c_bus_init(void);
+msg_t i2c_bus_transfer(I2cBusDevice device, i2caddr_t address, const uint8_t *tx, size_t txn,
+        uint8_t *rx, size_t rxn);
+msg_t i2c_bus_write_register(I2cBusDevice device, i2caddr_t address, uint8_t reg, const uint8_t *tx,
+        size_t txn);
+void i2c_bus_invalidate(I2cBusDevice device);
+void i2c_bus_set_release(I2cBusDevice device, systime_t release);
+const char* i2c_bus_get_name(I2cBusDevice device);
+void i2c_bus_get_stats(I2cBusDevice device, I2cBusStats *stats);
+
+#endif /* _I2C_BUS_H_ */
@@ -0,0 +1,79 @@
+#include "i2t.h"
+#include <math.h>
+
+// First order thermal model of the conductors and of the switches: the
+// heat follows I^2 with the thermal time constant and trips when it
+// reaches the square of the continuous current. From cold, a current I
+// trips after tau * ln(I^2 / (I^2 - Ic^2)), short peaks well above the
+// continuous current pass as long as the average heat stays below.
+// The curve is placed by the continuous current and one point of the trip
+// curve, a current and its trip time from cold. A continuous current of 0
+// disables the trip.
+
+void i2t_init(I2tState *state)
+{
+    state->heat = 0.0;
+    state->inEvent = false;
+    state->event.energy = 0.0;
+    state->event.peakCurrent = 0.0;
+    state->event.duration = 0.0;
+    state->numEvents = 0;
+}
+
+// False if the point is not above the continuous current, the time
+// constant is then the trip time
+bool i2t_curve(I2tCurve *curve, float continuousCurrent, float current, float tripTime)
+{
+    float ic2 = continuousCurrent * continuousCurrent;
+    float i2 = current * current;
+
+    curve->continuousCurrent = continuousCurrent;
+    if (current <= continuousCurrent || continuousCurrent <= 0.0)
+    {
+        curve->timeConstant = tripTime;
+        return false;
+    }
+    curve->timeConstant = tripTime / logf(i2 / (i2 - ic2));
+    return true;
+}
+
+// Integrates a sample held for dt seconds, true when the model trips
+bool i2t_update(I2tState *state, const I2tCurve *curve, float current, float dt)
+{
+    float i2 = current * current;
+    float ic2 = curve->continuousCurrent * curve->continuousCurrent;
+    float alpha = curve->timeConstant > dt ? dt / curve->timeConstant : 1.0;
+
+    state->heat += (i2 - state->heat) * alpha;
+
+    if (fabsf(current) > curve->continuousCurrent)
+    {
+        if (!state->inEvent)
+        {
+            state->inEvent = true;
+            state->event.energy = 0.0;
+            state->event.peakCurrent = 0.0;
+            state->event.duration = 0.0;
+            state->numEvents++;
+        }
+        state->event.energy += (i2 - ic2) * dt;
+        state->event.duration += dt;
+        if (fabsf(current) > state->event.peakCurrent)
+            state->event.peakCurrent = fabsf(current);
+    }
+    else
+    {
+        state->inEvent = false;
+    }
+
+    return ic2 > 0.0 && state->heat >= ic2;
+}
+
+// Fraction of the heat budget left, 0 when tripped
+float i2t_headroom(const I2tState *state, const I2tCurve *curve)
+{
+    float ic2 = curve->continuousCurrent * curve->continuousCurrent;
+    if (ic2 <= 0.0 || state->heat >= ic2)
+        return 0.0;
+    return 1.0 - state->heat / ic2;
+}
@@ -0,0 +1,35 @@
+#ifndef _I2T_H_
+#define _I2T_H_
+
+// No ChibiOS dependency, the model also builds on a host
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    float continuousCurrent; // A, never trips
+    float timeConstant;      // s
+} I2tCurve;
+
+// Excursion above the continuous current
+typedef struct
+{
+    float energy;      // A^2.s above the continuous current
+    float peakCurrent; // A
+    float duration;    // s
+} I2tEvent;
+
+typedef struct
+{
+    float heat; // A^2, I^2 filtered by the thermal time constant
+    bool inEvent;
+    I2tEvent event;     // Current excursion, or the last one
+    uint32_t numEvents;
+} I2tState;
+
+void i2t_init(I2tState *state);
+bool i2t_curve(I2tCurve *curve, float continuousCurrent, float current, float tripTime);
+bool i2t_update(I2tState *state, const I2tCurve *curve, float current, float dt);
+float i2t_headroom(const I2tState *state, const I2tCurve *curve);
+
+#endif /* _I2T_H_ */
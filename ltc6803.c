@@ -4,14 +4,60 @@
 #include <string.h>
 #include "config.h"
 #include "faults.h"
+#include "cell_kernels.h"
+#include "cell_stats.h"
+#include "thermistor.h"
+#include "spi_sw.h"
+#include "pec8.h"
+
+#define CFG_REG_LEN 6
+#define CV_REG_LEN 18
+#define TMP_REG_LEN 5
+#define DGN_REG_LEN 2
+#define FRAME_MAX_LEN (2 + LTC6803_MAX_DEVICES * (CV_REG_LEN + 1))
+#define MAX_FRAMES 6
+
+#define CFG_REFRESH_PERIOD 1000 // Rewrite the configuration even if unchanged (ms)
+#define CONVERSION_TIMEOUT 20 // Longest cell conversion, 13ms nominal (ms)
+#define TEMP_MEASUREMENT_PERIOD 1000 // Period of the temperature conversions (ms)
+#define RATE_WINDOW 1000 // Window of the measurement rate (ms)
+
+typedef enum
+{
+    CONVERSION_NONE,
+    CONVERSION_CELLS,
+    CONVERSION_TEMPS
+} Conversion;
+
+// One chip select cycle: command, command PEC and the register bytes of
+// every device of the daisy chain, each followed by its PEC
+typedef struct
+{
+    uint8_t len;
+    uint8_t tx[FRAME_MAX_LEN];
+    uint8_t rx[FRAME_MAX_LEN];
+} Frame;
+
+#ifndef BATTMAN_4_0
+static void ltc6803_spi_end_cb(SPIDriver *spip);
 
-#define PEC_POLY 7
+// Minimum chip select high time between two chained frames
+#if defined(SIMULATOR)
+#define CS_HIGH_DELAY()
+#else
+#define CS_HIGH_DELAY() chSysPolledDelayX(US2RTC(STM32_HCLK, 1))
+#endif
+#endif
 
 /*
  *  * SPI configuration (562kHz, CPHA=1, CPOL=1, MSb first).
  *   */
 static const SPIConfig ls_spicfg = {
+#ifdef BATTMAN_4_0
     NULL,
+#else
+    ltc6803_spi_end_cb,
+#endif
     GPIOA,
     4,
     SPI_CR1_BR_2 | SPI_CR1_BR_1 | SPI_CR1_BR_0 | SPI_CR1_CPOL | SPI_CR1_CPHA,
@@ -19,87 +65,252 @@ static const SPIConfig ls_spicfg = {
 };
 
 static volatile Config *config;
-static float cells[12];
-static float ltc6803Temp[3];
-static uint8_t configReg[6];
+static uint8_t numDevices = 1;
+static uint16_t cellMv[LTC6803_MAX_CELLS] CELL_KERNELS_ALIGNED;
+static float ltc6803Temp[LTC6803_MAX_DEVICES * LTC6803_TEMPS_PER_DEVICE];
+static float tempVoltage[LTC6803_MAX_DEVICES * LTC6803_TEMPS_PER_DEVICE];
+static uint8_t configReg[LTC6803_MAX_DEVICES][CFG_REG_LEN];
 static bool lock = false;
 static bool ltc6803THSD = false;
 static bool muxFail = false;
-static float refVoltage;
-
-static volatile systime_t conversionStart;
-static void ltc6803_wrcfg(uint8_t config[6]);
+static float refVoltage[LTC6803_MAX_DEVICES];
+static Frame frames[MAX_FRAMES];
+static uint8_t numFrames = 0;
+static volatile uint8_t currentFrame;
+static binary_semaphore_t transferDone;
+
+static uint8_t writtenConfigReg[LTC6803_MAX_DEVICES][CFG_REG_LEN];
+static systime_t configWriteTime;
+static Conversion conversion = CONVERSION_NONE;
+static systime_t conversionStart;
+static systime_t cellConversionStart;
+static systime_t tempConversionStart;
+static uint32_t measurementCount = 0;
+static float measurementRate = 0.0;
+static uint32_t conversionTimeouts = 0;
+static systime_t rateWindowStart;
+static void ltc6803_wrcfg(uint8_t config[][CFG_REG_LEN]);
 static void ltc6803_stcvad(void);
-static void ltc6803_rdcv(float cells[12]);
-static void ltc6803_rdtmp(float ltc6803Temp[3]); //bool ltc6803THSD
+static Frame* ltc6803_rdcv(void);
+static Frame* ltc6803_rdtmp(void);
 static void ltc6803_sttmpad(void);
 static void ltc6803_dagn(void);
-static void ltc6803_rddgnr(void);
+static Frame* ltc6803_pladc(void);
+static Frame* ltc6803_rddgnr(void);
+static void ltc6803_parse_cv(Frame *frame, uint16_t cellMv[LTC6803_MAX_CELLS]);
+static void ltc6803_parse_tmp(Frame *frame, float ltc6803Temp[]); //bool ltc6803THSD
+static void ltc6803_parse_dgnr(Frame *frame);
+static bool ltc6803_conversion_done(Frame *frame);
+static Frame* ltc6803_queue(uint8_t command, uint8_t commandPec, uint8_t len);
+static uint8_t* ltc6803_device_reg(uint8_t cell);
+static void ltc6803_transfer(void);
 static bool ltc6803_checkVoltage(float diagVoltage);
-static uint8_t pec8_calc(uint8_t len, uint8_t *data);
-static void spi_sw_transfer(char *in_buf, const char *out_buf, int length);
+
+#ifdef BATTMAN_4_0
+/*
+ * Software SPI clocked from TIM6 (SCK at 250kHz, CPHA=1, CPOL=1, MSb first).
+ * The timer interrupt runs every half SCK period, 500kHz while a transfer
+ * is running: it toggles SCK and shifts the data through spi_sw.c, the
+ * calling thread sleeps until the whole transfer is done. sim/tests runs
+ * the same bit engine against a model of the LTC6803 pins.
+ */
+#define SPI_SW_TIMER_FREQUENCY  1000000
+#define SPI_SW_HALF_PERIOD      2 // Timer ticks, 2us
+
+static void spi_sw_transfer(uint8_t *in_buf, const uint8_t *out_buf, int length);
+static void spi_sw_tick(GPTDriver *gptp);
+
+static const GPTConfig spi_sw_gptcfg = {
+    SPI_SW_TIMER_FREQUENCY,
+    spi_sw_tick,
+    0,
+    0
+};
+
+static SpiSw spi_sw;
+static thread_reference_t spi_sw_thread = NULL;
+#endif
 
 void ltc6803_init(void)
 {
     config = config_get_configuration();
+    chBSemObjectInit(&transferDone, true);
 #ifdef BATTMAN_4_0
     palSetPadMode(SCK_GPIO, SCK_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
     palSetPadMode(MISO_GPIO, MISO_PIN, PAL_MODE_INPUT_PULLUP | PAL_STM32_OSPEED_HIGHEST);
     palSetPadMode(MOSI_GPIO, MOSI_PIN, PAL_MODE_OUTPUT_PUSHPULL | PAL_STM32_OSPEED_HIGHEST);
+    gptStart(&GPTD6, &spi_sw_gptcfg);
 #endif
-    configReg[0] = 0b01100001;
-    configReg[1] = 0b00000000;
-    configReg[2] = 0b00000000;
-	if (config->numCells > 4) {
-		configReg[3] = 0b11111111 << (config->numCells-4); //Masks cells according to the battery config
-	}
-	else {
-		configReg[3] = 0b11111111;	
-	}
-    configReg[4] = 0b00000000;
-    configReg[5] = 0b00000000;
-    conversionStart = chVTGetSystemTime();
+    numDevices = (config->numCells + LTC6803_CELLS_PER_DEVICE - 1) / LTC6803_CELLS_PER_DEVICE;
+    if (numDevices < 1)
+        numDevices = 1;
+    else if (numDevices > LTC6803_MAX_DEVICES)
+        numDevices = LTC6803_MAX_DEVICES;
+
+    // The cells fill the devices from the bottom of the stack
+    for (uint8_t d = 0; d < numDevices; d++)
+    {
+        uint8_t deviceCells = ltc6803_get_num_cells() - d * LTC6803_CELLS_PER_DEVICE;
+        if (deviceCells > LTC6803_CELLS_PER_DEVICE)
+            deviceCells = LTC6803_CELLS_PER_DEVICE;
+        configReg[d][0] = 0b01110001; // Level polling, SDO stays low until the conversion is done
+        configReg[d][1] = 0b00000000;
+        configReg[d][2] = 0b00000000;
+        if (deviceCells > 4) {
+            configReg[d][3] = 0b11111111 << (deviceCells-4); //Masks cells according to the battery config
+        }
+        else {
+            configReg[d][3] = 0b11111111;
+        }
+        configReg[d][4] = 0b00000000;
+        configReg[d][5] = 0b00000000;
+    }
+    configWriteTime = chVTGetSystemTime();
+    cellConversionStart = chVTGetSystemTime();
+    tempConversionStart = chVTGetSystemTime() - MS2ST(TEMP_MEASUREMENT_PERIOD);
+    rateWindowStart = chVTGetSystemTime();
 	
 	ltc6803_diagnostic();
 }
 
 void ltc6803_update(void)
 {
-    ltc6803_wrcfg(configReg);
-    if (ST2MS(chVTTimeElapsedSinceX(conversionStart)) > 13)
+    Frame *cvFrame = NULL;
+    Frame *tmpFrame = NULL;
+    systime_t scanStart = 0;
+    systime_t scanEnd = 0;
+
+    if (memcmp(configReg, writtenConfigReg, sizeof(configReg)) != 0 ||
+            ST2MS(chVTTimeElapsedSinceX(configWriteTime)) > CFG_REFRESH_PERIOD)
+    {
+        ltc6803_wrcfg(configReg);
+        memcpy(writtenConfigReg, configReg, sizeof(configReg));
+        configWriteTime = chVTGetSystemTime();
+    }
+
+    if (conversion != CONVERSION_NONE)
+    {
+        Frame *pollFrame = ltc6803_pladc();
+        ltc6803_transfer();
+        if (!ltc6803_conversion_done(pollFrame))
+        {
+            if (ST2MS(chVTTimeElapsedSinceX(conversionStart)) < CONVERSION_TIMEOUT)
+                return;
+            // The registers hold a partial or an older conversion, it is
+            // dropped and the next one started
+            conversionTimeouts++;
+            faults_set_warning(WARNING_LTC6803_ERROR);
+        }
+        else if (conversion == CONVERSION_CELLS)
+        {
+            cvFrame = ltc6803_rdcv();
+            scanStart = conversionStart;
+            scanEnd = chVTGetSystemTime();
+        }
+        else
+            tmpFrame = ltc6803_rdtmp();
+        conversion = CONVERSION_NONE;
+    }
+
+    // The temperatures are converted between two cell conversions, a new
+    // conversion command would abort the one running
+    if (ST2MS(chVTTimeElapsedSinceX(tempConversionStart)) >= TEMP_MEASUREMENT_PERIOD)
+    {
+        ltc6803_sttmpad();
+        conversion = CONVERSION_TEMPS;
+        tempConversionStart = chVTGetSystemTime();
+        conversionStart = tempConversionStart;
+    }
+    else if (ST2MS(chVTTimeElapsedSinceX(cellConversionStart)) >= config->cellMeasurementPeriod)
     {
-        ltc6803_rdcv(cells);
         ltc6803_stcvad();
-        chThdSleepMicroseconds(13);//Time needed by the LTC6803 to execute measurements
-		ltc6803_rdtmp(ltc6803Temp);
-		ltc6803_sttmpad();
-        conversionStart = chVTGetSystemTime();
+        conversion = CONVERSION_CELLS;
+        cellConversionStart = chVTGetSystemTime();
+        conversionStart = cellConversionStart;
+    }
+    ltc6803_transfer();
+
+    if (cvFrame != NULL)
+    {
+        ltc6803_parse_cv(cvFrame, cellMv);
+        cell_stats_update(cellMv, ltc6803_get_num_cells(), scanStart, scanEnd);
+        measurementCount++;
     }
+    if (tmpFrame != NULL)
+        ltc6803_parse_tmp(tmpFrame, ltc6803Temp);
+
+    if (ST2MS(chVTTimeElapsedSinceX(rateWindowStart)) >= RATE_WINDOW)
+    {
+        measurementRate = measurementCount * 1000.0 / ST2MS(chVTTimeElapsedSinceX(rateWindowStart));
+        measurementCount = 0;
+        rateWindowStart = chVTGetSystemTime();
+    }
+}
+
+// Cell voltage measurements per second
+float ltc6803_get_measurement_rate(void)
+{
+    return measurementRate;
+}
+
+// Conversions that did not complete in time, dropped
+uint32_t ltc6803_get_conversion_timeouts(void)
+{
+    return conversionTimeouts;
 }
 
-float* ltc6803_get_cell_voltages(void)
+// Cell voltages in mV
+uint16_t* ltc6803_get_cell_mv(void)
 {
-    return cells;
+    return cellMv;
 }
 
+// Temperatures of each device in degrees C: external 1, external 2 and
+// internal
 float* ltc6803_get_temp(void) {
 	
     return ltc6803Temp;
 }
 
+// Number of cells measured, from the configuration but limited to the
+// devices of the stack
+uint8_t ltc6803_get_num_cells(void)
+{
+    uint8_t numCells = config->numCells;
+    if (numCells > numDevices * LTC6803_CELLS_PER_DEVICE)
+        numCells = numDevices * LTC6803_CELLS_PER_DEVICE;
+    return numCells;
+}
+
+uint8_t ltc6803_get_num_devices(void)
+{
+    return numDevices;
+}
+
+// Configuration register of the device measuring a cell, NULL if the cell
+// is out of the stack
+static uint8_t* ltc6803_device_reg(uint8_t cell)
+{
+    if (cell < 1 || cell > ltc6803_get_num_cells())
+        return NULL;
+    return configReg[(cell - 1) / LTC6803_CELLS_PER_DEVICE];
+}
+
 void ltc6803_enable_balance(uint8_t cell)
 {
     if (lock)
         return;
-    if (cell > config->numCells)
+    uint8_t *reg = ltc6803_device_reg(cell);
+    if (reg == NULL)
         return;
-    if (cell <= 8)
+    uint8_t deviceCell = (cell - 1) % LTC6803_CELLS_PER_DEVICE + 1;
+    if (deviceCell <= 8)
     {
-        configReg[1] |= 1 << (cell - 1);
+        reg[1] |= 1 << (deviceCell - 1);
     }
     else
     {
-        configReg[2] |= 1 << (cell - 9);
+        reg[2] |= 1 << (deviceCell - 9);
     }
 }
 
@@ -107,15 +318,17 @@ void ltc6803_disable_balance(uint8_t cell)
 {
     if (lock)
         return;
-    if (cell > config->numCells)
+    uint8_t *reg = ltc6803_device_reg(cell);
+    if (reg == NULL)
         return;
-    if (cell <= 8)
+    uint8_t deviceCell = (cell - 1) % LTC6803_CELLS_PER_DEVICE + 1;
+    if (deviceCell <= 8)
     {
-        configReg[1] &= ~(1 << (cell - 1));
+        reg[1] &= ~(1 << (deviceCell - 1));
     }
     else
     {
-        configReg[2] &= ~(1 << (cell - 9));
+        reg[2] &= ~(1 << (deviceCell - 9));
     }
 }
 
@@ -123,8 +336,11 @@ void ltc6803_disable_balance_all(void)
 {
     if (lock)
         return;
-    configReg[1] = 0;
-    configReg[2] = 0;
+    for (uint8_t d = 0; d < LTC6803_MAX_DEVICES; d++)
+    {
+        configReg[d][1] = 0;
+        configReg[d][2] = 0;
+    }
 }
 
 void ltc6803_diagnostic(void) {
@@ -132,23 +348,30 @@ void ltc6803_diagnostic(void) {
 	uint8_t bitCounter=0;
 	
 	ltc6803_dagn(); //Execute diagnostic command
+	ltc6803_transfer();
 	chThdSleepMicroseconds(20); //Wait for its execution
-	ltc6803_rdcv(cells); //Read cells voltage registers
-	ltc6803_rdtmp(ltc6803Temp); //Read temperature voltage registers
-	ltc6803_rddgnr(); //read Diagnostic registers
+	Frame *cvFrame = ltc6803_rdcv(); //Read cells voltage registers
+	Frame *tmpFrame = ltc6803_rdtmp(); //Read temperature voltage registers
+	Frame *dgnFrame = ltc6803_rddgnr(); //read Diagnostic registers
+	ltc6803_transfer();
+	ltc6803_parse_cv(cvFrame, cellMv);
+	ltc6803_parse_tmp(tmpFrame, ltc6803Temp);
+	ltc6803_parse_dgnr(dgnFrame);
 	
-	for (uint8_t i=0; i < config->numCells; i++) {
-		result = (ltc6803_checkVoltage(cells[i]) << bitCounter);
+	for (uint8_t i=0; i < ltc6803_get_num_cells(); i++) {
+		result = (ltc6803_checkVoltage(cellMv[i] / 1000.0) << bitCounter);
 		bitCounter++;
 	}
-	for (uint8_t i=0; i < 3; i++) {
-		result = (ltc6803_checkVoltage(ltc6803Temp[i]) << bitCounter);
+	for (uint8_t i=0; i < numDevices * LTC6803_TEMPS_PER_DEVICE; i++) {
+		result = (ltc6803_checkVoltage(tempVoltage[i]) << bitCounter);
 		bitCounter++;
 	}
 	result = ltc6803THSD << bitCounter;
 	bitCounter++;
-	result = (ltc6803_checkVoltage(refVoltage) << bitCounter);
-	bitCounter++;
+	for (uint8_t d=0; d < numDevices; d++) {
+		result = (ltc6803_checkVoltage(refVoltage[d]) << bitCounter);
+		bitCounter++;
+	}
 	result = muxFail << bitCounter;
 
 	if (result != 0) {
@@ -157,6 +380,7 @@ void ltc6803_diagnostic(void) {
 	
 	ltc6803_stcvad(); //Refresh registers with operationnal values
 	ltc6803_sttmpad();
+	ltc6803_transfer();
 }
 
 void ltc6803_lock(void)
@@ -169,267 +393,193 @@ void ltc6803_unlock(void)
     lock = false;
 }
 
-static void ltc6803_wrcfg(uint8_t config[6]) //LTC6803 command : Write config
+static void ltc6803_wrcfg(uint8_t config[][CFG_REG_LEN]) //LTC6803 command : Write config
 {
-    const uint8_t BYTES_IN_REG = 6;
-    const uint8_t CMD_LEN = 9;
-    uint8_t cmd[9];
-    uint8_t rxbuf[9];
-    uint16_t cfg_pec;
-    uint8_t cmd_index;
-
-    cmd[0] = 0x01;
-    cmd[1] = 0xC7;
-
-    cmd_index = 2;
-    for (uint8_t current_byte = 0; current_byte < BYTES_IN_REG; current_byte++)
+    Frame *frame = ltc6803_queue(0x01, 0xC7, numDevices * (CFG_REG_LEN + 1));
+    uint8_t *tx_data = &frame->tx[2];
+
+    // Shifted through the chain, the top device comes first
+    for (int d = numDevices - 1; d >= 0; d--)
     {
-        cmd[cmd_index] = config[current_byte];
-        cmd_index++;
+        memcpy(tx_data, config[d], CFG_REG_LEN);
+        tx_data[CFG_REG_LEN] = pec8_calc(CFG_REG_LEN, config[d]);
+        tx_data += CFG_REG_LEN + 1;
     }
+}
 
-    cfg_pec = pec8_calc(BYTES_IN_REG, &config[0]);    // calculating the PEC for each ICs configuration register data
-    cmd[cmd_index] = (uint8_t)cfg_pec;
-    cmd_index++;
+static void ltc6803_stcvad(void) //LTC6803 command: Start Cell Voltage ADC Conversions and Poll Status
+{
+    ltc6803_queue(0x10, 0xB0, 0);
+}
 
-    spiAcquireBus(&SPID1);              /* Acquire ownership of the bus.    */
-    spiStart(&SPID1, &ls_spicfg);       /* Setup transfer parameters.       */
-    spiSelect(&SPID1);                  /* Slave Select assertion.          */
-#ifdef BATTMAN_4_0
-    spi_sw_transfer(rxbuf, cmd, CMD_LEN);
-#else
-    spiExchange(&SPID1, CMD_LEN, cmd, rxbuf);
-#endif
+static Frame* ltc6803_rdcv(void) //LTC6803 command: Read cells voltage from registers
+{
+    return ltc6803_queue(0x04, 0xDC, numDevices * (CV_REG_LEN + 1));
+}
 
-    spiUnselect(&SPID1);                /* Slave Select de-assertion.       */
-    spiReleaseBus(&SPID1);              /* Ownership release.               */
+static void ltc6803_sttmpad(void) { //LTC6803 command: Start temperature ADC Conversions and Poll Status
+    ltc6803_queue(0x30, 0x50, 0);
 }
 
-static void ltc6803_stcvad(void) //LTC6803 command: Start Cell Voltage ADC Conversions and Poll Status
-{
-    uint8_t txbuf[2];
-    uint8_t rxbuf[2];
-    txbuf[0] = 0x10;
-    txbuf[1] = 0xB0;
-    spiAcquireBus(&SPID1);
-    spiStart(&SPID1, &ls_spicfg);
-    spiSelect(&SPID1);
-#ifdef BATTMAN_4_0
-    spi_sw_transfer(rxbuf, txbuf, 2);
-#else
-    spiExchange(&SPID1, 2, txbuf, rxbuf);
-#endif
-    spiUnselect(&SPID1);                /* Slave Select de-assertion.       */
-    spiReleaseBus(&SPID1);              /* Ownership release.               */
+static Frame* ltc6803_rdtmp(void) { //LTC6803 command: Read temperatures from registers
+    return ltc6803_queue(0x0E, 0xEA, numDevices * (TMP_REG_LEN + 1));
+}
+
+static void ltc6803_dagn(void) { //LTC6803 command: Start Diagnose and Poll Status
+    ltc6803_queue(0x52, 0x79, 0);
+}
+
+static Frame* ltc6803_pladc(void) { //LTC6803 command: Poll ADC Converter Status
+    return ltc6803_queue(0x40, 0x07, 1);
 }
 
-static void ltc6803_rdcv(float cells[12]) //LTC6803 command: Read cells voltage from registers
+static Frame* ltc6803_rddgnr(void) { //LTC6803 command: Read diagnostic registers
+    return ltc6803_queue(0x54, 0x6B, numDevices * (DGN_REG_LEN + 1));
+}
+
+// The register reads start with the bottom device of the chain
+static void ltc6803_parse_cv(Frame *frame, uint16_t cellMv[LTC6803_MAX_CELLS])
 {
-    int data_counter = 0;
-    int pec_error = 0;
-    uint8_t data_pec = 0;
-    uint8_t received_pec = 0;
-    uint8_t txbuf[2];
-    uint8_t rxbuf[2];
-    uint8_t rx_data[19];
-    txbuf[0] = 0x04;
-    txbuf[1] = 0xDC;
-
-    spiAcquireBus(&SPID1);
-    spiStart(&SPID1, &ls_spicfg);
-    spiSelect(&SPID1);
-#ifdef BATTMAN_4_0
-    spi_sw_transfer(rxbuf, txbuf, 2);
-#else
-    spiExchange(&SPID1, 2, txbuf, rxbuf);
-#endif
-    txbuf[0] = 0xFF;
-    for (int j = 0; j < 19; j++)
+    for (uint8_t d = 0; d < numDevices; d++)
     {
-#ifdef BATTMAN_4_0
-        spi_sw_transfer(rxbuf, txbuf, 1);
-#else
-        spiExchange(&SPID1, 1, txbuf, rxbuf);
-#endif
-        rx_data[data_counter++] = rxbuf[0];
+        uint8_t *rx_data = &frame->rx[2 + d * (CV_REG_LEN + 1)];
+
+        // The cells are only updated when the PEC matches
+        if (rx_data[CV_REG_LEN] != pec8_calc(CV_REG_LEN, rx_data))
+            continue;
+        cell_kernels_unpack(rx_data, &cellMv[d * LTC6803_CELLS_PER_DEVICE], LTC6803_CELLS_PER_DEVICE);
     }
-    spiUnselect(&SPID1);                /* Slave Select de-assertion.       */
-    spiReleaseBus(&SPID1);              /* Ownership release.               */
+}
 
-    data_counter = 0;
-    uint16_t byteLow, byteHigh;
+// The external thermistors are converted with the table of the battery
+// thermistor, the internal sensor gives 8mV per kelvin. The voltages in mV
+// are kept for the diagnostic.
+static void ltc6803_parse_tmp(Frame *frame, float ltc6803Temp[])
+{
+    bool thsd = false;
 
-    received_pec = rx_data[18];
-    data_pec = pec8_calc(18, &rx_data[0]);
-    if (received_pec != data_pec)
+    for (uint8_t d = 0; d < numDevices; d++)
     {
-        pec_error = -1;
-		return;
-    }
+        uint8_t *rx_data = &frame->rx[2 + d * (TMP_REG_LEN + 1)];
+        float *temp = &ltc6803Temp[d * LTC6803_TEMPS_PER_DEVICE];
+        float *voltage = &tempVoltage[d * LTC6803_TEMPS_PER_DEVICE];
+        uint16_t byteLow, byteHigh;
 
-    for (int k = 0; k < 12; k = k + 2)
-    {
+        if (rx_data[TMP_REG_LEN] != pec8_calc(TMP_REG_LEN, rx_data))
+            continue;
 
-        byteLow = rx_data[data_counter++];
+        byteLow = rx_data[0];
+        byteHigh = (uint16_t)(rx_data[1] & 0x0F) << 8;
+        voltage[0] = (float)(byteLow + byteHigh - 512) * 1.5;
 
-        byteHigh = (uint16_t)(rx_data[data_counter] & 0x0F) << 8;
+        byteHigh = rx_data[1] >> 4;
+        byteLow = rx_data[2] << 4;
+        voltage[1] = (float)(byteLow + byteHigh - 512) * 1.5;
 
-        cells[k] = (float)(byteLow + byteHigh - 512) * 1.5 / 1000.0;
-        byteHigh = (rx_data[data_counter++]) >> 4;
+        byteLow = rx_data[3];
+        byteHigh = (uint16_t)(rx_data[4] & 0x0F) << 8;
+        voltage[2] = (float)(byteLow + byteHigh - 512) * 1.5;
 
-        byteLow =  (rx_data[data_counter++]) << 4;
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            float ratio = voltage[i] * (float)((1 << THERMISTOR_RATIO_BITS) / (BATT_NTC_VREF * 1000.0));
+            temp[i] = thermistor_battery_temperature(ratio > 0.0 ? (uint32_t)ratio : 0);
+        }
+        temp[2] = voltage[2] * 0.125f - 273.15f;
 
-        cells[k + 1] = (float)(byteLow + byteHigh - 512) * 1.5 / 1000.0;
+        //Check the hardware temperature fault of LTC6803 (145 deg)
+        if (rx_data[4] & (1 << 4))
+            thsd = true;
     }
+    ltc6803THSD = thsd;
 }
-static void ltc6803_sttmpad(void) { //LTC6803 command: Start temperature ADC Conversions and Poll Status
-    uint8_t txbuf[2];
-    uint8_t rxbuf[2];
-    txbuf[0] = 0x30;
-    txbuf[1] = 0x50;
-    spiAcquireBus(&SPID1);
-    spiStart(&SPID1, &ls_spicfg);
-    spiSelect(&SPID1);
-#ifdef BATTMAN_4_0
-    spi_sw_transfer(rxbuf, txbuf, 2);
-#else
-    spiExchange(&SPID1, 2, txbuf, rxbuf);
-#endif
-    spiUnselect(&SPID1);                /* Slave Select de-assertion.       */
-    spiReleaseBus(&SPID1);              /* Ownership release.               */	
-}
-
 
-static void ltc6803_rdtmp(float ltc6803Temp[3]) { //LTC6803 command: Read temperatures from registers
-
-int data_counter = 0;
-    int pec_error = 0;
-    uint8_t data_pec = 0;
-    uint8_t received_pec = 0;
-    uint8_t txbuf[2];
-    uint8_t rxbuf[2];
-    uint8_t rx_data[6];
-    txbuf[0] = 0x0E;
-    txbuf[1] = 0xEA;
+static void ltc6803_parse_dgnr(Frame *frame)
+{
+    bool fail = false;
 
-    spiAcquireBus(&SPID1);
-    spiStart(&SPID1, &ls_spicfg);
-    spiSelect(&SPID1);
-#ifdef BATTMAN_4_0
-    spi_sw_transfer(rxbuf, txbuf, 2);
-#else
-    spiExchange(&SPID1, 2, txbuf, rxbuf);
-#endif
-    txbuf[0] = 0xFF;
-    for (int j = 0; j < 6; j++)
+    for (uint8_t d = 0; d < numDevices; d++)
     {
-#ifdef BATTMAN_4_0
-        spi_sw_transfer(rxbuf, txbuf, 1);
-#else
-        spiExchange(&SPID1, 1, txbuf, rxbuf);
-#endif
-        rx_data[data_counter++] = rxbuf[0];
-    }
-    spiUnselect(&SPID1);                /* Slave Select de-assertion.       */
-    spiReleaseBus(&SPID1);              /* Ownership release.               */
+        uint8_t *rx_data = &frame->rx[2 + d * (DGN_REG_LEN + 1)];
+        uint16_t byteLow, byteHigh;
 
-    data_counter = 0;
-    uint16_t byteLow, byteHigh;
+        if (rx_data[DGN_REG_LEN] != pec8_calc(DGN_REG_LEN, rx_data))
+            continue;
 
-    received_pec = rx_data[6];
-    data_pec = pec8_calc(6, &rx_data[0]);
-	
-    if (received_pec != data_pec)
-    {
-        pec_error = -1;
-		return;
-    }
-	
-    for (int k = 0; k < 3; k = k + 2)
-    {
-        byteLow = rx_data[data_counter++];
-        byteHigh = (uint16_t)(rx_data[data_counter] & 0x0F) << 8;
-        ltc6803Temp[k] = (float)(byteLow + byteHigh - 512) * 1.5;
-        
-        byteHigh = (rx_data[data_counter++]) >> 4;
-        if (k==2){
-        	if (rx_data[data_counter] & (1 << 4)) {ltc6803THSD=true;}//Check the hardware temperature fault of LTC6803 (145 deg)
-			else {ltc6803THSD=false;}			
-        }
-        byteLow =  (rx_data[data_counter++]) << 4;
-        ltc6803Temp[k + 1] = (float)(byteLow + byteHigh - 512) * 1.5;
+        byteLow = rx_data[0];
+        byteHigh = (uint16_t)(rx_data[1] & 0x0F) << 8;
+        refVoltage[d] = (float)(byteLow + byteHigh - 512) * 1.5;
+
+        if (rx_data[1] & (1 << 5)) //Check the MUX fail bit
+            fail = true;
     }
- }
+    muxFail = fail;
+}
 
-static void ltc6803_dagn(void) { //LTC6803 command: Start Diagnose and Poll Status
-    uint8_t txbuf[2];
-    uint8_t rxbuf[2];
-    txbuf[0] = 0x52;
-    txbuf[1] = 0x74;
-    spiAcquireBus(&SPID1);
-    spiStart(&SPID1, &ls_spicfg);
-    spiSelect(&SPID1);
-#ifdef BATTMAN_4_0
-    spi_sw_transfer(rxbuf, txbuf, 2);
-#else
-    spiExchange(&SPID1, 2, txbuf, rxbuf);
-#endif
-    spiUnselect(&SPID1);                /* Slave Select de-assertion.       */
-    spiReleaseBus(&SPID1);              /* Ownership release.               */	
+// With level polling SDO is held low while converting, the last bit clocked
+// out tells if the conversion is done
+static bool ltc6803_conversion_done(Frame *frame)
+{
+    return (frame->rx[2] & 0x01) != 0;
 }
 
-static void ltc6803_rddgnr(void) { //LTC6803 command: Read temperatures from registers
+static Frame* ltc6803_queue(uint8_t command, uint8_t commandPec, uint8_t len)
+{
+    Frame *frame = &frames[numFrames++];
+    frame->len = 2 + len;
+    frame->tx[0] = command;
+    frame->tx[1] = commandPec;
+    memset(&frame->tx[2], 0xFF, len);
+    return frame;
+}
 
-int data_counter = 0;
-    int pec_error = 0;
-    uint8_t data_pec = 0;
-    uint8_t received_pec = 0;
-    uint8_t txbuf[2];
-    uint8_t rxbuf[2];
-    uint8_t rx_data[2];
-    txbuf[0] = 0x54;
-    txbuf[1] = 0x6B;
+// Sends the queued frames, each one in its own chip select cycle. The whole
+// queue is chained from the SPI end callback and the calling thread sleeps
+// until the last frame is done.
+static void ltc6803_transfer(void)
+{
+    if (numFrames == 0)
+        return;
 
-    spiAcquireBus(&SPID1);
-    spiStart(&SPID1, &ls_spicfg);
-    spiSelect(&SPID1);
+    spiAcquireBus(&SPID1);              /* Acquire ownership of the bus.    */
+    spiStart(&SPID1, &ls_spicfg);       /* Setup transfer parameters.       */
 #ifdef BATTMAN_4_0
-    spi_sw_transfer(rxbuf, txbuf, 2);
-#else
-    spiExchange(&SPID1, 2, txbuf, rxbuf);
-#endif
-    txbuf[0] = 0xFF;
-    for (int j = 0; j < 2; j++)
+    for (uint8_t i = 0; i < numFrames; i++)
     {
-#ifdef BATTMAN_4_0
-        spi_sw_transfer(rxbuf, txbuf, 1);
+        spiSelect(&SPID1);
+        spi_sw_transfer(frames[i].rx, frames[i].tx, frames[i].len);
+        spiUnselect(&SPID1);
+    }
 #else
-        spiExchange(&SPID1, 1, txbuf, rxbuf);
+    currentFrame = 0;
+    chSysLock();
+    spiSelectI(&SPID1);
+    spiStartExchangeI(&SPID1, frames[0].len, frames[0].tx, frames[0].rx);
+    chSysUnlock();
+    chBSemWait(&transferDone);
 #endif
-        rx_data[data_counter++] = rxbuf[0];
-    }
-    spiUnselect(&SPID1);                /* Slave Select de-assertion.       */
     spiReleaseBus(&SPID1);              /* Ownership release.               */
+    numFrames = 0;
+}
 
-    data_counter = 0;
-    uint16_t byteLow, byteHigh;
-
-    received_pec = rx_data[2];
-    data_pec = pec8_calc(6, &rx_data[0]);
-	
-    if (received_pec != data_pec)
+#ifndef BATTMAN_4_0
+static void ltc6803_spi_end_cb(SPIDriver *spip)
+{
+    chSysLockFromISR();
+    spiUnselectI(spip);
+    if (++currentFrame < numFrames)
     {
-        pec_error = -1;
-		return;
+        CS_HIGH_DELAY();
+        spiSelectI(spip);
+        spiStartExchangeI(spip, frames[currentFrame].len, frames[currentFrame].tx, frames[currentFrame].rx);
     }
-	
-	byteLow = rx_data[data_counter++];
-	byteHigh = (uint16_t)(rx_data[data_counter] & 0x0F) << 8;
-	refVoltage = (float)(byteLow + byteHigh - 512) * 1.5;
-
-	if (rx_data[data_counter] & (1 << 5)) {muxFail=true;} //Check the MUX fail bit
-	else {muxFail=false;}		
+    else
+    {
+        chBSemSignalI(&transferDone);
+    }
+    chSysUnlockFromISR();
 }
+#endif
 
 static bool ltc6803_checkVoltage(float diagVoltage) { //Check if the voltage is in the range 2.5V +-16%
 	float upperLimit,lowerLimit;
@@ -443,74 +593,42 @@ static bool ltc6803_checkVoltage(float diagVoltage) { //Check if the voltage is
 	return isGood;
 }
  
-static void spi_sw_transfer(char *in_buf, const char *out_buf, int length) {
+#ifdef BATTMAN_4_0
+static void spi_sw_transfer(uint8_t *in_buf, const uint8_t *out_buf, int length) {
+    if (length <= 0)
+        return;
     palSetPad(SCK_GPIO, SCK_PIN);
-    chThdSleepMicroseconds(100);
-
-    for (int i = 0; i < length; i++) {
-        unsigned char send = out_buf ? out_buf[i] : 0;
-        unsigned char receive = 0;
-
-        for (int bit=0; bit < 8; bit++) {
-            palClearPad(SCK_GPIO, SCK_PIN);
-            palWritePad(MOSI_GPIO, MOSI_PIN, send >> 7);
-            send <<= 1;
-
-            chThdSleepMicroseconds(100);
-
-            receive <<= 1;
-            if (palReadPad(MISO_GPIO, MISO_PIN)) {
-                receive |= 0x1;
-            }
-
-            palSetPad(SCK_GPIO, SCK_PIN);
-            chThdSleepMicroseconds(100);
-        }
-
-        if (in_buf) {
-            in_buf[i] = receive;
-        }
-    }
+    spi_sw_start(&spi_sw, in_buf, out_buf, length);
+
+    chSysLock();
+    gptStartContinuousI(&GPTD6, SPI_SW_HALF_PERIOD);
+    // A transfer takes 16 timer periods per byte, the timeout only catches a
+    // stopped timer
+    if (chThdSuspendTimeoutS(&spi_sw_thread, MS2ST(10)) == MSG_TIMEOUT)
+        gptStopTimerI(&GPTD6);
+    chSysUnlock();
 }
 
-static uint8_t pec8_calc(uint8_t len, uint8_t *data)
-{
-    uint8_t  remainder = 0x41;//PEC_SEED;
-    int byte;
-    uint8_t bit;
-    /*
-     * Perform modulo-2 division, a byte at a time.
-     */
-    for (byte = 0; byte < len; ++byte)
+// Runs every half SCK period, the LTC6803 shifts data out on the falling
+// edge and samples on the rising edge
+static void spi_sw_tick(GPTDriver *gptp) {
+    (void)gptp;
+
+    if (!spi_sw.clockLow)
     {
-        /*
-         * Bring the next byte into the remainder.
-         */
-        remainder ^= data[byte];
-
-        /*
-         * Perform modulo-2 division, a bit at a time.
-         */
-        for (bit = 8; bit > 0; --bit)
-        {
-            /*
-             * Try to divide the current data bit.
-             */
-            if (remainder & 128)
-            {
-                remainder = (remainder << 1) ^ PEC_POLY;
-            }
-            else
-            {
-                remainder = (remainder << 1);
-            }
-        }
+        palClearPad(SCK_GPIO, SCK_PIN);
+        palWritePad(MOSI_GPIO, MOSI_PIN, spi_sw_falling(&spi_sw));
+        return;
     }
 
-    /*
-     * The final remainder is the CRC result.
-     */
-    return (remainder);
+    bool done = spi_sw_rising(&spi_sw, palReadPad(MISO_GPIO, MISO_PIN));
+    palSetPad(SCK_GPIO, SCK_PIN);
+    if (!done)
+        return;
 
+    chSysLockFromISR();
+    gptStopTimerI(&GPTD6);
+    chThdResumeI(&spi_sw_thread, MSG_OK);
+    chSysUnlockFromISR();
 }
-
+#endif
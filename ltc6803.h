@@ -4,10 +4,20 @@
 #include "ch.h"
 #include "hw_conf.h"
 
+// Daisy chained LTC6803-1 stack, the first device is at the bottom
+#define LTC6803_MAX_DEVICES 3
+#define LTC6803_CELLS_PER_DEVICE 12
+#define LTC6803_TEMPS_PER_DEVICE 3
+#define LTC6803_MAX_CELLS (LTC6803_MAX_DEVICES * LTC6803_CELLS_PER_DEVICE)
+
 void ltc6803_init(void);
 void ltc6803_update(void);
-float* ltc6803_get_cell_voltages(void);
+float ltc6803_get_measurement_rate(void);
+uint32_t ltc6803_get_conversion_timeouts(void);
+uint16_t* ltc6803_get_cell_mv(void);
 float* ltc6803_get_temp(void);
+uint8_t ltc6803_get_num_cells(void);
+uint8_t ltc6803_get_num_devices(void);
 void ltc6803_enable_balance(uint8_t cell);
 void ltc6803_disable_balance(uint8_t cell);
 void ltc6803_disable_balance_all(void);
@@ -9,10 +9,13 @@
 #include "hw_conf.h"
 #include "led_rgb.h"
 #include "ltc6803.h"
+#include "cell_stats.h"
+#include "cell_ir.h"
 #include "charger.h"
 #include "power.h"
 #include "config.h"
 #include "current_monitor.h"
+#include "fast_trip.h"
 #include "soc.h"
 #include "analog.h"
 #include "rtcc.h"
@@ -22,6 +25,8 @@
 #include "faults.h"
 #include "packet.h"
 #include "console.h"
+#include "scheduler.h"
+#include "i2c_bus.h"
 
 static const I2CConfig i2cconfig = {
     STM32_TIMINGR_PRESC(15U) |
@@ -176,15 +181,23 @@ int main(void) {
 
     halInit();
     chSysInit();
+#if defined(FW_PROFILING) && !defined(SIMULATOR)
+    // Keeps the cycle counter running while the idle thread sleeps
+    DBGMCU->CR |= DBGMCU_CR_DBG_SLEEP;
+#endif
     gpio_init();
     chThdSleepMilliseconds(1);
     config_init();
     analog_init();
     power_init();
     i2cStart(&I2C_DEV, &i2cconfig);
+    i2c_bus_init();
+    cell_stats_init();
+    cell_ir_init();
     ltc6803_init();
     charger_init();
     current_monitor_init();
+    fast_trip_init();
     soc_init();
     rtcc_init();
 	temp_init(); //Added
@@ -195,26 +208,33 @@ int main(void) {
     led_rgb_init();
     chThdCreateStatic(led_update_wa, sizeof(led_update_wa), NORMALPRIO, led_update, NULL);
     comm_usb_init();
-	
 
-    while(1)
+    // Periodic tasks, period in milliseconds
+    scheduler_init();
+    scheduler_add_task("Analog", analog_update, 1, SCHEDULER_PRIO_PROTECTION);
+    scheduler_add_task("Current monitor", current_monitor_update, 2, SCHEDULER_PRIO_PROTECTION);
+    scheduler_add_task("Power", power_update, 1, SCHEDULER_PRIO_PROTECTION);
+    scheduler_add_task("Fast trip", fast_trip_update, 1, SCHEDULER_PRIO_PROTECTION);
+    scheduler_add_task("LTC6803", ltc6803_update, 2, SCHEDULER_PRIO_MEASUREMENT);
+    scheduler_add_task("Cell IR", cell_ir_update, 20, SCHEDULER_PRIO_MEASUREMENT);
+    scheduler_add_task("SoC", soc_update, 100, SCHEDULER_PRIO_MEASUREMENT);
+    scheduler_add_task("Charger", charger_update, 100, SCHEDULER_PRIO_MEASUREMENT);
+    scheduler_add_task("Charge control", charger_control_update, CHARGER_CONTROL_PERIOD, SCHEDULER_PRIO_MEASUREMENT);
+    scheduler_add_task("Temperature", temp_update, 100, SCHEDULER_PRIO_MEASUREMENT);
+    scheduler_add_task("RTCC", rtcc_update, 1000, SCHEDULER_PRIO_BACKGROUND);
+    scheduler_add_task("ISL28022 config", current_monitor_configure, 1000, SCHEDULER_PRIO_BACKGROUND);
+    scheduler_add_task("Accessory", accessory_update, 100, SCHEDULER_PRIO_BACKGROUND);
+    scheduler_add_task("CAN", comm_can_update, 100, SCHEDULER_PRIO_BACKGROUND);
+    current_monitor_start();
+    scheduler_start();
+
+    while (!power_is_shutdown())
     {
-        analog_update();
-        ltc6803_update();
-        current_monitor_update();
-        soc_update();
-        charger_update();
-        power_update();
-        rtcc_update();
-		temp_update(); //Added
-        accessory_update();
-        comm_can_update();
-        if (power_is_shutdown())
-        {
-            comm_usb_deinit();
-            led_rgb_set(0);
-            buzzer_set_frequency(0);
-            break;
-        }
+        chThdSleepMilliseconds(10);
     }
+    scheduler_stop();
+    current_monitor_stop();
+    comm_usb_deinit();
+    led_rgb_set(0);
+    buzzer_set_frequency(0);
 }
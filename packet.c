@@ -4,10 +4,12 @@
 #include "comm_usb.h"
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 #include "console.h"
 #include "config.h"
 #include "datatypes.h"
 #include "ltc6803.h"
+#include "cell_stats.h"
 #include "current_monitor.h"
 #include "charger.h"
 #include "analog.h"
@@ -134,6 +136,7 @@ static void process_packet(unsigned char *data, unsigned int len)
     uint16_t config_addr;
     uint8_t config_value[4];
     uint8_t readInx = 0;
+    CurrentMonitorSample sample;
     switch(id)
     {
         case PACKET_CONNECT:
@@ -150,9 +153,10 @@ static void process_packet(unsigned char *data, unsigned int len)
             break;
         case PACKET_GET_DATA:
             packet_send_buffer[inx++] = PACKET_GET_DATA;
-            utils_append_float32(packet_send_buffer, current_monitor_get_bus_voltage(), &inx);
+            current_monitor_get_sample(&sample);
+            utils_append_float32(packet_send_buffer, sample.voltage, &inx);
             utils_append_float32(packet_send_buffer, analog_temperature(), &inx);
-            utils_append_float32(packet_send_buffer, current_monitor_get_current(), &inx);
+            utils_append_float32(packet_send_buffer, sample.current, &inx);
             utils_append_float32(packet_send_buffer, charger_get_output_voltage(), &inx);
             packet_send_buffer[inx++] = faults_get_faults();
             utils_append_uint16(packet_send_buffer, faults_get_warnings(), &inx); //Added
@@ -160,12 +164,25 @@ static void process_packet(unsigned char *data, unsigned int len)
             packet_send_buffer[inx++] = charger_is_charging();
             packet_send_packet((unsigned char*)packet_send_buffer, inx);
             break;
+        case PACKET_GET_OVERCURRENT:
+            packet_send_buffer[inx++] = PACKET_GET_OVERCURRENT;
+            I2tState i2t;
+            current_monitor_get_i2t(&i2t);
+            utils_append_float32(packet_send_buffer, current_monitor_get_headroom(), &inx);
+            utils_append_float32(packet_send_buffer, sqrtf(i2t.heat), &inx);
+            utils_append_uint16(packet_send_buffer, i2t.numEvents, &inx);
+            utils_append_float32(packet_send_buffer, i2t.event.energy, &inx);
+            utils_append_float32(packet_send_buffer, i2t.event.peakCurrent, &inx);
+            utils_append_float32(packet_send_buffer, i2t.event.duration, &inx);
+            packet_send_packet((unsigned char*)packet_send_buffer, inx);
+            break;
         case PACKET_GET_CELLS:
             packet_send_buffer[inx++] = PACKET_GET_CELLS;
-            float* cells = ltc6803_get_cell_voltages();
-            for (uint8_t i = 0; i < config_get_configuration()->numCells; i++)
+            CellStats cells;
+            cell_stats_get(&cells);
+            for (uint8_t i = 0; i < cells.numCells; i++)
             {
-                utils_append_float32(packet_send_buffer, cells[i], &inx);
+                utils_append_float32(packet_send_buffer, cells.cellMv[i] / 1000.0, &inx);
             }
             packet_send_packet((unsigned char*)packet_send_buffer, inx);
             break;
@@ -0,0 +1,12 @@
+#ifndef _PEC8_H_
+#define _PEC8_H_
+
+// No ChibiOS dependency, the PEC also builds on a host
+#include <stdint.h>
+
+#define PEC8_SEED 0x41
+
+uint8_t pec8_calc(uint8_t len, const uint8_t *data);
+uint8_t pec8_update(uint8_t pec, uint8_t data);
+
+#endif /* _PEC8_H_ */
@@ -6,6 +6,7 @@
 #include "charger.h"
 #include "rtcc.h"
 #include "faults.h"
+#include "precharge.h"
 
 static volatile bool discharge_enabled = false;
 static volatile bool precharged = false;
@@ -76,27 +77,42 @@ void power_update(void) {
 					palSetPad(PCHG_SW_GPIO, PCHG_SW_PIN);
 					isPrecharging=true;
 					power_status = PRECHARGING;
+					precharge_start(current_monitor_get_bus_voltage(), config->prechargeTimeout / 1000.0);
 				}
-				if (isPrecharging && ST2MS(chVTTimeElapsedSinceX(prechargeStartTime)) > 8)
+				// Fitted on every update, rejects shorts and oversized loads
+				PrechargeState state = precharge_update(analog_discharge_voltage(),
+						(float)chVTTimeElapsedSinceX(prechargeStartTime) / CH_CFG_ST_FREQUENCY);
+				if (state == PRECHARGE_SHORT || state == PRECHARGE_OVERLOAD)
 				{
-					if (analog_discharge_voltage() < 0.5) // Turned on into short
-					{
-						palClearPad(DSG_SW_GPIO, DSG_SW_PIN);
-						palClearPad(PCHG_SW_GPIO, PCHG_SW_PIN);
-						faults_set_fault(FAULT_TURN_ON_SHORT);
-						power_status = STANDBY;
-						return;
-					}
+					palClearPad(DSG_SW_GPIO, DSG_SW_PIN);
+					palClearPad(PCHG_SW_GPIO, PCHG_SW_PIN);
+					faults_set_fault(FAULT_TURN_ON_SHORT);
+					power_status = STANDBY;
+					isPrecharging = false;
+					return;
 				}
-				if (analog_discharge_voltage() >= current_monitor_get_bus_voltage() - 5.0 || ST2MS(chVTTimeElapsedSinceX(prechargeStartTime)) > config->prechargeTimeout) {
+				if (state == PRECHARGE_DONE) {
 					precharged = true;
 					isPrecharging = false;
 				}
 			}
 			if (precharged) {
-				palSetPad(DSG_SW_GPIO, DSG_SW_PIN);
-				palClearPad(PCHG_SW_GPIO, PCHG_SW_PIN);
-				power_status = DISCHARGING;				
+				// A fast trip may have happened since the check above, its
+				// interrupt can't come between this one and the switch
+				chSysLock();
+				bool allowed = discharge_enabled && faults_get_faults() == FAULT_NONE;
+				if (allowed)
+				{
+					palSetPad(DSG_SW_GPIO, DSG_SW_PIN);
+					palClearPad(PCHG_SW_GPIO, PCHG_SW_PIN);
+					power_status = DISCHARGING;
+				}
+				chSysUnlock();
+				if (!allowed)
+				{
+					powerSwitchOff();
+					precharged = false;
+				}
 			}
 			/*else
 			{
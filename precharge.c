@@ -0,0 +1,123 @@
+#include "precharge.h"
+#include <math.h>
+
+// The output charges through the precharge resistor as an RC circuit
+// towards the voltage divided by the load, dV/dt = (Vf - V) / tau. Each
+// sample adds a point (V, dV/dt) to a linear least squares fit whose
+// slope gives tau and whose zero gives Vf. From the fit:
+// - the output never rising is a short,
+// - Vf below the closing threshold is a resistive load too heavy for the
+//   switch to close on,
+// - a predicted time to the threshold beyond the timeout is a capacitance
+//   too large, rejected without waiting for the timeout.
+// The discharge switch closes as soon as the output is within
+// PRECHARGE_DONE_DELTA of the bus, the timeout is a failure.
+
+#define PRECHARGE_DONE_DELTA 5.0   // V
+#define PRECHARGE_SHORT_VOLTAGE 0.5 // V
+#define PRECHARGE_SHORT_TIME 0.008  // s
+#define PRECHARGE_MIN_SAMPLES 5
+// The fit is trusted once the output rose by a quarter of the bus, or
+// settled after a few time constants
+#define PRECHARGE_MIN_RISE 0.25
+#define PRECHARGE_SETTLED_TAUS 3.0
+
+static float bus;
+static float timeoutTime;
+static float startVoltage;
+static float prevVoltage;
+static float prevTime;
+static float sumX, sumY, sumXX, sumXY;
+static PrechargeFit fit;
+
+void precharge_start(float busVoltage, float timeout)
+{
+    bus = busVoltage;
+    timeoutTime = timeout;
+    sumX = sumY = sumXX = sumXY = 0.0;
+    fit.state = PRECHARGE_RUNNING;
+    fit.tau = 0.0;
+    fit.finalVoltage = 0.0;
+    fit.predictedTime = 0.0;
+    fit.elapsed = 0.0;
+    fit.samples = 0;
+}
+
+// Fits dV/dt = a + b.V, false while the points do not define a slope
+static bool precharge_fit(void)
+{
+    float n = fit.samples - 1;
+    float det = n * sumXX - sumX * sumX;
+    if (n < 2 || det <= 0.0)
+        return false;
+    float b = (n * sumXY - sumX * sumY) / det;
+    float a = (sumY - b * sumX) / n;
+    if (b >= 0.0)
+        return false;
+    fit.tau = -1.0 / b;
+    fit.finalVoltage = a * fit.tau;
+    return true;
+}
+
+// Called at a fixed rate with the output voltage and the time since the
+// start of the precharge
+PrechargeState precharge_update(float outputVoltage, float elapsed)
+{
+    if (fit.state != PRECHARGE_RUNNING)
+        return fit.state;
+
+    float threshold = bus - PRECHARGE_DONE_DELTA;
+
+    fit.elapsed = elapsed;
+    if (fit.samples == 0)
+    {
+        startVoltage = outputVoltage;
+    }
+    else if (elapsed > prevTime)
+    {
+        float x = (outputVoltage + prevVoltage) / 2.0;
+        float y = (outputVoltage - prevVoltage) / (elapsed - prevTime);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    fit.samples++;
+    prevVoltage = outputVoltage;
+    prevTime = elapsed;
+
+    if (outputVoltage >= threshold)
+    {
+        fit.predictedTime = elapsed;
+        fit.state = PRECHARGE_DONE;
+    }
+    else if (elapsed >= PRECHARGE_SHORT_TIME && outputVoltage < PRECHARGE_SHORT_VOLTAGE)
+    {
+        fit.state = PRECHARGE_SHORT;
+    }
+    else if (elapsed >= timeoutTime)
+    {
+        fit.state = PRECHARGE_OVERLOAD;
+    }
+    else if (fit.samples >= PRECHARGE_MIN_SAMPLES && precharge_fit() &&
+            (outputVoltage - startVoltage >= PRECHARGE_MIN_RISE * bus || elapsed >= PRECHARGE_SETTLED_TAUS * fit.tau))
+    {
+        if (fit.finalVoltage < threshold)
+        {
+            fit.state = fit.finalVoltage < PRECHARGE_SHORT_VOLTAGE ? PRECHARGE_SHORT : PRECHARGE_OVERLOAD;
+        }
+        else
+        {
+            fit.predictedTime = elapsed + fit.tau * logf((fit.finalVoltage - outputVoltage) / (fit.finalVoltage - threshold));
+            if (fit.predictedTime > timeoutTime)
+                fit.state = PRECHARGE_OVERLOAD;
+        }
+    }
+
+    return fit.state;
+}
+
+void precharge_get_fit(PrechargeFit *f)
+{
+    *f = fit;
+}
@@ -0,0 +1,31 @@
+#ifndef _PRECHARGE_H_
+#define _PRECHARGE_H_
+
+// No ChibiOS dependency, the fit also builds on a host
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    PRECHARGE_IDLE = 0,
+    PRECHARGE_RUNNING,
+    PRECHARGE_DONE,
+    PRECHARGE_SHORT,   // The output does not rise
+    PRECHARGE_OVERLOAD // Resistive load too low or capacitance too high
+} PrechargeState;
+
+typedef struct
+{
+    PrechargeState state;
+    float tau;           // s, fitted RC time constant
+    float finalVoltage;  // V, fitted asymptote of the output
+    float predictedTime; // s, from the start to the closing threshold
+    float elapsed;       // s, at the last update
+    uint16_t samples;
+} PrechargeFit;
+
+void precharge_start(float busVoltage, float timeout);
+PrechargeState precharge_update(float outputVoltage, float elapsed);
+void precharge_get_fit(PrechargeFit *fit);
+
+#endif /* _PRECHARGE_H_ */
@@ -1,6 +1,7 @@
 #include "rtcc.h"
 #include "hal.h"
 #include "hw_conf.h"
+#include "i2c_bus.h"
 
 #define I2C_ADDRESS 0x51
 #define HEX_TO_BCD(x) ((x / 10) << 4) | (x % 10)
@@ -10,51 +11,41 @@ static Time time;
 void rtcc_init(void)
 {
     uint8_t tx[2];
-    uint8_t rx[2];
     tx[0] = 0x25; //Oscillator register
     tx[1] = 0x01;
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
     tx[0] = 0x26;//Battery switch register
     tx[1] = 0x06;
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
     tx[0] = 0x27;//Pin_IO register
     tx[1] = 0x02;
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
     tx[0] = 0x29;//INTA_enable
     tx[1] = 0x90;//Interrupt activated as a flag (permanent signal) by alarm1
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
     tx[0] = 0x2B;//Flags
     tx[1] = 0x00;//Clear all flags
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
     tx[0] = 0x10;//Alarm enables
     tx[1] = 0x00;//Diasables all alarms
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
 }
 
+// The time registers are consecutive, the RTCC increments its register
+// pointer after each byte so they are read in one transfer
 void rtcc_update(void)
 {
-    i2cAcquireBus(&I2C_DEV);
     uint8_t tx[1];
-    uint8_t rx[1];
-    tx[0] = 0x01;//Current time second
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 1, MS2ST(10));
+    uint8_t rx[7];
+    tx[0] = 0x01;//Current time second, then minutes, hours, days, weekdays, months and years
+    if (i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 1, rx, 7) != MSG_OK)
+        return;
     time.second = ((rx[0] >> 4) & 0x07) * 10 + (rx[0] & 0x0F);
-    tx[0] = 0x02;//Current time minutes
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 1, MS2ST(10));
-    time.minute = ((rx[0] >> 4) & 0x07) * 10 + (rx[0] & 0x0F);
-    tx[0] = 0x03;//Current time hours
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 1, MS2ST(10));
-    time.hour = ((rx[0] >> 4) & 0x03) * 10 + (rx[0] & 0x0F);
-    tx[0] = 0x04;//Current time days
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 1, MS2ST(10));
-    time.day = ((rx[0] >> 4) & 0x03) * 10 + (rx[0] & 0x0F);
-    tx[0] = 0x06;////Current time months
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 1, MS2ST(10));
-    time.month = ((rx[0] >> 4) & 0x01) * 10 + (rx[0] & 0x0F);
-    tx[0] = 0x07;//Years
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 1, rx, 1, MS2ST(10));
-    time.year = (rx[0] >> 4) * 10 + (rx[0] & 0x0F);
-    i2cReleaseBus(&I2C_DEV);
+    time.minute = ((rx[1] >> 4) & 0x07) * 10 + (rx[1] & 0x0F);
+    time.hour = ((rx[2] >> 4) & 0x03) * 10 + (rx[2] & 0x0F);
+    time.day = ((rx[3] >> 4) & 0x03) * 10 + (rx[3] & 0x0F);
+    time.month = ((rx[5] >> 4) & 0x01) * 10 + (rx[5] & 0x0F);
+    time.year = (rx[6] >> 4) * 10 + (rx[6] & 0x0F);
 }
 
 Time rtcc_get_time(void)
@@ -73,12 +64,11 @@ void rtcc_enable_alarm(void)
     else
         numDays = 30;
     uint8_t day = time.day == 1 ? numDays : (time.day - 1 > numDays ? numDays : (time.day - 1));
-    uint8_t tx[1];
-    uint8_t rx[1];
+    uint8_t tx[2];
     tx[0] = 0x0B;//Day_alarm1
     tx[1] = HEX_TO_BCD(day);
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
     tx[0] = 0x10;//Alarm enables
     tx[1] = 0x08;//Enables alarm1
-    i2cMasterTransmitTimeout(&I2C_DEV, I2C_ADDRESS, tx, 2, rx, 0, MS2ST(10));
+    i2c_bus_transfer(I2C_BUS_RTCC, I2C_ADDRESS, tx, 2, NULL, 0);
 }
@@ -0,0 +1,143 @@
+#include "scheduler.h"
+
+// Periodic task scheduler. Each priority level runs in its own thread, the
+// tasks of a level are released at a fixed rate and run in the order they
+// were added. A task that is still running when its next release is due
+// counts a deadline miss and is re-released from the current time instead
+// of catching up. The threads sleep until the earliest release of their
+// level so that the core idles between deadlines.
+
+typedef struct
+{
+    const char *name;
+    tprio_t threadPriority;
+    stkalign_t *wa;
+    size_t waSize;
+    thread_t *tp;
+} SchedulerLevel;
+
+static THD_WORKING_AREA(protection_thread_wa, 1024);
+static THD_WORKING_AREA(measurement_thread_wa, 2048);
+static THD_WORKING_AREA(background_thread_wa, 1024);
+
+static SchedulerLevel levels[SCHEDULER_NUM_PRIOS] = {
+    {"Protection tasks", NORMALPRIO + 3, protection_thread_wa, sizeof(protection_thread_wa), NULL},
+    {"Measurement tasks", NORMALPRIO + 2, measurement_thread_wa, sizeof(measurement_thread_wa), NULL},
+    {"Background tasks", NORMALPRIO, background_thread_wa, sizeof(background_thread_wa), NULL}
+};
+
+static SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+static uint8_t numTasks;
+static volatile bool stopped;
+
+static THD_FUNCTION(scheduler_thread, arg);
+
+void scheduler_init(void)
+{
+    numTasks = 0;
+    stopped = false;
+}
+
+void scheduler_add_task(const char *name, void (*update)(void), uint16_t periodMs, SchedulerPriority priority)
+{
+    if (numTasks >= SCHEDULER_MAX_TASKS || priority >= SCHEDULER_NUM_PRIOS)
+        return;
+    SchedulerTask *task = &tasks[numTasks++];
+    task->name = name;
+    task->update = update;
+    task->period = MS2ST(periodMs) > 0 ? MS2ST(periodMs) : 1;
+    task->priority = priority;
+    task->runs = 0;
+    task->deadlineMisses = 0;
+    task->worstCaseTime = 0;
+}
+
+void scheduler_start(void)
+{
+    systime_t now = chVTGetSystemTime();
+    for (uint8_t i = 0; i < numTasks; i++)
+        tasks[i].release = now;
+    for (uint8_t i = 0; i < SCHEDULER_NUM_PRIOS; i++)
+    {
+        levels[i].tp = chThdCreateStatic(levels[i].wa, levels[i].waSize,
+                levels[i].threadPriority, scheduler_thread, (void*)(uint32_t)i);
+    }
+}
+
+void scheduler_stop(void)
+{
+    stopped = true;
+    for (uint8_t i = 0; i < SCHEDULER_NUM_PRIOS; i++)
+    {
+        if (levels[i].tp != NULL)
+        {
+            chThdWait(levels[i].tp);
+            levels[i].tp = NULL;
+        }
+    }
+}
+
+uint8_t scheduler_get_num_tasks(void)
+{
+    return numTasks;
+}
+
+const SchedulerTask* scheduler_get_task(uint8_t index)
+{
+    if (index >= numTasks)
+        return NULL;
+    return &tasks[index];
+}
+
+uint32_t scheduler_get_deadline_misses(void)
+{
+    uint32_t misses = 0;
+    for (uint8_t i = 0; i < numTasks; i++)
+        misses += tasks[i].deadlineMisses;
+    return misses;
+}
+
+// Signed distance from now to a release time, negative when it is past
+static int32_t time_until(systime_t time)
+{
+    return (int32_t)(time - chVTGetSystemTimeX());
+}
+
+static THD_FUNCTION(scheduler_thread, arg) {
+    SchedulerPriority priority = (SchedulerPriority)(uint32_t)arg;
+
+    chRegSetThreadName(levels[priority].name);
+
+    while (!stopped)
+    {
+        int32_t delay = INT32_MAX;
+        for (uint8_t i = 0; i < numTasks; i++)
+        {
+            SchedulerTask *task = &tasks[i];
+            if (task->priority != priority)
+                continue;
+            if (time_until(task->release) <= 0)
+            {
+                systime_t start = chVTGetSystemTimeX();
+                task->update();
+                systime_t elapsed = chVTTimeElapsedSinceX(start);
+                if (elapsed > task->worstCaseTime)
+                    task->worstCaseTime = elapsed;
+                task->runs++;
+                task->release += task->period;
+                if (time_until(task->release) <= 0)
+                {
+                    task->deadlineMisses++;
+                    task->release = chVTGetSystemTimeX() + task->period;
+                }
+            }
+            int32_t remaining = time_until(task->release);
+            if (remaining < delay)
+                delay = remaining;
+        }
+        if (delay == INT32_MAX)
+            break;
+        if (delay > 0)
+            chThdSleep((systime_t)delay);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include "ch.h"
+
+#define SCHEDULER_MAX_TASKS 16
+
+typedef enum
+{
+    SCHEDULER_PRIO_PROTECTION = 0,
+    SCHEDULER_PRIO_MEASUREMENT,
+    SCHEDULER_PRIO_BACKGROUND,
+    SCHEDULER_NUM_PRIOS
+} SchedulerPriority;
+
+typedef struct
+{
+    const char *name;
+    void (*update)(void);
+    systime_t period;
+    SchedulerPriority priority;
+    systime_t release;
+    uint32_t runs;
+    uint32_t deadlineMisses;
+    systime_t worstCaseTime;
+} SchedulerTask;
+
+void scheduler_init(void);
+void scheduler_add_task(const char *name, void (*update)(void), uint16_t periodMs, SchedulerPriority priority);
+void scheduler_start(void);
+void scheduler_stop(void);
+uint8_t scheduler_get_num_tasks(void);
+const SchedulerTask* scheduler_get_task(uint8_t index);
+uint32_t scheduler_get_deadline_misses(void);
+
+#endif /* _SCHEDULER_H_ */
@@ -0,0 +1,62 @@
+#include "seqlock.h"
+#include <string.h>
+
+// Sequence lock: the writer makes the counter odd while it updates the
+// shared data and even again when it is done. A reader copies the data and
+// retries if the counter was odd or has changed meanwhile, so it never
+// blocks the writer and never returns a mix of two updates. A reader with
+// a higher priority than the writer sleeps for a tick when it finds an
+// update in progress to let the writer finish. The readers must not run
+// from an ISR or with the system locked.
+
+#define SEQLOCK_BARRIER() __sync_synchronize()
+
+void seqlock_init(seqlock_t *lock)
+{
+    lock->seq = 0;
+}
+
+void seqlock_write_begin(seqlock_t *lock)
+{
+    lock->seq++;
+    SEQLOCK_BARRIER();
+}
+
+void seqlock_write_end(seqlock_t *lock)
+{
+    SEQLOCK_BARRIER();
+    lock->seq++;
+}
+
+uint32_t seqlock_read_begin(seqlock_t *lock)
+{
+    uint32_t seq;
+    while ((seq = lock->seq) & 1)
+        chThdSleep(1);
+    SEQLOCK_BARRIER();
+    return seq;
+}
+
+// True if the data read since seqlock_read_begin may be torn
+bool seqlock_read_retry(seqlock_t *lock, uint32_t seq)
+{
+    SEQLOCK_BARRIER();
+    return lock->seq != seq;
+}
+
+void seqlock_publish(seqlock_t *lock, void *shared, const void *data, size_t size)
+{
+    seqlock_write_begin(lock);
+    memcpy(shared, data, size);
+    seqlock_write_end(lock);
+}
+
+void seqlock_snapshot(seqlock_t *lock, void *data, const void *shared, size_t size)
+{
+    uint32_t seq;
+    do
+    {
+        seq = seqlock_read_begin(lock);
+        memcpy(data, shared, size);
+    } while (seqlock_read_retry(lock, seq));
+}
@@ -0,0 +1,21 @@
+#ifndef _SEQLOCK_H_
+#define _SEQLOCK_H_
+
+#include "ch.h"
+#include <stddef.h>
+
+// Sequence lock for the data shared between threads, one writer per lock
+typedef struct
+{
+    volatile uint32_t seq;
+} seqlock_t;
+
+void seqlock_init(seqlock_t *lock);
+void seqlock_write_begin(seqlock_t *lock);
+void seqlock_write_end(seqlock_t *lock);
+uint32_t seqlock_read_begin(seqlock_t *lock);
+bool seqlock_read_retry(seqlock_t *lock, uint32_t seq);
+void seqlock_publish(seqlock_t *lock, void *shared, const void *data, size_t size);
+void seqlock_snapshot(seqlock_t *lock, void *data, const void *shared, size_t size);
+
+#endif /* _SEQLOCK_H_ */
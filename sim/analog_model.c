@@ -0,0 +1,50 @@
+#include "sim_models.h"
+#include "sim_battery.h"
+#include "hal.h"
+#include "hw_conf.h"
+#include <math.h>
+
+#define THERMISTOR_BETA 3434.0
+
+static adcsample_t to_sample(float pin_voltage)
+{
+    float s = pin_voltage / 3.3 * 4095.0;
+    if (s < 0.0)
+        return 0;
+    if (s > 4095.0)
+        return 4095;
+    return (adcsample_t)lroundf(s);
+}
+
+static adcsample_t analog_sample(ADCDriver *adcp, uint32_t channel)
+{
+    (void)adcp;
+
+    sim_battery_update();
+    switch (channel)
+    {
+    case CHG_SENSE_CHANNEL:
+        return to_sample(sim_battery_get_charger_voltage() * 4700.0 / (51000.0 + 18000.0 + 4700.0));
+    case DSG_SENSE_CHANNEL:
+        return to_sample(sim_battery_get_output_voltage() * 10000.0 / (200000.0 + 100 + 2500 + 10000.0));
+    case TEMP_SENSE_CHANNEL:
+    {
+        // 10k NTC on the high side of a 10k divider
+        float temp = sim_battery_get_board_temperature() + 273.15;
+        float r = 10000.0 * expf(THERMISTOR_BETA * (1.0 / temp - 1.0 / 298.15));
+        return to_sample(3.3 * 10000.0 / (r + 10000.0));
+    }
+    default:
+        return 0;
+    }
+}
+
+static const ADCSimModel analog_model = {
+    analog_sample
+};
+
+void analog_model_init(void)
+{
+    adcSimSetModel(&ADCD3, &analog_model);
+    adcSimSetModel(&ADCD4, &analog_model);
+}
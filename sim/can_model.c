@@ -0,0 +1,50 @@
+#include "sim_models.h"
+#include "hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static bool trace;
+
+static void can_transmit(CANDriver *canp, const CANTxFrame *ctfp)
+{
+    (void)canp;
+
+    if (!trace)
+        return;
+    printf("CAN TX %08X [%d]", ctfp->IDE == CAN_IDE_EXT ? ctfp->EID : ctfp->SID, ctfp->DLC);
+    for (uint8_t i = 0; i < ctfp->DLC; i++)
+        printf(" %02X", ctfp->data8[i]);
+    printf("\n");
+    fflush(stdout);
+}
+
+static const CANSimModel can_model = {
+    can_transmit
+};
+
+// Queues an extended frame as if it was sent by another node
+bool can_model_inject(uint32_t eid, const uint8_t *data, uint8_t len)
+{
+    CANRxFrame frame;
+    bool ok;
+
+    frame.FMI = 0;
+    frame.TIME = 0;
+    frame.IDE = CAN_IDE_EXT;
+    frame.RTR = CAN_RTR_DATA;
+    frame.EID = eid;
+    frame.DLC = len > 8 ? 8 : len;
+    for (uint8_t i = 0; i < frame.DLC; i++)
+        frame.data8[i] = data[i];
+
+    chSysLock();
+    ok = canSimInjectI(&CAND1, &frame);
+    chSysUnlock();
+    return ok;
+}
+
+void can_model_init(void)
+{
+    trace = getenv("BATTMAN_SIM_CAN_TRACE") != NULL;
+    canSimSetModel(&CAND1, &can_model);
+}
@@ -0,0 +1,39 @@
+#include "sim_models.h"
+#include "sim_battery.h"
+#include "hal.h"
+#include "hw_conf.h"
+
+// Charger output voltage DAC, 14 bits, full scale 3.3V
+#define I2C_ADDRESS 0x1F
+
+static msg_t dac_transfer(I2CSimDevice *devp, const uint8_t *txbuf, size_t txn,
+                          uint8_t *rxbuf, size_t rxn)
+{
+    (void)devp;
+    (void)rxbuf;
+
+    if (rxn > 0)
+        return MSG_RESET;
+    if (txn == 3 && txbuf[0] == 0x01)
+    {
+        uint16_t value = (txbuf[1] << 6) | (txbuf[2] >> 2);
+        float dac_voltage = value / 16383.0 * 3.3;
+#if defined(BATTMAN_4_1)
+        sim_battery_set_charger_setpoint(51.66 - dac_voltage / 0.075);
+#else
+        sim_battery_set_charger_setpoint(51.584 - dac_voltage / 0.075);
+#endif
+    }
+    return MSG_OK;
+}
+
+static I2CSimDevice dac_device = {
+    I2C_ADDRESS,
+    dac_transfer,
+    NULL
+};
+
+void dac_model_init(void)
+{
+    i2cSimAttachDevice(&I2C_DEV, &dac_device);
+}
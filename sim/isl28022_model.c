@@ -0,0 +1,94 @@
+#include "sim_models.h"
+#include "sim_battery.h"
+#include "hal.h"
+#include "hw_conf.h"
+#include <math.h>
+
+#define I2C_ADDRESS 0x40
+#define SHUNT_RESISTANCE 0.0005
+
+#define REG_CONFIG          0x00
+#define REG_SHUNT_VOLTAGE   0x01
+#define REG_BUS_VOLTAGE     0x02
+#define REG_SHUNT_THRESHOLD 0x06
+#define REG_INT_STATUS      0x08
+#define NUM_REGS            0x0A
+
+static uint16_t regs[NUM_REGS];
+static uint8_t pointer;
+
+static int16_t saturate(float value)
+{
+    if (value > 32767.0)
+        return 32767;
+    if (value < -32768.0)
+        return -32768;
+    return (int16_t)lroundf(value);
+}
+
+static void sample(void)
+{
+    sim_battery_update();
+    float shunt_voltage = sim_battery_get_current() * SHUNT_RESISTANCE;
+    regs[REG_SHUNT_VOLTAGE] = (uint16_t)saturate(shunt_voltage / 1.0e-5); // 10uV per LSB
+    regs[REG_BUS_VOLTAGE] = (uint16_t)saturate(sim_battery_get_pack_voltage() / 0.004) << 2; // 4mV per LSB
+
+    // Shunt threshold comparator, the alert stays latched until the status
+    // register is written
+    int8_t max = (int8_t)(regs[REG_SHUNT_THRESHOLD] >> 8);
+    int8_t min = (int8_t)(regs[REG_SHUNT_THRESHOLD] & 0xFF);
+    if (regs[REG_SHUNT_THRESHOLD] != 0 &&
+        (shunt_voltage > max * 0.00256 || shunt_voltage < min * 0.00256))
+    {
+        regs[REG_INT_STATUS] |= 0x01;
+        sim_set_input(CURR_ALERT_GPIO, CURR_ALERT_PIN, false);
+    }
+}
+
+static msg_t isl28022_transfer(I2CSimDevice *devp, const uint8_t *txbuf, size_t txn,
+                               uint8_t *rxbuf, size_t rxn)
+{
+    (void)devp;
+
+    if (txn >= 1)
+        pointer = txbuf[0];
+    if (pointer >= NUM_REGS)
+        return MSG_RESET;
+
+    if (txn >= 3)
+    {
+        regs[pointer] = (txbuf[1] << 8) | txbuf[2];
+        if (pointer == REG_INT_STATUS)
+        {
+            regs[REG_INT_STATUS] = 0;
+            sim_set_input(CURR_ALERT_GPIO, CURR_ALERT_PIN, true);
+        }
+    }
+
+    // The register pointer increments after each word read
+    if (rxn > 0)
+        sample();
+    for (size_t i = 0; i < rxn; i++)
+    {
+        uint8_t reg = pointer + i / 2;
+        if (reg >= NUM_REGS)
+            return MSG_RESET;
+        rxbuf[i] = (i % 2 == 0) ? regs[reg] >> 8 : regs[reg] & 0xFF;
+    }
+    return MSG_OK;
+}
+
+static I2CSimDevice isl28022_device = {
+    I2C_ADDRESS,
+    isl28022_transfer,
+    NULL
+};
+
+void isl28022_model_init(void)
+{
+    for (uint8_t i = 0; i < NUM_REGS; i++)
+        regs[i] = 0;
+    regs[REG_CONFIG] = 0x799F;
+    pointer = 0;
+    i2cSimAttachDevice(&I2C_DEV, &isl28022_device);
+}
@@ -0,0 +1,276 @@
+#include "sim_models.h"
+#include "sim_battery.h"
+#include "hal.h"
+#include <math.h>
+
+// LTC6803 command codes, each one followed by its PEC byte
+#define CMD_WRCFG   0x01
+#define CMD_RDCFG   0x02
+#define CMD_RDCV    0x04
+#define CMD_RDTMP   0x0E
+#define CMD_STCVAD  0x10
+#define CMD_STTMPAD 0x30
+#define CMD_PLADC   0x40
+#define CMD_DAGN    0x52
+#define CMD_RDDGNR  0x54
+
+#define MAX_DEVICES 3
+#define CELLS_PER_DEVICE 12
+#define CFG_LEN 6
+#define CV_LEN 18
+
+#define VREF 3.065
+#define THERMISTOR_R25 10000.0
+#define THERMISTOR_BETA 3434.0
+#define DIVIDER_R 10000.0
+
+// Conversion times with the default comparator duty cycle
+#define CELL_CONVERSION_TIME MS2ST(13)
+#define TEMP_CONVERSION_TIME MS2ST(4)
+#define DIAG_CONVERSION_TIME MS2ST(16)
+
+// Device 0 is the bottom of the stack
+static uint8_t num_devices;
+static uint8_t cfgr[MAX_DEVICES][CFG_LEN];
+static uint8_t cvr[MAX_DEVICES][CV_LEN];
+static uint8_t tmpr[MAX_DEVICES][5];
+static uint8_t dgnr[MAX_DEVICES][2];
+static systime_t conversion_end;
+
+static uint8_t cmd;
+static bool cmd_valid;
+static uint8_t byte_index;
+static uint8_t rx_data[MAX_DEVICES * (CFG_LEN + 1)];
+static uint8_t tx_data[MAX_DEVICES * (CV_LEN + 1)];
+static uint8_t tx_len;
+
+static uint8_t pec8(const uint8_t *data, uint8_t len)
+{
+    uint8_t remainder = 0x41;
+    for (uint8_t i = 0; i < len; i++)
+    {
+        remainder ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+            remainder = (remainder & 0x80) ? (remainder << 1) ^ 0x07 : remainder << 1;
+    }
+    return remainder;
+}
+
+// 12 bits ADC code, 1.5mV per LSB with a 512 offset
+static uint16_t code(float voltage)
+{
+    float c = voltage / 0.0015 + 512;
+    if (c < 0)
+        return 0;
+    if (c > 4095)
+        return 4095;
+    return (uint16_t)lroundf(c);
+}
+
+static void pack_codes(uint8_t *reg, uint16_t low, uint16_t high)
+{
+    reg[0] = low & 0xFF;
+    reg[1] = ((low >> 8) & 0x0F) | ((high & 0x0F) << 4);
+    reg[2] = (high >> 4) & 0xFF;
+}
+
+static float thermistor_voltage(float temp)
+{
+    float r = THERMISTOR_R25 * expf(THERMISTOR_BETA * (1.0 / (temp + 273.15) - 1.0 / 298.15));
+    return VREF * r / (r + DIVIDER_R);
+}
+
+static void convert_cells(void)
+{
+    sim_battery_update();
+    for (uint8_t d = 0; d < num_devices; d++)
+    {
+        uint8_t first = d * CELLS_PER_DEVICE;
+        for (uint8_t k = 0; k < CELLS_PER_DEVICE; k += 2)
+        {
+            pack_codes(&cvr[d][k / 2 * 3],
+                       code(sim_battery_get_cell_voltage(first + k)),
+                       code(sim_battery_get_cell_voltage(first + k + 1)));
+        }
+    }
+}
+
+static void convert_temps(void)
+{
+    float die_temp = sim_battery_get_board_temperature();
+    uint16_t itmp = code((die_temp + 273.15) * 0.008);
+
+    for (uint8_t d = 0; d < num_devices; d++)
+    {
+        pack_codes(tmpr[d], code(thermistor_voltage(sim_battery_get_temperature())), code(VREF));
+        tmpr[d][3] = itmp & 0xFF;
+        tmpr[d][4] = ((itmp >> 8) & 0x0F) | (die_temp >= 145.0 ? 0x10 : 0x00);
+    }
+}
+
+static void diagnose(void)
+{
+    uint16_t ref = code(2.5);
+    for (uint8_t d = 0; d < num_devices; d++)
+    {
+        dgnr[d][0] = ref & 0xFF;
+        dgnr[d][1] = (ref >> 8) & 0x0F;
+    }
+}
+
+static void start_conversion(systime_t duration)
+{
+    conversion_end = chVTGetSystemTimeX() + duration;
+}
+
+// Level polling: SDO low while a conversion is running, high once done
+static uint8_t poll_status(void)
+{
+    return (int32_t)(chVTGetSystemTimeX() - conversion_end) < 0 ? 0x00 : 0xFF;
+}
+
+// The bottom device answers first, the registers of the devices above are
+// shifted down the chain behind it, each one with its own PEC
+static void load_response(const uint8_t *reg, uint8_t len)
+{
+    tx_len = 0;
+    for (uint8_t d = 0; d < num_devices; d++)
+    {
+        const uint8_t *dev_reg = &reg[d * len];
+        for (uint8_t i = 0; i < len; i++)
+            tx_data[tx_len++] = dev_reg[i];
+        tx_data[tx_len++] = pec8(dev_reg, len);
+    }
+}
+
+// Balance switches of the whole stack, bit n for cell n + 1
+static void update_balance(void)
+{
+    uint64_t mask = 0;
+    for (uint8_t d = 0; d < num_devices; d++)
+    {
+        uint64_t dev_mask = cfgr[d][1] | ((cfgr[d][2] & 0x0F) << 8);
+        mask |= dev_mask << (d * CELLS_PER_DEVICE);
+    }
+    sim_battery_set_balance(mask);
+}
+
+// The devices at the top of the stack are written first
+static void write_config(void)
+{
+    for (uint8_t i = 0; i < num_devices; i++)
+    {
+        uint8_t *block = &rx_data[i * (CFG_LEN + 1)];
+        uint8_t d = num_devices - 1 - i;
+        if (pec8(block, CFG_LEN) != block[CFG_LEN])
+            continue;
+        for (uint8_t k = 0; k < CFG_LEN; k++)
+            cfgr[d][k] = block[k];
+    }
+    update_balance();
+}
+
+static void execute(void)
+{
+    tx_len = 0;
+    num_devices = (sim_battery_get_num_cells() + CELLS_PER_DEVICE - 1) / CELLS_PER_DEVICE;
+    if (num_devices < 1)
+        num_devices = 1;
+    switch (cmd)
+    {
+    case CMD_RDCFG:
+        load_response(&cfgr[0][0], CFG_LEN);
+        break;
+    case CMD_RDCV:
+        load_response(&cvr[0][0], CV_LEN);
+        break;
+    case CMD_RDTMP:
+        load_response(&tmpr[0][0], 5);
+        break;
+    case CMD_RDDGNR:
+        load_response(&dgnr[0][0], 2);
+        break;
+    case CMD_STCVAD:
+        convert_cells();
+        start_conversion(CELL_CONVERSION_TIME);
+        break;
+    case CMD_STTMPAD:
+        convert_temps();
+        start_conversion(TEMP_CONVERSION_TIME);
+        break;
+    case CMD_DAGN:
+        diagnose();
+        convert_cells();
+        convert_temps();
+        start_conversion(DIAG_CONVERSION_TIME);
+        break;
+    default:
+        break;
+    }
+}
+
+static void ltc6803_select(SPIDriver *spip)
+{
+    (void)spip;
+    byte_index = 0;
+    cmd_valid = false;
+}
+
+static uint8_t ltc6803_exchange(SPIDriver *spip, uint8_t frame)
+{
+    (void)spip;
+    uint8_t out = 0xFF;
+
+    if (byte_index < 2)
+    {
+        rx_data[byte_index] = frame;
+        if (byte_index == 1 && pec8(rx_data, 1) == frame)
+        {
+            cmd = rx_data[0];
+            cmd_valid = true;
+            execute();
+        }
+    }
+    else if (cmd_valid && cmd == CMD_WRCFG)
+    {
+        uint8_t len = num_devices * (CFG_LEN + 1);
+        if (byte_index - 2 < len)
+            rx_data[byte_index - 2] = frame;
+        if (byte_index == len + 1)
+            write_config();
+    }
+    else if (cmd_valid && cmd == CMD_PLADC)
+    {
+        out = poll_status();
+    }
+    else if (cmd_valid && byte_index - 2 < tx_len)
+    {
+        out = tx_data[byte_index - 2];
+    }
+
+    if (byte_index < 255)
+        byte_index++;
+    return out;
+}
+
+static const SPISimModel ltc6803_model = {
+    ltc6803_select,
+    NULL,
+    ltc6803_exchange
+};
+
+void ltc6803_model_init(void)
+{
+    num_devices = MAX_DEVICES;
+    for (uint8_t d = 0; d < MAX_DEVICES; d++)
+    {
+        cfgr[d][0] = 0x02;
+        for (uint8_t i = 1; i < CFG_LEN; i++)
+            cfgr[d][i] = 0;
+    }
+    convert_cells();
+    convert_temps();
+    diagnose();
+    conversion_end = chVTGetSystemTimeX();
+    spiSimSetModel(&SPID1, &ltc6803_model);
+}
@@ -0,0 +1,58 @@
+#include "sim_models.h"
+#include "hal.h"
+#include "hw_conf.h"
+#include <time.h>
+
+#define I2C_ADDRESS 0x51
+#define NUM_REGS 0x40
+
+#define BCD(x) ((uint8_t)((((x) / 10) << 4) | ((x) % 10)))
+
+static uint8_t regs[NUM_REGS];
+static uint8_t pointer;
+
+// The clock registers follow the host local time
+static void update_time(void)
+{
+    time_t now = time(NULL);
+    struct tm *t = localtime(&now);
+
+    regs[0x01] = BCD(t->tm_sec);
+    regs[0x02] = BCD(t->tm_min);
+    regs[0x03] = BCD(t->tm_hour);
+    regs[0x04] = BCD(t->tm_mday);
+    regs[0x05] = BCD(t->tm_wday);
+    regs[0x06] = BCD(t->tm_mon + 1);
+    regs[0x07] = BCD(t->tm_year % 100);
+}
+
+static msg_t rtcc_transfer(I2CSimDevice *devp, const uint8_t *txbuf, size_t txn,
+                           uint8_t *rxbuf, size_t rxn)
+{
+    (void)devp;
+
+    if (txn >= 1)
+        pointer = txbuf[0];
+    for (size_t i = 1; i < txn; i++)
+        regs[(pointer + i - 1) % NUM_REGS] = txbuf[i];
+
+    if (rxn > 0)
+        update_time();
+    for (size_t i = 0; i < rxn; i++)
+        rxbuf[i] = regs[(pointer + i) % NUM_REGS];
+    return MSG_OK;
+}
+
+static I2CSimDevice rtcc_device = {
+    I2C_ADDRESS,
+    rtcc_transfer,
+    NULL
+};
+
+void rtcc_model_init(void)
+{
+    for (uint8_t i = 0; i < NUM_REGS; i++)
+        regs[i] = 0;
+    pointer = 0;
+    i2cSimAttachDevice(&I2C_DEV, &rtcc_device);
+}
@@ -0,0 +1,212 @@
+#include "sim_battery.h"
+#include "hal.h"
+#include "hw_conf.h"
+
+#define CELL_CAPACITY_AH 2.5
+#define CELL_RESISTANCE 0.02
+#define BALANCE_RESISTANCE 33.0
+#define CHARGER_RESISTANCE 0.1
+#define CHARGER_MAX_CURRENT 10.0
+#define PRECHARGE_TAU 0.02
+#define OUTPUT_DECAY_TAU 1.0
+#define SHORT_RESISTANCE 0.005
+
+// Open circuit voltage of a Li-ion cell, SoC from 0 to 100% by 10% steps
+static const float ocv_table[11] = {
+    3.00, 3.45, 3.55, 3.62, 3.67, 3.72, 3.78, 3.86, 3.95, 4.06, 4.20
+};
+
+static uint8_t num_cells;
+static float soc[SIM_BATTERY_MAX_CELLS];
+static float cell_voltages[SIM_BATTERY_MAX_CELLS];
+static uint64_t balance_mask;
+static float load_current;
+static float current;
+static float charger_voltage;
+static float charger_setpoint;
+static float output_voltage;
+static bool output_short;
+static float temperature;
+static float board_temperature;
+static systime_t last_update;
+
+static float ocv(float s)
+{
+    if (s <= 0.0)
+        return ocv_table[0];
+    if (s >= 1.0)
+        return ocv_table[10];
+    float pos = s * 10.0;
+    int i = (int)pos;
+    return ocv_table[i] + (ocv_table[i + 1] - ocv_table[i]) * (pos - i);
+}
+
+void sim_battery_init(void)
+{
+    num_cells = SIM_BATTERY_DEFAULT_CELLS;
+    for (uint8_t i = 0; i < SIM_BATTERY_MAX_CELLS; i++)
+    {
+        soc[i] = 0.5;
+        cell_voltages[i] = ocv(soc[i]);
+    }
+    balance_mask = 0;
+    load_current = 0.0;
+    current = 0.0;
+    charger_voltage = 0.0;
+    charger_setpoint = 0.0;
+    output_voltage = 0.0;
+    output_short = false;
+    temperature = 25.0;
+    board_temperature = 25.0;
+    last_update = chVTGetSystemTimeX();
+}
+
+// Integrates the pack state up to the current system time, called by the
+// device models before sampling so that the firmware sees a consistent pack
+void sim_battery_update(void)
+{
+    systime_t now = chVTGetSystemTimeX();
+    float dt = (float)(systime_t)(now - last_update) / CH_CFG_ST_FREQUENCY;
+    last_update = now;
+
+    float pack_voltage = 0.0;
+    for (uint8_t i = 0; i < num_cells; i++)
+        pack_voltage += ocv(soc[i]);
+
+    bool discharge = palReadLatch(DSG_SW_GPIO) & PAL_PORT_BIT(DSG_SW_PIN);
+    bool precharge = palReadLatch(PCHG_SW_GPIO) & PAL_PORT_BIT(PCHG_SW_PIN);
+    bool charge = palReadLatch(CHG_SW_GPIO) & PAL_PORT_BIT(CHG_SW_PIN);
+
+    // Output capacitor of the load
+    if (output_short)
+        output_voltage = 0.0;
+    else if (discharge)
+        output_voltage = pack_voltage;
+    else if (precharge)
+        output_voltage += (pack_voltage - output_voltage) * (dt >= PRECHARGE_TAU ? 1.0 : dt / PRECHARGE_TAU);
+    else
+        output_voltage -= output_voltage * (dt >= OUTPUT_DECAY_TAU ? 1.0 : dt / OUTPUT_DECAY_TAU);
+
+    // Constant voltage source behind a resistance, current limited
+    float charge_current = 0.0;
+    if (charge && charger_voltage > 6.0)
+    {
+        charge_current = (charger_setpoint - pack_voltage) / CHARGER_RESISTANCE;
+        if (charge_current < 0.0)
+            charge_current = 0.0;
+        else if (charge_current > CHARGER_MAX_CURRENT)
+            charge_current = CHARGER_MAX_CURRENT;
+    }
+
+    float discharge_current = load_current;
+    if (output_short)
+        discharge_current = pack_voltage / (num_cells * CELL_RESISTANCE + SHORT_RESISTANCE);
+    current = (discharge ? discharge_current : 0.0) - charge_current;
+
+    for (uint8_t i = 0; i < num_cells; i++)
+    {
+        float cell_current = current;
+        if (balance_mask & ((uint64_t)1 << i))
+            cell_current += ocv(soc[i]) / BALANCE_RESISTANCE;
+        soc[i] -= cell_current * dt / (CELL_CAPACITY_AH * 3600.0);
+        if (soc[i] < 0.0)
+            soc[i] = 0.0;
+        else if (soc[i] > 1.0)
+            soc[i] = 1.0;
+        cell_voltages[i] = ocv(soc[i]) - current * CELL_RESISTANCE;
+    }
+}
+
+uint8_t sim_battery_get_num_cells(void)
+{
+    return num_cells;
+}
+
+void sim_battery_set_num_cells(uint8_t num)
+{
+    if (num > SIM_BATTERY_MAX_CELLS)
+        num = SIM_BATTERY_MAX_CELLS;
+    num_cells = num;
+}
+
+float sim_battery_get_cell_voltage(uint8_t cell)
+{
+    if (cell >= num_cells)
+        return 0.0;
+    return cell_voltages[cell];
+}
+
+void sim_battery_set_cell_soc(uint8_t cell, float s)
+{
+    if (cell < SIM_BATTERY_MAX_CELLS)
+        soc[cell] = s;
+}
+
+float sim_battery_get_pack_voltage(void)
+{
+    float voltage = 0.0;
+    for (uint8_t i = 0; i < num_cells; i++)
+        voltage += cell_voltages[i];
+    return voltage;
+}
+
+float sim_battery_get_current(void)
+{
+    return current;
+}
+
+void sim_battery_set_load_current(float c)
+{
+    load_current = c;
+}
+
+void sim_battery_set_charger_voltage(float voltage)
+{
+    charger_voltage = voltage;
+}
+
+float sim_battery_get_charger_voltage(void)
+{
+    return charger_voltage;
+}
+
+void sim_battery_set_charger_setpoint(float voltage)
+{
+    charger_setpoint = voltage;
+}
+
+float sim_battery_get_output_voltage(void)
+{
+    return output_voltage;
+}
+
+// Short circuit on the output of the pack, after the discharge switch
+void sim_battery_set_output_short(bool shorted)
+{
+    output_short = shorted;
+}
+
+void sim_battery_set_balance(uint64_t mask)
+{
+    balance_mask = mask;
+}
+
+void sim_battery_set_temperature(float temp)
+{
+    temperature = temp;
+}
+
+float sim_battery_get_temperature(void)
+{
+    return temperature;
+}
+
+void sim_battery_set_board_temperature(float temp)
+{
+    board_temperature = temp;
+}
+
+float sim_battery_get_board_temperature(void)
+{
+    return board_temperature;
+}
@@ -0,0 +1,29 @@
+#ifndef _SIM_BATTERY_H_
+#define _SIM_BATTERY_H_
+
+#include "ch.h"
+
+#define SIM_BATTERY_MAX_CELLS 36 // Three daisy chained LTC6803
+#define SIM_BATTERY_DEFAULT_CELLS 12
+
+void sim_battery_init(void);
+void sim_battery_update(void);
+uint8_t sim_battery_get_num_cells(void);
+void sim_battery_set_num_cells(uint8_t num);
+float sim_battery_get_cell_voltage(uint8_t cell);
+void sim_battery_set_cell_soc(uint8_t cell, float soc);
+float sim_battery_get_pack_voltage(void);
+float sim_battery_get_current(void);
+void sim_battery_set_load_current(float current);
+void sim_battery_set_charger_voltage(float voltage);
+float sim_battery_get_charger_voltage(void);
+void sim_battery_set_charger_setpoint(float voltage);
+float sim_battery_get_output_voltage(void);
+void sim_battery_set_output_short(bool shorted);
+void sim_battery_set_balance(uint64_t mask);
+void sim_battery_set_temperature(float temp);
+float sim_battery_get_temperature(void);
+void sim_battery_set_board_temperature(float temp);
+float sim_battery_get_board_temperature(void);
+
+#endif /* _SIM_BATTERY_H_ */
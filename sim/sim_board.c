@@ -0,0 +1,24 @@
+#include "sim_models.h"
+#include "sim_battery.h"
+
+// Called by boardInit(), the drivers are initialized but not started yet
+void sim_board_init(void)
+{
+    sim_battery_init();
+    ltc6803_model_init();
+    isl28022_model_init();
+    dac_model_init();
+    rtcc_model_init();
+    analog_model_init();
+    can_model_init();
+}
+
+// Drives an input line as seen by the firmware, the EXT driver picks up
+// the edges on its next check
+void sim_set_input(ioportid_t port, uint8_t pad, bool level)
+{
+    if (level)
+        port->pin |= PAL_PORT_BIT(pad);
+    else
+        port->pin &= ~PAL_PORT_BIT(pad);
+}
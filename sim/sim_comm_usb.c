@@ -0,0 +1,88 @@
+#include "hal.h"
+#include "packet.h"
+#include "comm_usb.h"
+#include "sim_models.h"
+
+// The USB virtual serial port is replaced by the first simulated serial
+// port, a TCP socket on port 29001 carrying the same packet stream.
+
+#define SERIAL_RX_BUFFER_SIZE		(2048)
+static uint8_t serial_rx_buffer[SERIAL_RX_BUFFER_SIZE];
+static int serial_rx_read_pos = 0;
+static int serial_rx_write_pos = 0;
+static THD_WORKING_AREA(serial_read_thread_wa, 1024);
+static THD_WORKING_AREA(serial_process_thread_wa, 4096);
+static mutex_t send_mutex;
+static thread_t *process_tp;
+
+static THD_FUNCTION(serial_read_thread, arg) {
+    (void)arg;
+
+    chRegSetThreadName("Sim serial read");
+
+    uint8_t buffer[128];
+    size_t len;
+
+    for(;;) {
+        len = chnReadTimeout(&SD1, buffer, sizeof(buffer), MS2ST(1));
+
+        for (size_t i = 0; i < len; i++) {
+            serial_rx_buffer[serial_rx_write_pos++] = buffer[i];
+
+            if (serial_rx_write_pos == SERIAL_RX_BUFFER_SIZE) {
+                serial_rx_write_pos = 0;
+            }
+        }
+
+        if (len > 0) {
+            chEvtSignal(process_tp, (eventmask_t) 1);
+        }
+        else {
+            chThdSleepMilliseconds(1);
+        }
+    }
+}
+
+static THD_FUNCTION(serial_process_thread, arg) {
+    (void)arg;
+
+    chRegSetThreadName("Sim serial process");
+
+    process_tp = chThdGetSelfX();
+
+    for(;;) {
+        chEvtWaitAny((eventmask_t) 1);
+
+        while (serial_rx_read_pos != serial_rx_write_pos) {
+            packet_process_byte(serial_rx_buffer[serial_rx_read_pos++]);
+
+            if (serial_rx_read_pos == SERIAL_RX_BUFFER_SIZE) {
+                serial_rx_read_pos = 0;
+            }
+        }
+    }
+}
+
+void comm_usb_init(void)
+{
+    sdStart(&SD1, NULL);
+    chMtxObjectInit(&send_mutex);
+    chThdCreateStatic(serial_process_thread_wa, sizeof(serial_process_thread_wa), NORMALPRIO, serial_process_thread, NULL);
+    chThdCreateStatic(serial_read_thread_wa, sizeof(serial_read_thread_wa), NORMALPRIO, serial_read_thread, NULL);
+    sim_control_init();
+}
+
+void comm_usb_deinit(void)
+{
+    sdStop(&SD1);
+}
+
+void comm_usb_send(unsigned char *buffer, unsigned int len) {
+    chMtxLock(&send_mutex);
+    chnWrite(&SD1, buffer, len);
+    chMtxUnlock(&send_mutex);
+}
+
+int comm_usb_is_active(void) {
+    return sdSimIsConnected(&SD1);
+}
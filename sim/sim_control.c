@@ -0,0 +1,176 @@
+#include "sim_models.h"
+#include "sim_battery.h"
+#include "hw_conf.h"
+#include "fast_trip.h"
+#include "chprintf.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Simulator control port, a line based text protocol on the second
+// simulated serial port (TCP 29002) to drive the pack and the inputs
+// while the firmware is running.
+
+#define LINE_LEN 128
+#define MAX_ARGS 10
+#define SHORT_TIMEOUT_MS 100
+
+static THD_WORKING_AREA(sim_control_thread_wa, 4096);
+static BaseSequentialStream *chp = (BaseSequentialStream*)&SD2;
+
+static void print_status(void)
+{
+    chSysLock();
+    sim_battery_update();
+    chSysUnlock();
+    chprintf(chp, "Pack voltage: %.3fV\r\n", sim_battery_get_pack_voltage());
+    chprintf(chp, "Output voltage: %.3fV\r\n", sim_battery_get_output_voltage());
+    chprintf(chp, "Current: %.3fA\r\n", sim_battery_get_current());
+    chprintf(chp, "Charger input: %.2fV\r\n", sim_battery_get_charger_voltage());
+    for (uint8_t i = 0; i < sim_battery_get_num_cells(); i++)
+        chprintf(chp, "Cell %d: %.4fV\r\n", i + 1, sim_battery_get_cell_voltage(i));
+}
+
+// Shorts the output and waits for the fast trip, the time from the short to
+// the detection depends on the simulated ADC which converts once per tick
+static void short_output(void)
+{
+    uint32_t count = fast_trip_get_count();
+    rtcnt_t start = chSysGetRealtimeCounterX();
+    sim_battery_set_output_short(true);
+
+    FastTripEvent e;
+    for (int i = 0; i < SHORT_TIMEOUT_MS; i++)
+    {
+        if (fast_trip_get_event(count, &e))
+        {
+            chprintf(chp, "Tripped by %s, detected in %dus, DSG_SW write took %dns\r\n",
+                     e.source == FAST_TRIP_OUTPUT_SHORT ? "output short" : "current alert",
+                     (rtcnt_t)(e.callbackTime - start), fast_trip_switch_ns(&e));
+            return;
+        }
+        chThdSleepMilliseconds(1);
+    }
+    chprintf(chp, "No fast trip within %dms\r\n", SHORT_TIMEOUT_MS);
+}
+
+static void process_command(int argc, char **argv)
+{
+    if (argc == 0)
+        return;
+
+    if (strcmp(argv[0], "help") == 0)
+    {
+        chprintf(chp, "load <A>, charger <V>, soc <cell|all> <0..1>, cells <n>\r\n");
+        chprintf(chp, "temp <C>, boardtemp <C>, button <0|1>, usb <0|1>\r\n");
+        chprintf(chp, "short <0|1>\r\n");
+        chprintf(chp, "can <eid> [bytes...], status\r\n");
+    }
+    else if (strcmp(argv[0], "load") == 0 && argc == 2)
+    {
+        sim_battery_set_load_current(strtof(argv[1], NULL));
+    }
+    else if (strcmp(argv[0], "charger") == 0 && argc == 2)
+    {
+        sim_battery_set_charger_voltage(strtof(argv[1], NULL));
+    }
+    else if (strcmp(argv[0], "soc") == 0 && argc == 3)
+    {
+        float soc = strtof(argv[2], NULL);
+        chSysLock();
+        if (strcmp(argv[1], "all") == 0)
+        {
+            for (uint8_t i = 0; i < SIM_BATTERY_MAX_CELLS; i++)
+                sim_battery_set_cell_soc(i, soc);
+        }
+        else
+        {
+            sim_battery_set_cell_soc(atoi(argv[1]) - 1, soc);
+        }
+        chSysUnlock();
+    }
+    else if (strcmp(argv[0], "cells") == 0 && argc == 2)
+    {
+        sim_battery_set_num_cells(atoi(argv[1]));
+    }
+    else if (strcmp(argv[0], "temp") == 0 && argc == 2)
+    {
+        sim_battery_set_temperature(strtof(argv[1], NULL));
+    }
+    else if (strcmp(argv[0], "boardtemp") == 0 && argc == 2)
+    {
+        sim_battery_set_board_temperature(strtof(argv[1], NULL));
+    }
+    else if (strcmp(argv[0], "button") == 0 && argc == 2)
+    {
+        // The power switch input is active low
+        sim_set_input(PWR_BTN_GPIO, PWR_BTN_PIN, atoi(argv[1]) == 0);
+    }
+    else if (strcmp(argv[0], "short") == 0 && argc == 2)
+    {
+        if (atoi(argv[1]) != 0)
+            short_output();
+        else
+            sim_battery_set_output_short(false);
+    }
+    else if (strcmp(argv[0], "usb") == 0 && argc == 2)
+    {
+        sim_set_input(USB_DETECT_GPIO, USB_DETECT_PIN, atoi(argv[1]) != 0);
+    }
+    else if (strcmp(argv[0], "can") == 0 && argc >= 2)
+    {
+        uint8_t data[8];
+        uint8_t len = 0;
+        for (int i = 2; i < argc && len < 8; i++)
+            data[len++] = strtoul(argv[i], NULL, 16);
+        if (!can_model_inject(strtoul(argv[1], NULL, 16), data, len))
+            chprintf(chp, "CAN receive FIFO full\r\n");
+    }
+    else if (strcmp(argv[0], "status") == 0)
+    {
+        print_status();
+    }
+    else
+    {
+        chprintf(chp, "Unknown command, type help\r\n");
+    }
+}
+
+static THD_FUNCTION(sim_control_thread, arg) {
+    (void)arg;
+
+    chRegSetThreadName("Sim control");
+
+    char line[LINE_LEN];
+    int len = 0;
+
+    for(;;)
+    {
+        msg_t c = chnGetTimeout(&SD2, TIME_INFINITE);
+        if (c < 0)
+            continue;
+        if (c == '\r' || c == '\n')
+        {
+            char *argv[MAX_ARGS];
+            int argc = 0;
+            line[len] = '\0';
+            char *tok = strtok(line, " \t");
+            while (tok != NULL && argc < MAX_ARGS)
+            {
+                argv[argc++] = tok;
+                tok = strtok(NULL, " \t");
+            }
+            process_command(argc, argv);
+            len = 0;
+        }
+        else if (len < LINE_LEN - 1)
+        {
+            line[len++] = (char)c;
+        }
+    }
+}
+
+void sim_control_init(void)
+{
+    sdStart(&SD2, NULL);
+    chThdCreateStatic(sim_control_thread_wa, sizeof(sim_control_thread_wa), NORMALPRIO, sim_control_thread, NULL);
+}
@@ -0,0 +1,109 @@
+#include "eeprom.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// EEPROM emulation replacement, the variables are kept in a table that is
+// saved to a file on each write so that the configuration survives a
+// restart of the simulator. The file defaults to battman_eeprom.bin in the
+// working directory and can be changed with BATTMAN_SIM_EEPROM.
+
+typedef struct
+{
+    uint16_t address;
+    uint16_t data;
+} Variable;
+
+static Variable variables[NB_OF_VAR];
+static uint16_t num_variables;
+
+static const char *file_name(void)
+{
+    const char *name = getenv("BATTMAN_SIM_EEPROM");
+    return name != NULL ? name : "battman_eeprom.bin";
+}
+
+static void save(void)
+{
+    FILE *f = fopen(file_name(), "wb");
+    if (f == NULL)
+        return;
+    fwrite(variables, sizeof(Variable), num_variables, f);
+    fclose(f);
+}
+
+uint16_t EE_Init(void)
+{
+    FILE *f = fopen(file_name(), "rb");
+    num_variables = 0;
+    if (f == NULL)
+        return FLASH_COMPLETE;
+    num_variables = fread(variables, sizeof(Variable), NB_OF_VAR, f);
+    fclose(f);
+    return FLASH_COMPLETE;
+}
+
+uint16_t EE_ReadVariable(uint16_t VirtAddress, uint16_t* Data)
+{
+    for (uint16_t i = 0; i < num_variables; i++)
+    {
+        if (variables[i].address == VirtAddress)
+        {
+            *Data = variables[i].data;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data)
+{
+    uint16_t i;
+    for (i = 0; i < num_variables; i++)
+    {
+        if (variables[i].address == VirtAddress)
+            break;
+    }
+    if (i == num_variables)
+    {
+        if (num_variables == NB_OF_VAR)
+            return PAGE_FULL;
+        num_variables++;
+    }
+    variables[i].address = VirtAddress;
+    variables[i].data = Data;
+    save();
+    return FLASH_COMPLETE;
+}
+
+void FLASH_Unlock(void)
+{
+}
+
+void FLASH_Lock(void)
+{
+}
+
+void FLASH_ClearFlag(uint32_t FLASH_FLAG)
+{
+    (void)FLASH_FLAG;
+}
+
+FLASH_Status FLASH_ErasePage(uint32_t Page_Address)
+{
+    (void)Page_Address;
+    return FLASH_COMPLETE;
+}
+
+FLASH_Status FLASH_ProgramWord(uint32_t Address, uint32_t Data)
+{
+    (void)Address;
+    (void)Data;
+    return FLASH_COMPLETE;
+}
+
+FLASH_Status FLASH_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+    (void)Address;
+    (void)Data;
+    return FLASH_COMPLETE;
+}
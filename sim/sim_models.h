@@ -0,0 +1,18 @@
+#ifndef _SIM_MODELS_H_
+#define _SIM_MODELS_H_
+
+#include "ch.h"
+#include "hal.h"
+
+void ltc6803_model_init(void);
+void isl28022_model_init(void);
+void dac_model_init(void);
+void rtcc_model_init(void);
+void analog_model_init(void);
+void can_model_init(void);
+bool can_model_inject(uint32_t eid, const uint8_t *data, uint8_t len);
+
+void sim_set_input(ioportid_t port, uint8_t pad, bool level);
+void sim_control_init(void);
+
+#endif /* _SIM_MODELS_H_ */
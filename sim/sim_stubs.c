@@ -0,0 +1,76 @@
+#include "ch.h"
+#include "buzzer.h"
+#include "ws2812b.h"
+#include "fw_updater.h"
+#include "stm32f30x_conf.h"
+#include <stdlib.h>
+
+// Replacements for the modules driving the STM32 peripherals directly
+// through the standard peripheral library or the core registers.
+
+void buzzer_init(void)
+{
+}
+
+void buzzer_play_note(note_t note, uint16_t duration)
+{
+    (void)note;
+    chThdSleepMilliseconds(duration);
+}
+
+void buzzer_play_rest(uint16_t duration)
+{
+    chThdSleepMilliseconds(duration);
+}
+
+void buzzer_set_frequency(float freq)
+{
+    (void)freq;
+}
+
+static uint32_t led_colors[1];
+
+void ws2812b_init(void)
+{
+    led_colors[0] = 0;
+}
+
+void ws2812b_set_led_color(int led, uint32_t color)
+{
+    if (led == 0)
+        led_colors[0] = color;
+}
+
+uint32_t ws2812b_get_led_color(int led)
+{
+    return led == 0 ? led_colors[0] : 0;
+}
+
+void ws2812b_all_off(void)
+{
+    led_colors[0] = 0;
+}
+
+void ws2812b_set_all(uint32_t color)
+{
+    led_colors[0] = color;
+}
+
+uint16_t fw_updater_write_firmware(uint32_t offset, uint8_t *data, uint32_t len)
+{
+    (void)offset;
+    (void)data;
+    (void)len;
+    return FLASH_COMPLETE;
+}
+
+uint16_t fw_updater_erase_new_firmware(void)
+{
+    return FLASH_COMPLETE;
+}
+
+// There is no bootloader to jump to, the simulator just terminates
+void fw_updater_jump_bootloader(void)
+{
+    exit(0);
+}
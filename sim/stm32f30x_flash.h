@@ -0,0 +1,30 @@
+#ifndef _SIM_STM32F30X_FLASH_H_
+#define _SIM_STM32F30X_FLASH_H_
+
+#include <stdint.h>
+
+// Subset of the standard peripheral library flash API used by the
+// firmware, backed by sim_eeprom.c
+
+typedef enum
+{
+    FLASH_BUSY = 1,
+    FLASH_ERROR_WRP,
+    FLASH_ERROR_PROGRAM,
+    FLASH_COMPLETE,
+    FLASH_TIMEOUT
+} FLASH_Status;
+
+#define FLASH_FLAG_BSY      ((uint32_t)0x00000001)
+#define FLASH_FLAG_PGERR    ((uint32_t)0x00000004)
+#define FLASH_FLAG_WRPERR   ((uint32_t)0x00000010)
+#define FLASH_FLAG_EOP      ((uint32_t)0x00000020)
+
+void FLASH_Unlock(void);
+void FLASH_Lock(void);
+void FLASH_ClearFlag(uint32_t FLASH_FLAG);
+FLASH_Status FLASH_ErasePage(uint32_t Page_Address);
+FLASH_Status FLASH_ProgramWord(uint32_t Address, uint32_t Data);
+FLASH_Status FLASH_ProgramHalfWord(uint32_t Address, uint16_t Data);
+
+#endif /* _SIM_STM32F30X_FLASH_H_ */
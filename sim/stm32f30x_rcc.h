@@ -0,0 +1,7 @@
+#ifndef _SIM_STM32F30X_RCC_H_
+#define _SIM_STM32F30X_RCC_H_
+
+// Not used by the simulator build, the modules driving this peripheral
+// are replaced by sim_stubs.c
+
+#endif /* _SIM_STM32F30X_RCC_H_ */
@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Measures the fast trip on the simulator: starts build/sim/battman,
+# waits for the output to be switched on under load, shorts it and reads
+# the time from the short to the trip callback and the time the callback
+# took to write DSG_SW, as printed by the "short" command of the control
+# port. A trip is one run of the simulator, the fault latches until a
+# restart. Fails when a short is not detected within MAX_DETECT_US.
+#
+# Usage, from the repository root after "make sim": sim/tests/fast_trip.sh [runs]
+#
+
+RUNS=${1:-5}
+SIM=build/sim/battman
+PORT=29002
+MAX_DETECT_US=1000 # The simulated ADC converts once per system tick
+TURN_ON_S=2 # turnOnDelay, precharge and margin
+
+if [ ! -x "$SIM" ]; then
+    echo "fast_trip: $SIM not found, run make sim first"
+    exit 1
+fi
+
+failures=0
+for run in $(seq 1 "$RUNS"); do
+    "$SIM" > /dev/null 2>&1 &
+    pid=$!
+    connected=0
+    for i in $(seq 1 50); do
+        { exec 3<> /dev/tcp/localhost/$PORT; } 2> /dev/null && connected=1 && break
+        sleep 0.1
+    done
+    if [ $connected -eq 0 ]; then
+        kill $pid 2> /dev/null
+        echo "fast_trip: run $run: no control port"
+        failures=$((failures + 1))
+        continue
+    fi
+
+    # The power button is held at start up, the output turns on
+    printf "load 5\n" >&3
+    sleep $TURN_ON_S
+    printf "button 0\n" >&3
+    printf "short 1\n" >&3
+    result=""
+    while read -r -t 2 line <&3; do
+        line=${line%$'\r'}
+        case "$line" in
+            Tripped*|No\ fast\ trip*) result=$line; break ;;
+        esac
+    done
+    exec 3>&-
+    kill $pid 2> /dev/null
+    wait $pid 2> /dev/null
+
+    echo "fast_trip: run $run: ${result:-no answer}"
+    detect=$(echo "$result" | sed -n 's/.*detected in \([0-9]*\)us.*/\1/p')
+    if [ -z "$detect" ] || [ "$detect" -gt $MAX_DETECT_US ]; then
+        failures=$((failures + 1))
+    fi
+done
+
+if [ $failures -gt 0 ]; then
+    echo "fast_trip: FAILED, $failures of $RUNS shorts not detected within ${MAX_DETECT_US}us"
+    exit 1
+fi
+echo "fast_trip: $RUNS shorts detected within ${MAX_DETECT_US}us"
@@ -0,0 +1,20 @@
+#ifndef _CH_H_
+#define _CH_H_
+
+// Host stand-in for the ChibiOS kernel header, enough for the modules
+// tested in sim/tests
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sched.h>
+
+typedef uint32_t systime_t;
+
+// The threads are POSIX threads, a reader waiting for a writer yields
+static inline void chThdSleep(systime_t time)
+{
+    (void)time;
+    sched_yield();
+}
+
+#endif /* _CH_H_ */
@@ -0,0 +1,55 @@
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include "ch.h"
+
+// Host stand-in for the HAL header. With __ARM_FEATURE_SIMD32 defined, the
+// Cortex-M4 SIMD intrinsics used by cell_kernels.c are emulated after their
+// definition in the ARMv7-M Architecture Reference Manual, the GE flags
+// included.
+#if defined(__ARM_FEATURE_SIMD32)
+static uint8_t sim_ge; // GE[3:0], two bits per halfword
+
+static inline uint32_t __UQSUB16(uint32_t a, uint32_t b)
+{
+    uint32_t lo = (a & 0xFFFF) > (b & 0xFFFF) ? (a & 0xFFFF) - (b & 0xFFFF) : 0;
+    uint32_t hi = (a >> 16) > (b >> 16) ? (a >> 16) - (b >> 16) : 0;
+    return lo | (hi << 16);
+}
+
+static inline uint32_t __UADD16(uint32_t a, uint32_t b)
+{
+    uint32_t lo = (a & 0xFFFF) + (b & 0xFFFF);
+    uint32_t hi = (a >> 16) + (b >> 16);
+    sim_ge = (lo > 0xFFFF ? 0x3 : 0) | (hi > 0xFFFF ? 0xC : 0);
+    return (lo & 0xFFFF) | (hi << 16);
+}
+
+static inline uint32_t __USUB16(uint32_t a, uint32_t b)
+{
+    uint32_t lo = (a & 0xFFFF) - (b & 0xFFFF);
+    uint32_t hi = (a >> 16) - (b >> 16);
+    sim_ge = ((a & 0xFFFF) >= (b & 0xFFFF) ? 0x3 : 0) | ((a >> 16) >= (b >> 16) ? 0xC : 0);
+    return (lo & 0xFFFF) | (hi << 16);
+}
+
+static inline uint32_t __SEL(uint32_t a, uint32_t b)
+{
+    uint32_t result = 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        uint32_t mask = 0xFFu << (8 * i);
+        result |= (sim_ge & (1 << i) ? a : b) & mask;
+    }
+    return result;
+}
+
+static inline uint32_t __SMLAD(uint32_t x, uint32_t y, uint32_t acc)
+{
+    int32_t lo = (int16_t)(x & 0xFFFF) * (int16_t)(y & 0xFFFF);
+    int32_t hi = (int16_t)(x >> 16) * (int16_t)(y >> 16);
+    return acc + (uint32_t)lo + (uint32_t)hi;
+}
+#endif
+
+#endif /* _HAL_H_ */
@@ -0,0 +1,191 @@
+#include "balance.h"
+#include "soc_ekf.h"
+#include "hw_conf.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Charges a 12S pack model from 80% with a 4.4% SoC spread, once with the
+// balancing planner of balance.c as the charger runs it and once with the
+// strategy it replaced, which paused the charge every 500ms while the
+// cells differed and bled every cell above the lowest. The charger gives
+// chargeCurrent until the highest cell is full. The die of the LTC6803
+// heats by DIE_RISE per channel bleeding with a DIE_TIME time constant.
+// Prints the time until every cell is full and the hottest die, and fails
+// if the planner is not faster or lets the die run away.
+
+#define NUM_CELLS 12
+#define CAPACITY 2500.0 // mAh, the default packCapacity
+#define CHARGE_CURRENT 2.0 // A, the default chargeCurrent
+#define THRESHOLD 0.01 // V, the default balanceDifferenceThreshold
+#define START_SOC 0.80
+#define SPREAD 0.044
+#define FULL_SOC 0.99 // Of every cell to be done
+#define DT 0.1 // s, charger_update period
+#define OLD_PERIOD 5 // Updates, 500ms
+#define DIE_RISE 15.0 // degree C per channel
+#define DIE_TIME 20.0 // s
+#define AMBIENT 25.0 // degree C
+#define MAX_TIME (10 * 3600.0) // s
+
+typedef struct
+{
+    float soc[NUM_CELLS];
+    float dieTemp;
+    float maxDieTemp;
+} Pack;
+
+static void pack_init(Pack *pack)
+{
+    srand(1);
+    for (uint8_t i = 0; i < NUM_CELLS; i++)
+        pack->soc[i] = START_SOC + SPREAD * (i == 0 ? 1.0 : (rand() % 1000) / 1000.0);
+    pack->dieTemp = AMBIENT;
+    pack->maxDieTemp = AMBIENT;
+}
+
+static float pack_ocv(const Pack *pack, uint8_t cell)
+{
+    float slope;
+    return soc_ekf_ocv(pack->soc[cell], &slope);
+}
+
+// Charges with current and bleeds the cells of mask for DT
+static void pack_step(Pack *pack, float current, uint64_t mask)
+{
+    uint8_t channels = 0;
+    for (uint8_t i = 0; i < NUM_CELLS; i++)
+    {
+        float bleed = 0.0;
+        if (mask & ((uint64_t)1 << i))
+        {
+            bleed = pack_ocv(pack, i) / BALANCE_RESISTANCE;
+            channels++;
+        }
+        pack->soc[i] += (current - bleed) * DT / 3.6 / CAPACITY;
+        if (pack->soc[i] > 1.0)
+            pack->soc[i] = 1.0;
+    }
+    pack->dieTemp += (AMBIENT + DIE_RISE * channels - pack->dieTemp) * DT / DIE_TIME;
+    if (pack->dieTemp > pack->maxDieTemp)
+        pack->maxDieTemp = pack->dieTemp;
+}
+
+static bool pack_full(const Pack *pack, float *maxSoc, float *minOcv, float *maxOcv)
+{
+    bool full = true;
+    *maxSoc = 0.0;
+    *minOcv = 10.0;
+    *maxOcv = 0.0;
+    for (uint8_t i = 0; i < NUM_CELLS; i++)
+    {
+        float ocv = pack_ocv(pack, i);
+        if (pack->soc[i] < FULL_SOC)
+            full = false;
+        if (pack->soc[i] > *maxSoc)
+            *maxSoc = pack->soc[i];
+        if (ocv < *minOcv)
+            *minOcv = ocv;
+        if (ocv > *maxOcv)
+            *maxOcv = ocv;
+    }
+    return full;
+}
+
+// s until every cell is full
+static float charge_planner(Pack *pack)
+{
+    BalancePlan plan;
+    bool balancing = false;
+    float maxSoc, minOcv, maxOcv;
+
+    balance_init(&plan);
+    for (float t = 0.0; t < MAX_TIME; t += DT)
+    {
+        if (pack_full(pack, &maxSoc, &minOcv, &maxOcv))
+            return t;
+
+        // As charger_balance, from the OCV of the cells
+        float excess[NUM_CELLS];
+        float voltage[NUM_CELLS];
+        float minSoc = soc_ekf_from_ocv(minOcv);
+        bool needed = false;
+        if (!balancing && maxOcv - minOcv > THRESHOLD)
+        {
+            balancing = true;
+            balance_init(&plan);
+        }
+        for (uint8_t i = 0; i < NUM_CELLS; i++)
+        {
+            voltage[i] = pack_ocv(pack, i);
+            excess[i] = 0.0;
+            if (voltage[i] - minOcv > THRESHOLD / 2.0)
+            {
+                excess[i] = (soc_ekf_from_ocv(voltage[i]) - minSoc) * CAPACITY;
+                needed = true;
+            }
+        }
+        uint64_t mask = 0;
+        if (balancing && needed)
+        {
+            balance_thermal(&plan, 0, pack->dieTemp, BALANCE_DIE_TEMP, DT);
+            balance_plan(&plan, excess, voltage, NUM_CELLS, BALANCE_RESISTANCE, BALANCE_MAX_POWER,
+                    BALANCE_MAX_CHANNELS);
+            mask = balance_next(&plan);
+        }
+        else
+            balancing = false;
+
+        pack_step(pack, maxSoc < 1.0 ? CHARGE_CURRENT : 0.0, mask);
+    }
+    return -1.0;
+}
+
+// s until every cell is full with the 500ms pause and bleed strategy
+static float charge_old(Pack *pack)
+{
+    uint64_t mask = 0;
+    bool charging = true;
+    float maxSoc, minOcv, maxOcv;
+    uint32_t n = 0;
+
+    for (float t = 0.0; t < MAX_TIME; t += DT, n++)
+    {
+        if (pack_full(pack, &maxSoc, &minOcv, &maxOcv))
+            return t;
+        if (n % OLD_PERIOD == 0)
+        {
+            mask = 0;
+            charging = maxOcv - minOcv <= THRESHOLD;
+            for (uint8_t i = 0; i < NUM_CELLS && !charging; i++)
+            {
+                if (pack_ocv(pack, i) - minOcv > THRESHOLD / 2.0)
+                    mask |= (uint64_t)1 << i;
+            }
+        }
+        pack_step(pack, charging && maxSoc < 1.0 ? CHARGE_CURRENT : 0.0, mask);
+    }
+    return -1.0;
+}
+
+int main(void)
+{
+    Pack pack;
+
+    pack_init(&pack);
+    float planner = charge_planner(&pack);
+    float plannerDie = pack.maxDieTemp;
+    pack_init(&pack);
+    float old = charge_old(&pack);
+    float oldDie = pack.maxDieTemp;
+
+    printf("balance: full in %.0f min with the planner, die up to %.1f degree C\n", planner / 60.0, plannerDie);
+    printf("balance: full in %.0f min pausing the charge, die up to %.1f degree C\n", old / 60.0, oldDie);
+    if (planner < 0.0 || (old >= 0.0 && planner >= old) ||
+            plannerDie > BALANCE_DIE_TEMP + 5.0)
+    {
+        printf("balance: FAILED\n");
+        return 1;
+    }
+    return 0;
+}
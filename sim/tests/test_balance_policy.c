@@ -0,0 +1,197 @@
+#include "balance.h"
+#include "soc_ekf.h"
+#include "hw_conf.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Cycles a 12S pack model once a day for 60 days, each cell with its own
+// capacity and self-discharge rate around the nominal ones, under the
+// balancing policies of balance_mode with the default thresholds. The pack
+// charges until its highest cell is full, rests, discharges under a light
+// load down to DEPTH and rests until the next day. Prints the spread of
+// the cells at the end of the last charge, the one that costs capacity,
+// and fails if top balancing does not hold it or the default policies do
+// worse than none.
+
+#define NUM_CELLS 12
+#define DAYS 60
+#define CAPACITY 2500.0 // mAh
+#define SELF_DISCHARGE 0.001 // Of the charge per day
+#define SELF_DISCHARGE_SPREAD 0.5 // Of the self-discharge rate
+#define SPREAD 0.03 // Of the capacity
+#define CHARGE_CURRENT 2.0 // A
+#define LOAD_CURRENT 3.0 // A, under balanceDischargeCurrent
+#define DEPTH 0.3 // SoC of the lowest cell that ends the discharge
+#define REST 3600.0 // s, after the charge
+#define DT 10.0 // s, one balancing slot
+#define DAY 86400.0 // s
+// SoC, topDifference is 0.7% near full and the capacity differences move
+// the cells apart again while charging
+#define MAX_TOP_SPREAD 0.015
+
+typedef enum
+{
+    PHASE_CHARGE,
+    PHASE_REST,
+    PHASE_DISCHARGE,
+    PHASE_IDLE
+} Phase;
+
+typedef struct
+{
+    float capacity[NUM_CELLS];      // mAh
+    float selfDischarge[NUM_CELLS]; // Per s
+    float soc[NUM_CELLS];
+} Pack;
+
+static void pack_init(Pack *pack)
+{
+    srand(1);
+    for (uint8_t i = 0; i < NUM_CELLS; i++)
+    {
+        pack->capacity[i] = CAPACITY * (1.0 + SPREAD * (2.0 * (rand() % 1000) / 1000.0 - 1.0));
+        pack->selfDischarge[i] = SELF_DISCHARGE / DAY * (1.0 + SELF_DISCHARGE_SPREAD * (2.0 * (rand() % 1000) / 1000.0 - 1.0));
+        pack->soc[i] = 0.5;
+    }
+}
+
+static float pack_ocv(const Pack *pack, uint8_t cell)
+{
+    float slope;
+    return soc_ekf_ocv(pack->soc[cell], &slope);
+}
+
+// SoC spread of the pack at the end of the last charge
+static float pack_cycle(Pack *pack, uint8_t modes)
+{
+    BalancePolicy policy = {
+        .modes = modes,
+        .drain = false,
+        .lowVoltage = 3.2, // The defaults of the configuration
+        .startVoltage = 3.5,
+        .bottomVoltage = 3.6,
+        .restCurrent = 0.5,
+        .dischargeCurrent = 5.0,
+        .topDifference = 0.01,
+        .bottomDifference = 0.02,
+        .dischargeDifference = 0.02
+    };
+    BalancePlan plan;
+    BalanceMode balanceMode = BALANCE_MODE_NONE;
+    bool balancing = false;
+    Phase phase = PHASE_CHARGE;
+    float phaseTime = 0.0;
+    float topSpread = 0.0;
+
+    pack_init(pack);
+    balance_init(&plan);
+    for (uint32_t day = 0; day < DAYS; day++)
+    {
+        for (float t = 0.0; t < DAY; t += DT)
+        {
+            float minOcv = 10.0, maxOcv = 0.0, minSoc = 1.0, maxSoc = 0.0;
+            for (uint8_t i = 0; i < NUM_CELLS; i++)
+            {
+                float ocv = pack_ocv(pack, i);
+                minOcv = fminf(minOcv, ocv);
+                maxOcv = fmaxf(maxOcv, ocv);
+                minSoc = fminf(minSoc, pack->soc[i]);
+                maxSoc = fmaxf(maxSoc, pack->soc[i]);
+            }
+
+            float current = 0.0; // Discharge
+            if (phase == PHASE_CHARGE && maxSoc >= 1.0)
+            {
+                topSpread = maxSoc - minSoc;
+                phase = PHASE_REST;
+                phaseTime = t;
+            }
+            if (phase == PHASE_REST && t - phaseTime >= REST)
+                phase = PHASE_DISCHARGE;
+            if (phase == PHASE_DISCHARGE && minSoc <= DEPTH)
+                phase = PHASE_IDLE;
+            if (phase == PHASE_CHARGE)
+                current = -CHARGE_CURRENT;
+            else if (phase == PHASE_DISCHARGE)
+                current = LOAD_CURRENT;
+
+            // As charger_balance, from the OCV of the cells
+            BalanceMode mode = balance_mode(&policy, minOcv, maxOcv, current, phase == PHASE_CHARGE);
+            float threshold = balance_threshold(&policy, mode);
+            if (balancing && mode != balanceMode)
+                balancing = false;
+            balanceMode = mode;
+            if (!balancing && mode != BALANCE_MODE_NONE && maxOcv - minOcv > threshold)
+            {
+                balancing = true;
+                balance_init(&plan);
+            }
+
+            uint64_t mask = 0;
+            if (balancing)
+            {
+                float excess[NUM_CELLS];
+                float voltage[NUM_CELLS];
+                float lowest = soc_ekf_from_ocv(minOcv);
+                bool needed = false;
+                for (uint8_t i = 0; i < NUM_CELLS; i++)
+                {
+                    voltage[i] = pack_ocv(pack, i);
+                    excess[i] = 0.0;
+                    if (voltage[i] - minOcv > threshold / 2.0)
+                    {
+                        excess[i] = (soc_ekf_from_ocv(voltage[i]) - lowest) * CAPACITY;
+                        needed = true;
+                    }
+                }
+                if (needed)
+                {
+                    balance_plan(&plan, excess, voltage, NUM_CELLS, BALANCE_RESISTANCE, BALANCE_MAX_POWER,
+                            BALANCE_MAX_CHANNELS);
+                    mask = balance_next(&plan);
+                }
+                else
+                    balancing = false;
+            }
+
+            for (uint8_t i = 0; i < NUM_CELLS; i++)
+            {
+                float bleed = mask & ((uint64_t)1 << i) ? pack_ocv(pack, i) / BALANCE_RESISTANCE : 0.0;
+                pack->soc[i] -= (current + bleed) * DT / 3.6 / pack->capacity[i] +
+                        pack->soc[i] * pack->selfDischarge[i] * DT;
+                pack->soc[i] = fmaxf(pack->soc[i], 0.0);
+            }
+        }
+        phase = PHASE_CHARGE;
+    }
+    return topSpread;
+}
+
+int main(void)
+{
+    static const struct
+    {
+        const char *name;
+        uint8_t modes;
+    } policies[] = {
+        {"none", BALANCE_MODE_NONE},
+        {"top", BALANCE_MODE_TOP},
+        {"discharge", BALANCE_MODE_DISCHARGE},
+        {"default", BALANCE_MODE_TOP | BALANCE_MODE_DISCHARGE}
+    };
+    float spread[sizeof(policies) / sizeof(policies[0])];
+    Pack pack;
+
+    for (uint8_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++)
+    {
+        spread[p] = pack_cycle(&pack, policies[p].modes);
+        printf("balance_policy: %s, %.2f%% spread full after %d days\n", policies[p].name, spread[p] * 100.0, DAYS);
+    }
+    if (spread[1] > MAX_TOP_SPREAD || spread[3] > MAX_TOP_SPREAD || spread[3] >= spread[0])
+    {
+        printf("balance_policy: FAILED\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include "cell_kernels.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Checks the SIMD kernels of cell_kernels.c, built here with emulated
+// intrinsics under the simd_ prefix, against the plain C versions on
+// random register contents and cell voltages.
+
+void simd_cell_kernels_unpack(const uint8_t *reg, uint16_t *mv, uint8_t num);
+void simd_cell_kernels_min_max(const uint16_t *mv, uint8_t num, uint16_t *min, uint16_t *max);
+uint32_t simd_cell_kernels_sum(const uint16_t *mv, uint8_t num);
+
+#define NUM_CELLS 36
+#define RUNS 100000
+
+int main(void)
+{
+    uint8_t reg[NUM_CELLS / 2 * 3];
+    uint16_t mv[NUM_CELLS] CELL_KERNELS_ALIGNED;
+    uint16_t simdMv[NUM_CELLS] CELL_KERNELS_ALIGNED;
+    uint32_t failures = 0;
+
+    srand(1);
+    for (uint32_t run = 0; run < RUNS && failures < 10; run++)
+    {
+        for (uint8_t i = 0; i < sizeof(reg); i++)
+            reg[i] = rand() & 0xFF;
+        // Around the offset, where the saturation matters
+        if (run % 4 == 0)
+        {
+            for (uint8_t i = 0; i < sizeof(reg); i += 3)
+            {
+                reg[i] = rand() & 0x03;
+                reg[i + 1] = (rand() & 0x20) | 0x02;
+            }
+        }
+
+        cell_kernels_unpack(reg, mv, NUM_CELLS);
+        simd_cell_kernels_unpack(reg, simdMv, NUM_CELLS);
+        for (uint8_t i = 0; i < NUM_CELLS; i++)
+        {
+            if (mv[i] != simdMv[i])
+            {
+                printf("unpack: run %u cell %u: %u, SIMD %u\n", run, i, mv[i], simdMv[i]);
+                failures++;
+                break;
+            }
+        }
+
+        uint8_t num = rand() % (NUM_CELLS + 1);
+        uint16_t min, max, simdMin, simdMax;
+        cell_kernels_min_max(mv, num, &min, &max);
+        simd_cell_kernels_min_max(mv, num, &simdMin, &simdMax);
+        if (min != simdMin || max != simdMax)
+        {
+            printf("min_max: run %u, %u cells: %u/%u, SIMD %u/%u\n", run, num, min, max, simdMin, simdMax);
+            failures++;
+        }
+
+        uint32_t sum = cell_kernels_sum(mv, num);
+        uint32_t simdSum = simd_cell_kernels_sum(mv, num);
+        if (sum != simdSum)
+        {
+            printf("sum: run %u, %u cells: %u, SIMD %u\n", run, num, sum, simdSum);
+            failures++;
+        }
+    }
+
+    printf("cell_kernels: %s\n", failures == 0 ? "SIMD and C versions agree" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
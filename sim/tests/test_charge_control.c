@@ -0,0 +1,141 @@
+#include "charge_control.h"
+#include "soc_ekf.h"
+#include <math.h>
+#include <stdio.h>
+
+// Closes the loop of the charge controller on a 6S pack model with the
+// default gains, slew rate and charge voltage. The charger output follows
+// its setpoint with a first order lag, the pack is its open circuit
+// voltage plus the drop in its resistance, and the controller sees the
+// current and the cell voltages at CHARGER_CONTROL_PERIOD. Prints the
+// settling time and overshoot of the CC step with the resistance known,
+// off by 2, and not fed forward at all, and fails if the first two
+// overshoot or settle late. Then checks that the CV phase never holds the
+// pack above the charge voltage and that the current tapers off.
+
+#define NUM_CELLS 6
+#define CAPACITY 2500.0 // mAh
+#define RESISTANCE 0.15 // Ohm, of the pack
+#define CHARGER_TIME 0.02 // s, of the charger output
+#define DT 0.01 // s, CHARGER_CONTROL_PERIOD
+#define SUBSTEPS 10 // Of the plant per update
+#define TARGET 2.0 // A, the default chargeCurrent
+#define BAND 0.02 // Of the target, settled within it
+#define MAX_SETTLING 1.0 // s
+#define MAX_OVERSHOOT 0.05 // Of the target
+#define CV_TIME 1800.0 // s
+#define CV_CURRENT (TARGET / 20.0) // A, tapered off by the end of CV_TIME
+#define CV_MARGIN 0.01 // V
+
+static const ChargeControlParams params = {
+    .gainP = 0.1, // The defaults of the configuration
+    .gainI = 1.0,
+    .chargeVoltage = 25.2,
+    .slewRate = 5.0
+};
+
+typedef struct
+{
+    double soc; // Steps of a few mA are under the resolution of a float
+    float output; // V, of the charger
+    float current; // A, into the pack
+    float voltage; // V, at the pack terminals
+} Plant;
+
+static void plant_init(Plant *plant, float soc)
+{
+    float slope;
+    plant->soc = soc;
+    plant->voltage = NUM_CELLS * soc_ekf_ocv(soc, &slope);
+    plant->output = plant->voltage;
+    plant->current = 0.0;
+}
+
+static void plant_step(Plant *plant, float setpoint)
+{
+    float slope;
+    for (uint8_t i = 0; i < SUBSTEPS; i++)
+    {
+        float dt = DT / SUBSTEPS;
+        float ocv = NUM_CELLS * soc_ekf_ocv(plant->soc, &slope);
+        plant->output += (setpoint - plant->output) * dt / CHARGER_TIME;
+        // The charger does not sink current
+        plant->current = fmaxf((plant->output - ocv) / RESISTANCE, 0.0);
+        plant->voltage = ocv + plant->current * RESISTANCE;
+        plant->soc += plant->current * dt / 3.6 / CAPACITY;
+    }
+}
+
+// Runs the CC step from rest for duration s with the controller given
+// packResistance, returns the settling time and the overshoot
+static float cc_step(float packResistance, float duration, float *overshoot)
+{
+    Plant plant;
+    ChargeControl control;
+    float settled = -1.0;
+    float peak = 0.0;
+
+    plant_init(&plant, 0.5);
+    charge_control_init(&control, plant.voltage);
+    for (uint32_t n = 1; n * DT <= duration; n++)
+    {
+        plant_step(&plant, charge_control_update(&control, &params, TARGET, plant.current, plant.voltage,
+                packResistance, DT));
+        peak = fmaxf(peak, plant.current);
+        if (fabs(plant.current - TARGET) > BAND * TARGET)
+            settled = -1.0;
+        else if (settled < 0.0)
+            settled = n * DT;
+    }
+    *overshoot = (peak - TARGET) / TARGET;
+    return settled;
+}
+
+int main(void)
+{
+    static const struct
+    {
+        const char *name;
+        float resistance;
+        bool checked;
+    } cases[] = {
+        {"resistance known", RESISTANCE, true},
+        {"resistance 2x", 2.0 * RESISTANCE, true},
+        {"no feed-forward", 0.0, false}
+    };
+    uint32_t failures = 0;
+
+    for (uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        float overshoot;
+        float settled = cc_step(cases[i].resistance, 10.0, &overshoot);
+        printf("charge_control: CC %s, settled in %.2f s, overshoot %.1f%%\n", cases[i].name, settled,
+                fmaxf(overshoot, 0.0) * 100.0);
+        if (cases[i].checked && (settled < 0.0 || settled > MAX_SETTLING || overshoot > MAX_OVERSHOOT))
+            failures++;
+    }
+
+    // CV from near full
+    Plant plant;
+    ChargeControl control;
+    float maxVoltage = 0.0;
+    plant_init(&plant, 0.95);
+    charge_control_init(&control, plant.voltage);
+    for (uint32_t n = 1; n * DT <= CV_TIME; n++)
+    {
+        plant_step(&plant, charge_control_update(&control, &params, TARGET, plant.current, plant.voltage,
+                RESISTANCE, DT));
+        maxVoltage = fmaxf(maxVoltage, plant.voltage);
+    }
+    printf("charge_control: CV, pack up to %.3f V, %.3f A after %.0f min\n", maxVoltage, plant.current,
+            CV_TIME / 60.0);
+    if (maxVoltage > params.chargeVoltage + CV_MARGIN || plant.current > CV_CURRENT)
+        failures++;
+
+    if (failures > 0)
+    {
+        printf("charge_control: FAILED\n");
+        return 1;
+    }
+    return 0;
+}
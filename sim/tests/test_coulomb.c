@@ -0,0 +1,90 @@
+#include "coulomb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Replays synthetic current profiles through the charge counter of the
+// current monitor and compares the totals with the exact charge of the
+// profile, summed separately in 128 bits. The float accumulation that the
+// counter replaced, charge -= current * dt, runs alongside for comparison.
+
+#define TICK_FREQUENCY 10000 // CH_CFG_ST_FREQUENCY
+#define CURRENT_LSB 0.02 // A, CURRENT_MONITOR_CURRENT_LSB
+#define PERIOD_TICKS 10 // 1ms, the default currentSamplePeriod
+
+typedef enum
+{
+    PROFILE_CONSTANT,
+    PROFILE_RIDE,
+    PROFILE_STANDBY
+} Profile;
+
+static const char *names[] = {"20A for 4h", "ride for 4h", "20mA for 24h"};
+static const uint32_t durations[] = {4 * 3600, 4 * 3600, 24 * 3600}; // s
+
+// Shunt code of the next sample
+static int16_t profile_sample(Profile profile, int32_t *state)
+{
+    switch (profile)
+    {
+        case PROFILE_CONSTANT:
+            return 20.0 / CURRENT_LSB;
+        case PROFILE_RIDE:
+            // Random walk between 30A of regeneration and 100A
+            *state += rand() % 201 - 100;
+            if (*state > 100.0 / CURRENT_LSB)
+                *state = 100.0 / CURRENT_LSB;
+            else if (*state < -30.0 / CURRENT_LSB)
+                *state = -30.0 / CURRENT_LSB;
+            return *state;
+        default:
+            return 1;
+    }
+}
+
+int main(void)
+{
+    uint32_t failures = 0;
+
+    srand(1);
+    for (Profile p = PROFILE_CONSTANT; p <= PROFILE_STANDBY; p++)
+    {
+        CoulombCount count = {0, 0};
+        __int128 exactIn = 0;
+        __int128 exactOut = 0;
+        float floatCharge = 0.0; // As
+        int32_t state = 0;
+        uint64_t ticks = 0;
+
+        while (ticks < (uint64_t)durations[p] * TICK_FREQUENCY)
+        {
+            int16_t shunt = profile_sample(p, &state);
+            // The samples come late or early by a tick
+            uint32_t dt = PERIOD_TICKS - 1 + rand() % 3;
+
+            coulomb_add(&count, shunt, dt);
+            if (shunt > 0)
+                exactOut += (__int128)shunt * dt;
+            else
+                exactIn -= (__int128)shunt * dt;
+            floatCharge -= shunt * (float)CURRENT_LSB * ((float)dt / TICK_FREQUENCY);
+            ticks += dt;
+        }
+
+        double exact = (double)(exactIn - exactOut) * CURRENT_LSB / TICK_FREQUENCY / 3.6; // mAh
+        double counted = (double)(count.chargeIn - count.chargeOut) * CURRENT_LSB / TICK_FREQUENCY / 3.6;
+        bool ok = count.chargeIn == exactIn && count.chargeOut == exactOut;
+        printf("coulomb: %-13s net %11.3f mAh, counter error %.6f mAh, float error %.3f mAh\n", names[p],
+                exact, counted - exact, floatCharge / 3.6 - exact);
+        if (!ok)
+            failures++;
+    }
+
+    if (failures > 0)
+    {
+        printf("coulomb: FAILED\n");
+        return 1;
+    }
+    printf("coulomb: the totals are exact, resolution %.1e mAh\n", CURRENT_LSB / TICK_FREQUENCY / 3.6);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "i2t.h"
+#include <math.h>
+#include <stdio.h>
+
+// Runs the overcurrent thermal model of the current monitor at the default
+// sample rate with the default curve, 100A continuous and 120A tripping
+// after 30s from cold. Checks the trip times from cold against
+// tau * ln(I^2 / (I^2 - Ic^2)), that the continuous current never trips,
+// and that short peaks above the curve point, below the peak current trip,
+// ride through on a light average load.
+
+#define DT 0.001 // s, the default currentSamplePeriod
+#define CONTINUOUS 100.0 // A, maxContinuousCurrent
+#define CURVE_CURRENT 120.0 // A, maxCurrentCutoff
+#define CURVE_TIME 30.0 // s, continuousCurrentCutoffTime
+#define TOLERANCE 0.01 // Of the trip time
+
+// s until the trip from cold, or a negative value if none within limit
+static float trip_time(const I2tCurve *curve, float current, float limit)
+{
+    I2tState state;
+    i2t_init(&state);
+    for (uint32_t n = 1; n * DT <= limit; n++)
+    {
+        if (i2t_update(&state, curve, current, DT))
+            return n * DT;
+    }
+    return -1.0;
+}
+
+int main(void)
+{
+    static const float currents[] = {105.0, 110.0, 120.0, 150.0, 200.0};
+    I2tCurve curve;
+    uint32_t failures = 0;
+
+    i2t_curve(&curve, CONTINUOUS, CURVE_CURRENT, CURVE_TIME);
+    printf("i2t: time constant %.1f s\n", curve.timeConstant);
+
+    for (uint8_t i = 0; i < sizeof(currents) / sizeof(currents[0]); i++)
+    {
+        float current = currents[i];
+        float expected = curve.timeConstant * logf(current * current / (current * current - CONTINUOUS * CONTINUOUS));
+        float t = trip_time(&curve, current, 10.0 * expected);
+        bool ok = t > 0.0 && fabsf(t - expected) <= TOLERANCE * expected + DT;
+        printf("i2t: %.0fA trips after %.3f s, expected %.3f s%s\n", current, t, expected, ok ? "" : ", FAILED");
+        if (!ok)
+            failures++;
+    }
+
+    float t = trip_time(&curve, CONTINUOUS, 3600.0);
+    printf("i2t: %.0fA for an hour %s\n", CONTINUOUS, t < 0.0 ? "does not trip" : "trips, FAILED");
+    if (t >= 0.0)
+        failures++;
+
+    // 2s at 140A every 20s on 40A, below the default peakCurrentCutoff
+    I2tState state;
+    bool tripped = false;
+    float lowest = 1.0;
+    i2t_init(&state);
+    for (uint32_t n = 0; n * DT < 3600.0 && !tripped; n++)
+    {
+        float current = n % 20000 < 2000 ? 140.0 : 40.0;
+        tripped = i2t_update(&state, &curve, current, DT);
+        if (i2t_headroom(&state, &curve) < lowest)
+            lowest = i2t_headroom(&state, &curve);
+    }
+    printf("i2t: 2s peaks of 140A every 20s on 40A %s, %u events of %.0f A2s, lowest headroom %.0f%%\n",
+            tripped ? "trip, FAILED" : "ride through", state.numEvents, state.event.energy, lowest * 100.0);
+    if (tripped)
+        failures++;
+
+    if (failures > 0)
+    {
+        printf("i2t: FAILED\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include "seqlock.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <sched.h>
+
+// Hammers a seqlock with a writer and several readers running in parallel
+// threads. The writer publishes records whose words all hold the same
+// count, a reader that ever copies words of two different records, or a
+// count going backwards, has seen a torn snapshot. The writer yields in the
+// middle of some updates, as it is preempted on the target by the higher
+// priority readers, so that the readers meet updates in progress even on a
+// single core.
+
+#define NUM_READERS 3
+#define NUM_WORDS 16
+#define WRITES 2000000
+#define YIELD_EVERY 64 // Writes
+
+typedef struct
+{
+    uint32_t word[NUM_WORDS];
+} Record;
+
+static seqlock_t lock;
+static volatile Record shared;
+static volatile bool done;
+
+typedef struct
+{
+    uint32_t snapshots;
+    uint32_t torn;
+    uint32_t backwards;
+} ReaderStats;
+
+static void* writer(void *arg)
+{
+    Record r;
+    (void)arg;
+
+    for (uint32_t n = 1; n <= WRITES; n++)
+    {
+        if (n % YIELD_EVERY != 0)
+        {
+            for (uint8_t i = 0; i < NUM_WORDS; i++)
+                r.word[i] = n;
+            seqlock_publish(&lock, (void*)&shared, &r, sizeof(r));
+            continue;
+        }
+        seqlock_write_begin(&lock);
+        for (uint8_t i = 0; i < NUM_WORDS; i++)
+        {
+            shared.word[i] = n;
+            if (i == NUM_WORDS / 2)
+                sched_yield();
+        }
+        seqlock_write_end(&lock);
+    }
+    done = true;
+    return NULL;
+}
+
+static void* reader(void *arg)
+{
+    ReaderStats *s = arg;
+    Record r;
+    uint32_t last = 0;
+
+    while (!done)
+    {
+        seqlock_snapshot(&lock, &r, (const void*)&shared, sizeof(r));
+        s->snapshots++;
+        for (uint8_t i = 1; i < NUM_WORDS; i++)
+        {
+            if (r.word[i] != r.word[0])
+            {
+                s->torn++;
+                break;
+            }
+        }
+        if (r.word[0] < last)
+            s->backwards++;
+        last = r.word[0];
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t writerThread;
+    pthread_t readerThreads[NUM_READERS];
+    ReaderStats stats[NUM_READERS] = {{0}};
+    uint32_t failures = 0;
+
+    seqlock_init(&lock);
+    for (uint8_t i = 0; i < NUM_READERS; i++)
+        pthread_create(&readerThreads[i], NULL, reader, &stats[i]);
+    pthread_create(&writerThread, NULL, writer, NULL);
+    pthread_join(writerThread, NULL);
+    for (uint8_t i = 0; i < NUM_READERS; i++)
+    {
+        pthread_join(readerThreads[i], NULL);
+        printf("seqlock: reader %u: %u snapshots, %u torn, %u out of order\n", i,
+                stats[i].snapshots, stats[i].torn, stats[i].backwards);
+        failures += stats[i].torn + stats[i].backwards;
+    }
+
+    if (failures > 0)
+    {
+        printf("seqlock: FAILED\n");
+        return 1;
+    }
+    printf("seqlock: %u writes, no torn snapshot\n", WRITES);
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "soc_ekf.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Replays a load profile on a cell model and runs the SoC filter of soc.c
+// on its measurements, as soc_update does every 100ms. The cell has the
+// OCV curve of the filter, the series resistance it assumes and an RC
+// polarization it does not know about. The measurements carry the errors
+// of the board: a current gain and offset error that the counted charge
+// accumulates, and the noise and resolution of the LTC6803. The filter
+// starts 20% off, as from a voltage read under load. Prints the error of
+// the filter and of the counted charge alone, and the cost of an update.
+//
+// The profile is a synthetic ride, or the file given as argument: one
+// "time,current" line per change of current, in s and A, positive
+// discharging.
+
+#define DT 0.1 // s, soc_update period
+#define CAPACITY (2.5 * 3600.0) // As, the default packCapacity
+#define R0 0.02 // Ohm, series resistance, the cell IR measured by cell_ir.c
+#define R1 0.015 // Ohm, polarization
+#define TAU1 40.0 // s
+#define GAIN_ERROR 1.02
+#define OFFSET_ERROR 0.02 // A
+#define NOISE 0.002 // V
+#define VOLTAGE_LSB 0.0015 // V
+#define SETTLE_TIME 600.0 // s, errors counted after it
+#define MAX_RMS_ERROR 0.02
+#define MAX_PROFILE 100000
+#define COST_RUNS 1000000
+
+static float profileTime[MAX_PROFILE];
+static float profileCurrent[MAX_PROFILE];
+static int profileLength;
+
+// 30 minutes of riding, between 0 and 6A with some regeneration and stops
+static void profile_ride(void)
+{
+    float t = 0.0;
+    profileLength = 0;
+    while (t < 1800.0 && profileLength < MAX_PROFILE)
+    {
+        profileTime[profileLength] = t;
+        int r = rand() % 10;
+        if (r == 0)
+            profileCurrent[profileLength] = 0.0;
+        else if (r == 1)
+            profileCurrent[profileLength] = -(rand() % 30) / 10.0;
+        else
+            profileCurrent[profileLength] = (rand() % 60) / 10.0;
+        profileLength++;
+        t += 5 + rand() % 30;
+    }
+}
+
+static bool profile_load(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return false;
+    profileLength = 0;
+    while (profileLength < MAX_PROFILE &&
+            fscanf(f, "%f,%f", &profileTime[profileLength], &profileCurrent[profileLength]) == 2)
+        profileLength++;
+    fclose(f);
+    return profileLength > 0;
+}
+
+static float noise(void)
+{
+    return NOISE * ((rand() % 2001) / 1000.0 - 1.0);
+}
+
+int main(int argc, char **argv)
+{
+    srand(1);
+    if (argc > 1)
+    {
+        if (!profile_load(argv[1]))
+        {
+            printf("soc_ekf: can't read %s\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+        profile_ride();
+
+    float end = profileTime[profileLength - 1] + 60.0;
+    double soc = 0.9;
+    double vrc = 0.0;
+    float slope;
+    SocEkf ekf;
+    soc_ekf_init(&ekf, soc_ekf_ocv(soc - 0.2, &slope));
+    float counted = ekf.soc;
+    double sumSquares = 0.0;
+    double maxError = 0.0;
+    double countedError = 0.0;
+    uint32_t n = 0;
+    int p = 0;
+
+    for (float t = 0.0; t < end; t += DT)
+    {
+        while (p + 1 < profileLength && profileTime[p + 1] <= t)
+            p++;
+        float current = profileCurrent[p];
+
+        // Cell
+        soc -= current * DT / CAPACITY;
+        vrc += (current * R1 - vrc) * DT / TAU1;
+        double voltage = soc_ekf_ocv(soc, &slope) - current * R0 - vrc + noise();
+        voltage = round(voltage / VOLTAGE_LSB) * VOLTAGE_LSB;
+
+        // Board
+        float measured = current * GAIN_ERROR + OFFSET_ERROR;
+        soc_ekf_predict(&ekf, -measured * DT, CAPACITY, R0, DT);
+        soc_ekf_correct(&ekf, voltage, measured, R0);
+        counted -= measured * DT / CAPACITY;
+
+        if (t >= SETTLE_TIME)
+        {
+            double error = fabs(ekf.soc - soc);
+            sumSquares += error * error;
+            if (error > maxError)
+                maxError = error;
+            countedError = counted - soc;
+            n++;
+        }
+    }
+    double rms = n > 0 ? sqrt(sumSquares / n) : 0.0;
+    printf("soc_ekf: %.0f min, SoC %.1f%% at the end: filter error rms %.2f%%, max %.2f%%, +/- %.2f%% reported\n",
+            end / 60.0, soc * 100.0, rms * 100.0, maxError * 100.0, sqrtf(ekf.variance) * 100.0);
+    printf("soc_ekf: counted charge alone, error %.2f%% at the end\n", countedError * 100.0);
+
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < COST_RUNS; i++)
+    {
+        soc_ekf_predict(&ekf, -0.5, CAPACITY, R0, DT);
+        soc_ekf_correct(&ekf, 3.7 + (i & 0xFF) * 1e-4, 5.0, R0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double ns = ((stop.tv_sec - start.tv_sec) * 1e9 + (stop.tv_nsec - start.tv_nsec)) / COST_RUNS;
+    printf("soc_ekf: %.1f ns per update on this host (SoC %.2f)\n", ns, ekf.soc);
+
+    if (rms > MAX_RMS_ERROR)
+    {
+        printf("soc_ekf: FAILED, rms error above %.0f%%\n", MAX_RMS_ERROR * 100.0);
+        return 1;
+    }
+    return 0;
+}
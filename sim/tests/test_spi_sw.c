@@ -0,0 +1,109 @@
+#include "spi_sw.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Runs the software SPI of the BATTMAN_4_0 boards against a model of the
+// LTC6803 pins: it shifts MISO out after the falling edge of SCK and samples
+// MOSI on the rising edge. Checks that both sides get the other's bytes and
+// prints the interrupt load at the timer settings of ltc6803.c.
+
+#define HALF_PERIOD_US 2 // SPI_SW_HALF_PERIOD at SPI_SW_TIMER_FREQUENCY
+#define MAX_FRAME 59 // FRAME_MAX_LEN, RDCV of 3 devices
+#define RUNS 10000
+
+typedef struct
+{
+    const uint8_t *out;
+    uint8_t *in;
+    int index;
+    uint8_t bit;
+    uint8_t send;
+    uint8_t receive;
+    bool miso;
+} Slave;
+
+static void slave_falling(Slave *d)
+{
+    if (d->bit == 0)
+        d->send = d->out[d->index];
+    d->miso = d->send >> 7;
+    d->send <<= 1;
+}
+
+static void slave_rising(Slave *d, bool mosi)
+{
+    d->receive = (d->receive << 1) | mosi;
+    if (++d->bit < 8)
+        return;
+    d->in[d->index++] = d->receive;
+    d->bit = 0;
+}
+
+// Number of edges of the transfer
+static uint32_t transfer(uint8_t *in, const uint8_t *out, Slave *d, int length)
+{
+    SpiSw s;
+    bool mosi = false;
+    uint32_t edges = 0;
+
+    spi_sw_start(&s, in, out, length);
+    for (;;)
+    {
+        edges++;
+        if (!s.clockLow)
+        {
+            mosi = spi_sw_falling(&s);
+            slave_falling(d);
+            continue;
+        }
+        bool done = spi_sw_rising(&s, d->miso);
+        slave_rising(d, mosi);
+        if (done || edges > (uint32_t)length * 16)
+            break;
+    }
+    return edges;
+}
+
+int main(void)
+{
+    uint8_t out[MAX_FRAME];
+    uint8_t in[MAX_FRAME];
+    uint8_t slaveOut[MAX_FRAME];
+    uint8_t slaveIn[MAX_FRAME];
+    uint8_t zeros[MAX_FRAME] = {0};
+    uint32_t failures = 0;
+
+    srand(1);
+    for (uint32_t run = 0; run < RUNS && failures < 10; run++)
+    {
+        int length = 1 + rand() % MAX_FRAME;
+        for (int i = 0; i < length; i++)
+        {
+            out[i] = rand() & 0xFF;
+            slaveOut[i] = rand() & 0xFF;
+        }
+        // Reads send zeros
+        bool read = run % 4 == 0;
+        Slave d = {slaveOut, slaveIn, 0, 0, 0, 0, true};
+
+        uint32_t edges = transfer(in, read ? NULL : out, &d, length);
+        if (edges != (uint32_t)length * 16 || d.index != length ||
+                memcmp(in, slaveOut, length) != 0 ||
+                memcmp(slaveIn, read ? zeros : out, length) != 0)
+        {
+            printf("spi_sw: run %u, %d bytes: %u edges, %d bytes received\n", run, length, edges, d.index);
+            failures++;
+        }
+    }
+
+    printf("spi_sw: SCK %d kHz, %d kHz of timer interrupts, %d us per %d bytes frame\n",
+            1000 / (2 * HALF_PERIOD_US), 1000 / HALF_PERIOD_US, MAX_FRAME * 16 * HALF_PERIOD_US, MAX_FRAME);
+    if (failures > 0)
+    {
+        printf("spi_sw: FAILED\n");
+        return 1;
+    }
+    printf("spi_sw: transfers match the LTC6803 model\n");
+    return 0;
+}
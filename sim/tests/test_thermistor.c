@@ -0,0 +1,85 @@
+#include "thermistor.h"
+#include "hw_conf.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Compares the generated thermistor tables of the board built, see
+// thermistor.c, with the Beta equation they were generated from, over every
+// divider ratio between -20 and 120 degrees C. Prints the largest error and
+// the cost of a lookup against the float Beta equation with logf that the
+// tables replaced.
+
+#define RANGE_MIN -20.0
+#define RANGE_MAX 120.0
+#define MAX_ERROR 0.13 // degree C, as stated in thermistor.c
+#define COST_RUNS 10000000
+
+typedef float (*Lookup)(uint32_t ratio);
+
+static double beta(uint32_t ratio, double r25, double b, double divider, bool lowSide)
+{
+    double x = (double)ratio / (1 << THERMISTOR_RATIO_BITS);
+    if (!lowSide)
+        x = 1.0 - x;
+    double r = divider * x / (1.0 - x);
+    return 1.0 / (log(r / r25) / b + 1.0 / 298.15) - 273.15;
+}
+
+static float beta_float(uint32_t ratio)
+{
+    float x = (float)ratio / (1 << THERMISTOR_RATIO_BITS);
+    return 1.0f / (logf(BOARD_NTC_DIVIDER_R * (1.0f - x) / x / BOARD_NTC_R25) / BOARD_NTC_B + 1.0f / 298.15f) - 273.15f;
+}
+
+static double max_error(Lookup lookup, double r25, double b, double divider, bool lowSide)
+{
+    double worst = 0.0;
+    for (uint32_t ratio = 1; ratio < (1 << THERMISTOR_RATIO_BITS); ratio++)
+    {
+        double t = beta(ratio, r25, b, divider, lowSide);
+        if (t < RANGE_MIN || t > RANGE_MAX)
+            continue;
+        double error = fabs(lookup(ratio) - t);
+        if (error > worst)
+            worst = error;
+    }
+    return worst;
+}
+
+static double cost(Lookup lookup, const uint32_t *ratios)
+{
+    struct timespec start, stop;
+    volatile float sum = 0.0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t i = 0; i < COST_RUNS; i++)
+        sum += lookup(ratios[i & 0xFFF]);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    return ((stop.tv_sec - start.tv_sec) * 1e9 + (stop.tv_nsec - start.tv_nsec)) / COST_RUNS;
+}
+
+int main(void)
+{
+    static uint32_t ratios[0x1000];
+    double boardError = max_error(thermistor_board_temperature, BOARD_NTC_R25, BOARD_NTC_B,
+            BOARD_NTC_DIVIDER_R, BOARD_NTC_LOW_SIDE);
+    double batteryError = max_error(thermistor_battery_temperature, BATT_NTC_R25, BATT_NTC_B,
+            BATT_NTC_DIVIDER_R, BATT_NTC_LOW_SIDE);
+
+    srand(1);
+    for (uint32_t i = 0; i < 0x1000; i++)
+        ratios[i] = 8192 + rand() % 49152;
+
+    printf("thermistor: largest error from %.0f to %.0f degree C: board %.3f, battery %.3f\n",
+            RANGE_MIN, RANGE_MAX, boardError, batteryError);
+    printf("thermistor: %.1f ns per lookup, %.1f ns with logf on this host\n",
+            cost(thermistor_board_temperature, ratios), cost(beta_float, ratios));
+    if (boardError > MAX_ERROR || batteryError > MAX_ERROR)
+    {
+        printf("thermistor: FAILED\n");
+        return 1;
+    }
+    return 0;
+}
@@ -3,19 +3,54 @@
 #include "config.h"
 #include "power.h"
 #include "ltc6803.h"
+#include "cell_stats.h"
+#include "cell_ir.h"
+#include "seqlock.h"
+#include "soc_ekf.h"
+#include <math.h>
+
+#define CHARGE_SAVE_PERIOD 600 // Charge totals saved to EEPROM at rest at most this often (s)
+#define CHARGE_SAVE_REST_CURRENT 0.5 // A
+
+// State of charge estimator: an extended Kalman filter on the pack SoC,
+// see soc_ekf.c. The prediction uses the charge counted by the current
+// monitor, the correction the average cell voltage of each new LTC6803
+// scan.
+#define SOC_DEFAULT_CELL_RESISTANCE 0.02 // Ohm, until the IR is measured
+
+typedef struct
+{
+    float coulombCount;
+    float battIntResistance;
+    float soc;
+    float socVariance;
+} SocState;
 
 static volatile Config *config;
 static float coulomb_count;
-static systime_t prevTime;
+static SocState state;
+static seqlock_t stateLock;
+static systime_t chargeSaveTime;
+static bool socValid;
+static SocEkf ekf;
+static int64_t socCharge;
+static uint32_t socCellSeq;
+static systime_t socTime;
 float avgCellIntResistance;
 float battIntResistance;
 float maxVoltageSag[2];//[1}=voltage sag; [1]=current when it happened
 float idleVoltage;
 
+static void soc_estimate(float current, const CellStats *cells, const CurrentMonitorCharge *charge);
+
 void soc_init(void)
 {
     config = config_get_configuration();
-    prevTime = chVTGetSystemTime();
+    seqlock_init(&stateLock);
+    chargeSaveTime = chVTGetSystemTime();
+    socValid = false;
+    ekf.soc = 0.0;
+    ekf.variance = 0.0;
 	avgCellIntResistance = 0;
 	battIntResistance = 0;
 	avgCellIntResistance = 0;
@@ -23,21 +58,29 @@ void soc_init(void)
 
 void soc_update(void)
 {
-    float dt = ST2US(chVTTimeElapsedSinceX(prevTime)) / 1.0e6;
-    prevTime = chVTGetSystemTime();
-    float current = current_monitor_get_current();
-	float battVoltage = current_monitor_get_bus_voltage();
-	float* cells = ltc6803_get_cell_voltages();
-	float sumCellsVoltage = 0;
+    CurrentMonitorCharge charge;
+    CurrentMonitorSample sample;
+    current_monitor_get_sample(&sample);
+    float current = sample.current;
+	float battVoltage = sample.voltage;
+	SocState newState;
+	CellStats cells;
 	float voltageSag;
 	
 	
-    coulomb_count -= current * dt;
+    // Integrated by the current monitor on every sample. The totals are
+    // saved on stop, and at rest in between: a page erase stalls the flash
+    // for tens of ms, which is better spent when nothing is discharging.
+    current_monitor_get_charge(&charge);
+    coulomb_count = current_monitor_charge_to_as(charge.chargeIn - charge.chargeOut);
+    if (fabs(current) < CHARGE_SAVE_REST_CURRENT && ST2S(chVTTimeElapsedSinceX(chargeSaveTime)) >= CHARGE_SAVE_PERIOD)
+    {
+        current_monitor_save_charge();
+        chargeSaveTime = chVTGetSystemTime();
+    }
+	cell_stats_get(&cells);
 	
-	for (uint8_t i = 0; i< config->numCells; i++) {
-		sumCellsVoltage += cells[i];
-	}
-	if ((sumCellsVoltage - battVoltage) > 2.0){
+	if ((cells.sumMv / 1000.0 - battVoltage) > 2.0){
 		//TODO : battery voltage inconsistency
 	}
 	
@@ -60,16 +103,14 @@ void soc_update(void)
 		faults_set_fault(FAULT_BATTERY_OV);
 		power_set_shutdown();
 	}
-	for(uint8_t i=0;i < config->numCells;i++) {
-		if (cells[i] < config->emptyCellVoltage) {
-			power_disable_discharge();
-			faults_set_fault(FAULT_CELL_UV);
-			power_set_shutdown();
-		}
-		else if (cells[i] > config->highVoltageCutoff) {
-			power_disable_discharge();
-			faults_set_fault(FAULT_CELL_OV);
-		}
+	if (cells.minMv < (uint16_t)(config->emptyCellVoltage * 1000.0)) {
+		power_disable_discharge();
+		faults_set_fault(FAULT_CELL_UV);
+		power_set_shutdown();
+	}
+	if (cells.maxMv > (uint16_t)(config->highVoltageCutoff * 1000.0)) {
+		power_disable_discharge();
+		faults_set_fault(FAULT_CELL_OV);
 	}
 	
 //INTERNAL RESISTANCE (two-tier DC load method) & VOLTAGE SAG
@@ -80,7 +121,6 @@ void soc_update(void)
 	else if (current > 10.0) {
 		voltageSag = idleVoltage - battVoltage;
 		battIntResistance = (voltageSag) / current * 1000.0;
-		avgCellIntResistance = (uint8_t)(battIntResistance / config->numCells);
 		if (voltageSag > maxVoltageSag[0]) {
 			maxVoltageSag[0] = voltageSag;
 			maxVoltageSag[1] = current;
@@ -88,19 +128,83 @@ void soc_update(void)
 	}
 	
 	//TODO : log values to estimate battery health
+
+	avgCellIntResistance = cell_ir_get_average() * 1000.0;
+
+	soc_estimate(current, &cells, &charge);
+
+	newState.coulombCount = coulomb_count;
+	newState.battIntResistance = battIntResistance;
+	newState.soc = ekf.soc;
+	newState.socVariance = ekf.variance;
+	seqlock_publish(&stateLock, &state, &newState, sizeof(state));
 }
 
 float soc_get_coulomb_count(void)
 {
-    return coulomb_count;
+    SocState s;
+    seqlock_snapshot(&stateLock, &s, &state, sizeof(state));
+    return s.coulombCount;
 }
 
+// Estimated state of charge from 0 to 1, 0 until the first cell scan
 float soc_get_relative_soc(void)
 {
-    return coulomb_count * 3600 * 1000 / config->packCapacity;
+    SocState s;
+    seqlock_snapshot(&stateLock, &s, &state, sizeof(state));
+    return s.soc;
+}
+
+// Standard deviation of the SoC estimate
+float soc_get_soc_uncertainty(void)
+{
+    SocState s;
+    seqlock_snapshot(&stateLock, &s, &state, sizeof(state));
+    return sqrtf(s.socVariance);
 }
 
 float soc_get_battery_IR(void) //TODO : add also avgCellIntResistance ?
 {
-	return battIntResistance;
+    SocState s;
+    seqlock_snapshot(&stateLock, &s, &state, sizeof(state));
+	return s.battIntResistance;
+}
+
+static void soc_estimate(float current, const CellStats *cells, const CurrentMonitorCharge *charge)
+{
+    int64_t netCharge = charge->chargeIn - charge->chargeOut;
+    float resistance = avgCellIntResistance > 0 ? avgCellIntResistance / 1000.0 : SOC_DEFAULT_CELL_RESISTANCE;
+
+    // Started from the open circuit voltage of the first scan
+    if (!socValid)
+    {
+        if (cells->seq == 0 || cells->numCells == 0 || config->packCapacity <= 0)
+            return;
+        soc_ekf_init(&ekf, cells->meanMv / 1000.0 + current * resistance);
+        socCharge = netCharge;
+        socCellSeq = cells->seq;
+        socTime = chVTGetSystemTime();
+        socValid = true;
+        return;
+    }
+
+    // Prediction with the charge counted since the last update
+    float dt = ST2MS(chVTTimeElapsedSinceX(socTime)) / 1000.0;
+    socTime = chVTGetSystemTime();
+    soc_ekf_predict(&ekf, current_monitor_charge_to_as(netCharge - socCharge), config->packCapacity * 3.6,
+            resistance, dt);
+    socCharge = netCharge;
+
+    // Correction with the average cell voltage of a new scan
+    if (cells->seq != socCellSeq)
+    {
+        socCellSeq = cells->seq;
+        soc_ekf_correct(&ekf, cells->meanMv / 1000.0, current, resistance);
+    }
+}
+
+// SoC of a cell at rest from its open circuit voltage
+float soc_from_ocv(float voltage)
+{
+    return soc_ekf_from_ocv(voltage);
 }
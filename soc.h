@@ -7,6 +7,8 @@ void soc_init(void);
 void soc_update(void);
 float soc_get_coulomb_count(void);
 float soc_get_relative_soc(void);
+float soc_get_soc_uncertainty(void);
 float soc_get_battery_IR(void);
+float soc_from_ocv(float voltage);
 
 #endif /* _SOC_H_ */
@@ -0,0 +1,111 @@
+#include "soc_ekf.h"
+#include <math.h>
+
+// Extended Kalman filter on the state of charge of a cell. The cell is an
+// open circuit voltage source, a series resistance and one RC branch for
+// the polarization, whose voltage is the second state: without it the
+// voltage under load, lower than the OCV for tens of seconds after the IR
+// drop, pulls the SoC down. The RC branch is not measured, its resistance
+// is taken as a fraction of the series resistance given by cell_ir.c.
+// The prediction adds the counted charge and relaxes the polarization, the
+// correction compares a measured cell voltage with the OCV of the
+// estimate minus both drops, the OCV curve linearized around the estimate.
+
+#define SOC_PROCESS_NOISE 1.0e-6 // SoC variance added per second
+#define SOC_POLARIZATION_NOISE 1.0e-5 // Polarization variance added per second (V^2)
+#define SOC_MEASUREMENT_NOISE 1.0e-4 // Cell voltage variance (V^2)
+#define SOC_INITIAL_VARIANCE 0.05
+#define SOC_POLARIZATION_RATIO 0.5 // Of the series resistance
+#define SOC_POLARIZATION_TIME 30.0 // s
+
+// Open circuit voltage of a Li-ion cell, SoC from 0 to 100% by 10% steps
+static const float ocv_table[11] = {
+    3.00, 3.45, 3.55, 3.62, 3.67, 3.72, 3.78, 3.86, 3.95, 4.06, 4.20
+};
+
+static void soc_ekf_clamp(SocEkf *ekf);
+
+// Started from the open circuit voltage of a cell
+void soc_ekf_init(SocEkf *ekf, float ocv)
+{
+    ekf->soc = soc_ekf_from_ocv(ocv);
+    ekf->polarization = 0.0;
+    ekf->variance = SOC_INITIAL_VARIANCE;
+    ekf->covariance = 0.0;
+    ekf->polarizationVariance = 0.0;
+}
+
+// charge in As, positive when charging, over dt seconds. capacity in As,
+// resistance the series resistance of a cell in Ohm.
+void soc_ekf_predict(SocEkf *ekf, float charge, float capacity, float resistance, float dt)
+{
+    if (dt <= 0.0)
+        return;
+    float a = expf(-dt / SOC_POLARIZATION_TIME);
+    float current = -charge / dt;
+
+    ekf->soc += charge / capacity;
+    ekf->polarization = ekf->polarization * a + (1.0 - a) * current * resistance * SOC_POLARIZATION_RATIO;
+    ekf->variance += SOC_PROCESS_NOISE * dt;
+    ekf->covariance *= a;
+    ekf->polarizationVariance = ekf->polarizationVariance * a * a + SOC_POLARIZATION_NOISE * dt;
+    soc_ekf_clamp(ekf);
+}
+
+// voltage of a cell in V under a discharge current in A
+void soc_ekf_correct(SocEkf *ekf, float voltage, float current, float resistance)
+{
+    float slope;
+    float predicted = soc_ekf_ocv(ekf->soc, &slope) - current * resistance - ekf->polarization;
+
+    // H = [slope, -1]
+    float ps = ekf->variance * slope - ekf->covariance;
+    float pp = ekf->covariance * slope - ekf->polarizationVariance;
+    float innovation = slope * ps - pp + SOC_MEASUREMENT_NOISE;
+    float gainSoc = ps / innovation;
+    float gainPolarization = pp / innovation;
+    float error = voltage - predicted;
+
+    ekf->soc += gainSoc * error;
+    ekf->polarization += gainPolarization * error;
+    ekf->variance -= gainSoc * ps;
+    ekf->covariance -= gainSoc * pp;
+    ekf->polarizationVariance -= gainPolarization * pp;
+    soc_ekf_clamp(ekf);
+}
+
+// Open circuit voltage and its derivative at a SoC
+float soc_ekf_ocv(float soc, float *slope)
+{
+    if (soc < 0.0)
+        soc = 0.0;
+    else if (soc > 1.0)
+        soc = 1.0;
+    float pos = soc * 10.0;
+    int i = (int)pos;
+    if (i > 9)
+        i = 9;
+    *slope = (ocv_table[i + 1] - ocv_table[i]) * 10.0;
+    return ocv_table[i] + (ocv_table[i + 1] - ocv_table[i]) * (pos - i);
+}
+
+// SoC of a cell at rest from its open circuit voltage
+float soc_ekf_from_ocv(float voltage)
+{
+    if (voltage <= ocv_table[0])
+        return 0.0;
+    for (int i = 0; i < 10; i++)
+    {
+        if (voltage <= ocv_table[i + 1])
+            return (i + (voltage - ocv_table[i]) / (ocv_table[i + 1] - ocv_table[i])) / 10.0;
+    }
+    return 1.0;
+}
+
+static void soc_ekf_clamp(SocEkf *ekf)
+{
+    if (ekf->soc < 0.0)
+        ekf->soc = 0.0;
+    else if (ekf->soc > 1.0)
+        ekf->soc = 1.0;
+}
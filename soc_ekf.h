@@ -0,0 +1,23 @@
+#ifndef _SOC_EKF_H_
+#define _SOC_EKF_H_
+
+// No ChibiOS dependency, the filter also builds on a host
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    float soc;          // 0 to 1
+    float polarization; // V, across the RC branch of the cell
+    float variance;     // Of the SoC
+    float covariance;   // Of the SoC and the polarization
+    float polarizationVariance;
+} SocEkf;
+
+void soc_ekf_init(SocEkf *ekf, float ocv);
+void soc_ekf_predict(SocEkf *ekf, float charge, float capacity, float resistance, float dt);
+void soc_ekf_correct(SocEkf *ekf, float voltage, float current, float resistance);
+float soc_ekf_ocv(float soc, float *slope);
+float soc_ekf_from_ocv(float voltage);
+
+#endif /* _SOC_EKF_H_ */
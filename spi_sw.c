@@ -0,0 +1,49 @@
+#include "spi_sw.h"
+
+// Bits of a software SPI master with CPOL=1 and CPHA=1, MSb first. The
+// caller runs one edge every half SCK period, starting with SCK high: on
+// the falling edge it drives SCK low and MOSI to the returned level, on the
+// rising edge it samples MISO before driving SCK high. A byte takes 16
+// edges.
+
+void spi_sw_start(SpiSw *s, uint8_t *in, const uint8_t *out, int length)
+{
+    s->out = out;
+    s->in = in;
+    s->length = length;
+    s->index = 0;
+    s->bit = 0;
+    s->send = out ? out[0] : 0;
+    s->receive = 0;
+    s->clockLow = false;
+}
+
+// Level of MOSI for the next bit
+bool spi_sw_falling(SpiSw *s)
+{
+    bool mosi = s->send >> 7;
+    s->send <<= 1;
+    s->clockLow = true;
+    return mosi;
+}
+
+// True once the last bit of the transfer is in
+bool spi_sw_rising(SpiSw *s, bool miso)
+{
+    s->receive = (s->receive << 1) | miso;
+    s->clockLow = false;
+
+    if (++s->bit < 8)
+        return false;
+
+    if (s->in)
+        s->in[s->index] = s->receive;
+    s->bit = 0;
+    s->receive = 0;
+    if (++s->index < s->length)
+    {
+        s->send = s->out ? s->out[s->index] : 0;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef _SPI_SW_H_
+#define _SPI_SW_H_
+
+// No ChibiOS dependency, the bit engine also builds on a host
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    const uint8_t *out; // NULL to send zeros
+    uint8_t *in;        // NULL to drop the received bytes
+    int length;
+    int index;
+    uint8_t bit;
+    uint8_t send;
+    uint8_t receive;
+    bool clockLow;
+} SpiSw;
+
+void spi_sw_start(SpiSw *s, uint8_t *in, const uint8_t *out, int length);
+bool spi_sw_falling(SpiSw *s);
+bool spi_sw_rising(SpiSw *s, bool miso);
+
+#endif /* _SPI_SW_H_ */
@@ -14,15 +14,22 @@ void temp_init(void)
 
 void temp_update(void) {
 	float boardTemp;
-	float* ltc6803Temp; //[0]=battery temp, [1]=not used, [2]=Internal LTC6803 temp
+	float* ltc6803Temp; //[0]=battery temp, [1]=not used, [2]=Internal LTC6803 temp, then the next devices
+	float ltc6803InternalTemp = 0.0;
 		
 	boardTemp = analog_temperature();
 	ltc6803Temp = ltc6803_get_temp();
+	for (uint8_t d = 0; d < ltc6803_get_num_devices(); d++) {
+		float internalTemp = ltc6803Temp[d * LTC6803_TEMPS_PER_DEVICE + 2];
+		if (d == 0 || internalTemp > ltc6803InternalTemp) {
+			ltc6803InternalTemp = internalTemp;
+		}
+	}
 
 //TRIGGERING FAULTS & WARNINGS
 	//Over LTC6803 internal temperature (analog and THSD bit)
 
-	if (ltc6803Temp[2] >= 85.0) { //TODO : add TSHD check
+	if (ltc6803InternalTemp >= 85.0) { //TODO : add TSHD check
 		faults_set_warning(WARNING_LTC6803_TEMP);
 	}
 	
@@ -53,7 +60,7 @@ void temp_update(void) {
 //CLEARING FAULTS & WARNINGS
 	//LTC6803 internal temperature OK (analog and THSD bit)
 
-	if (ltc6803Temp[2] < 65.0) {
+	if (ltc6803InternalTemp < 65.0) {
 		faults_clear_warning(WARNING_LTC6803_TEMP);
 	}
 	
@@ -0,0 +1,33 @@
+#include "thermistor.h"
+#include "hw_conf.h"
+#include "thermistor_table.h"
+
+// The thermistor curves are tabulated at build time from the parameters of
+// hw_conf_v*.h, see tools/thermistor_table.py. The ratio is the output of the
+// divider as a fraction of its reference with THERMISTOR_RATIO_BITS
+// fractional bits, the temperature is interpolated between the two nearest
+// entries in integer and is within 0.13 degree C of the Beta equation
+// between -20 and 120 degrees C.
+
+static float thermistor_lookup(const int16_t *table, uint32_t ratio)
+{
+    if (ratio >= (1 << THERMISTOR_RATIO_BITS))
+        ratio = (1 << THERMISTOR_RATIO_BITS) - 1;
+
+    uint32_t i = ratio >> THERMISTOR_TABLE_SHIFT;
+    int32_t fraction = ratio & ((1 << THERMISTOR_TABLE_SHIFT) - 1);
+    int32_t temp = table[i] + (((table[i + 1] - table[i]) * fraction) >> THERMISTOR_TABLE_SHIFT);
+    return (float)temp * 0.01f;
+}
+
+// Temperature of the board thermistor in degrees C
+float thermistor_board_temperature(uint32_t ratio)
+{
+    return thermistor_lookup(thermistorBoardTable, ratio);
+}
+
+// Temperature of the battery thermistor read by the LTC6803 in degrees C
+float thermistor_battery_temperature(uint32_t ratio)
+{
+    return thermistor_lookup(thermistorBatteryTable, ratio);
+}
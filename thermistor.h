@@ -0,0 +1,12 @@
+#ifndef _THERMISTOR_H_
+#define _THERMISTOR_H_
+
+#include "ch.h"
+
+// Fractional bits of the divider ratios
+#define THERMISTOR_RATIO_BITS 16
+
+float thermistor_board_temperature(uint32_t ratio);
+float thermistor_battery_temperature(uint32_t ratio);
+
+#endif /* _THERMISTOR_H_ */
@@ -0,0 +1,107 @@
+// Generated by tools/thermistor_table.py from the hw_conf_v*.h files, do
+// not edit
+
+#ifndef _THERMISTOR_TABLE_H_
+#define _THERMISTOR_TABLE_H_
+
+#define THERMISTOR_TABLE_SHIFT 9
+#define THERMISTOR_TABLE_SIZE 129
+
+#if defined BATTMAN_4_0
+static const int16_t thermistorBoardTable[THERMISTOR_TABLE_SIZE] = {
+    -5500, -5500, -5388, -4793, -4348, -3987, -3681, -3414, -3176, -2960,
+    -2762, -2578, -2406, -2245, -2093, -1948, -1809, -1677, -1549, -1427,
+    -1308, -1193, -1081, -973, -867, -764, -663, -564, -467, -372,
+    -279, -187, -96, -7, 81, 168, 254, 339, 423, 507,
+    590, 672, 753, 835, 915, 995, 1075, 1155, 1234, 1313,
+    1392, 1470, 1549, 1628, 1706, 1785, 1863, 1942, 2021, 2100,
+    2179, 2259, 2339, 2419, 2500, 2581, 2663, 2745, 2828, 2911,
+    2995, 3080, 3165, 3251, 3339, 3427, 3516, 3606, 3697, 3790,
+    3884, 3979, 4076, 4174, 4273, 4375, 4478, 4584, 4691, 4801,
+    4913, 5027, 5144, 5264, 5387, 5514, 5644, 5778, 5915, 6058,
+    6205, 6357, 6515, 6679, 6850, 7028, 7214, 7409, 7614, 7831,
+    8059, 8302, 8561, 8839, 9137, 9461, 9813, 10201, 10631, 11115,
+    11665, 12303, 13059, 13984, 15000, 15000, 15000, 15000, 15000
+};
+static const int16_t thermistorBatteryTable[THERMISTOR_TABLE_SIZE] = {
+    15000, 15000, 15000, 15000, 15000, 13984, 13059, 12303, 11665, 11115,
+    10631, 10201, 9813, 9461, 9137, 8839, 8561, 8302, 8059, 7831,
+    7614, 7409, 7214, 7028, 6850, 6679, 6515, 6357, 6205, 6058,
+    5915, 5778, 5644, 5514, 5387, 5264, 5144, 5027, 4913, 4801,
+    4691, 4584, 4478, 4375, 4273, 4174, 4076, 3979, 3884, 3790,
+    3697, 3606, 3516, 3427, 3339, 3251, 3165, 3080, 2995, 2911,
+    2828, 2745, 2663, 2581, 2500, 2419, 2339, 2259, 2179, 2100,
+    2021, 1942, 1863, 1785, 1706, 1628, 1549, 1470, 1392, 1313,
+    1234, 1155, 1075, 995, 915, 835, 753, 672, 590, 507,
+    423, 339, 254, 168, 81, -7, -96, -187, -279, -372,
+    -467, -564, -663, -764, -867, -973, -1081, -1193, -1308, -1427,
+    -1549, -1677, -1809, -1948, -2093, -2245, -2406, -2578, -2762, -2960,
+    -3176, -3414, -3681, -3987, -4348, -4793, -5388, -5500, -5500
+};
+#elif defined BATTMAN_4_1
+static const int16_t thermistorBoardTable[THERMISTOR_TABLE_SIZE] = {
+    -5500, -5500, -5388, -4793, -4348, -3987, -3681, -3414, -3176, -2960,
+    -2762, -2578, -2406, -2245, -2093, -1948, -1809, -1677, -1549, -1427,
+    -1308, -1193, -1081, -973, -867, -764, -663, -564, -467, -372,
+    -279, -187, -96, -7, 81, 168, 254, 339, 423, 507,
+    590, 672, 753, 835, 915, 995, 1075, 1155, 1234, 1313,
+    1392, 1470, 1549, 1628, 1706, 1785, 1863, 1942, 2021, 2100,
+    2179, 2259, 2339, 2419, 2500, 2581, 2663, 2745, 2828, 2911,
+    2995, 3080, 3165, 3251, 3339, 3427, 3516, 3606, 3697, 3790,
+    3884, 3979, 4076, 4174, 4273, 4375, 4478, 4584, 4691, 4801,
+    4913, 5027, 5144, 5264, 5387, 5514, 5644, 5778, 5915, 6058,
+    6205, 6357, 6515, 6679, 6850, 7028, 7214, 7409, 7614, 7831,
+    8059, 8302, 8561, 8839, 9137, 9461, 9813, 10201, 10631, 11115,
+    11665, 12303, 13059, 13984, 15000, 15000, 15000, 15000, 15000
+};
+static const int16_t thermistorBatteryTable[THERMISTOR_TABLE_SIZE] = {
+    15000, 15000, 15000, 15000, 15000, 13984, 13059, 12303, 11665, 11115,
+    10631, 10201, 9813, 9461, 9137, 8839, 8561, 8302, 8059, 7831,
+    7614, 7409, 7214, 7028, 6850, 6679, 6515, 6357, 6205, 6058,
+    5915, 5778, 5644, 5514, 5387, 5264, 5144, 5027, 4913, 4801,
+    4691, 4584, 4478, 4375, 4273, 4174, 4076, 3979, 3884, 3790,
+    3697, 3606, 3516, 3427, 3339, 3251, 3165, 3080, 2995, 2911,
+    2828, 2745, 2663, 2581, 2500, 2419, 2339, 2259, 2179, 2100,
+    2021, 1942, 1863, 1785, 1706, 1628, 1549, 1470, 1392, 1313,
+    1234, 1155, 1075, 995, 915, 835, 753, 672, 590, 507,
+    423, 339, 254, 168, 81, -7, -96, -187, -279, -372,
+    -467, -564, -663, -764, -867, -973, -1081, -1193, -1308, -1427,
+    -1549, -1677, -1809, -1948, -2093, -2245, -2406, -2578, -2762, -2960,
+    -3176, -3414, -3681, -3987, -4348, -4793, -5388, -5500, -5500
+};
+#elif defined BATTMAN_4_2
+static const int16_t thermistorBoardTable[THERMISTOR_TABLE_SIZE] = {
+    -5500, -5500, -5388, -4793, -4348, -3987, -3681, -3414, -3176, -2960,
+    -2762, -2578, -2406, -2245, -2093, -1948, -1809, -1677, -1549, -1427,
+    -1308, -1193, -1081, -973, -867, -764, -663, -564, -467, -372,
+    -279, -187, -96, -7, 81, 168, 254, 339, 423, 507,
+    590, 672, 753, 835, 915, 995, 1075, 1155, 1234, 1313,
+    1392, 1470, 1549, 1628, 1706, 1785, 1863, 1942, 2021, 2100,
+    2179, 2259, 2339, 2419, 2500, 2581, 2663, 2745, 2828, 2911,
+    2995, 3080, 3165, 3251, 3339, 3427, 3516, 3606, 3697, 3790,
+    3884, 3979, 4076, 4174, 4273, 4375, 4478, 4584, 4691, 4801,
+    4913, 5027, 5144, 5264, 5387, 5514, 5644, 5778, 5915, 6058,
+    6205, 6357, 6515, 6679, 6850, 7028, 7214, 7409, 7614, 7831,
+    8059, 8302, 8561, 8839, 9137, 9461, 9813, 10201, 10631, 11115,
+    11665, 12303, 13059, 13984, 15000, 15000, 15000, 15000, 15000
+};
+static const int16_t thermistorBatteryTable[THERMISTOR_TABLE_SIZE] = {
+    15000, 15000, 15000, 15000, 15000, 13984, 13059, 12303, 11665, 11115,
+    10631, 10201, 9813, 9461, 9137, 8839, 8561, 8302, 8059, 7831,
+    7614, 7409, 7214, 7028, 6850, 6679, 6515, 6357, 6205, 6058,
+    5915, 5778, 5644, 5514, 5387, 5264, 5144, 5027, 4913, 4801,
+    4691, 4584, 4478, 4375, 4273, 4174, 4076, 3979, 3884, 3790,
+    3697, 3606, 3516, 3427, 3339, 3251, 3165, 3080, 2995, 2911,
+    2828, 2745, 2663, 2581, 2500, 2419, 2339, 2259, 2179, 2100,
+    2021, 1942, 1863, 1785, 1706, 1628, 1549, 1470, 1392, 1313,
+    1234, 1155, 1075, 995, 915, 835, 753, 672, 590, 507,
+    423, 339, 254, 168, 81, -7, -96, -187, -279, -372,
+    -467, -564, -663, -764, -867, -973, -1081, -1193, -1308, -1427,
+    -1549, -1677, -1809, -1948, -2093, -2245, -2406, -2578, -2762, -2960,
+    -3176, -3414, -3681, -3987, -4348, -4793, -5388, -5500, -5500
+};
+#else
+#error "No thermistor table for this board, add its NTC parameters to its hw_conf"
+#endif
+
+#endif /* _THERMISTOR_TABLE_H_ */
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+#
+# Generates thermistor_table.h from the thermistor parameters of the
+# hw_conf_v*.h files given on the command line. Each table gives the
+# temperature in 0.01 degree C for the output of the divider as a fraction of
+# its reference, sampled every 2^SHIFT steps of a 16 bit fraction. The
+# firmware interpolates between the entries, see thermistor.c.
+#
+# Usage: tools/thermistor_table.py hw_conf_v4.0.h ... > thermistor_table.h
+#
+
+import math
+import os
+import re
+import sys
+
+RATIO_BITS = 16 # THERMISTOR_RATIO_BITS of thermistor.h
+SHIFT = 9
+SIZE = (1 << (RATIO_BITS - SHIFT)) + 1
+
+# Beyond these the sensor is open or shorted, the entries are clamped
+T_MIN = -55.0
+T_MAX = 150.0
+
+THERMISTORS = [('BOARD_NTC', 'thermistorBoardTable'),
+               ('BATT_NTC', 'thermistorBatteryTable')]
+
+
+def parse_defines(path):
+    defines = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r'\s*#define\s+(\w+)\s+([-+0-9.eE]+)\b', line)
+            if m:
+                defines[m.group(1)] = float(m.group(2))
+    return defines
+
+
+def temperature(ratio, r25, b, divider, low_side):
+    if not low_side:
+        ratio = 1.0 - ratio
+    if ratio <= 0.0:
+        return T_MAX
+    if ratio >= 1.0:
+        return T_MIN
+    r = divider * ratio / (1.0 - ratio)
+    t = 1.0 / (math.log(r / r25) / b + 1.0 / 298.15) - 273.15
+    return min(max(t, T_MIN), T_MAX)
+
+
+def table(defines, prefix):
+    r25 = defines[prefix + '_R25']
+    b = defines[prefix + '_B']
+    divider = defines[prefix + '_DIVIDER_R']
+    low_side = defines[prefix + '_LOW_SIDE'] != 0
+    return [int(round(100.0 * temperature(float(i << SHIFT) / (1 << RATIO_BITS),
+                                          r25, b, divider, low_side)))
+            for i in range(SIZE)]
+
+
+def emit_table(name, values):
+    out = ['static const int16_t %s[THERMISTOR_TABLE_SIZE] = {' % name]
+    for i in range(0, len(values), 10):
+        out.append('    ' + ', '.join('%d' % v for v in values[i:i + 10]) + ',')
+    out[-1] = out[-1].rstrip(',')
+    out.append('};')
+    return out
+
+
+def main(paths):
+    out = ['// Generated by tools/thermistor_table.py from the hw_conf_v*.h files, do',
+           '// not edit',
+           '',
+           '#ifndef _THERMISTOR_TABLE_H_',
+           '#define _THERMISTOR_TABLE_H_',
+           '',
+           '#define THERMISTOR_TABLE_SHIFT %d' % SHIFT,
+           '#define THERMISTOR_TABLE_SIZE %d' % SIZE,
+           '']
+    first = True
+    for path in sorted(paths):
+        defines = parse_defines(path)
+        if not all(p + '_R25' in defines for p, _ in THERMISTORS):
+            continue
+        version = re.search(r'hw_conf_v(\d+)\.(\d+)\.h$', os.path.basename(path))
+        out.append('#%s defined BATTMAN_%s_%s' % ('if' if first else 'elif',
+                                                   version.group(1), version.group(2)))
+        first = False
+        for prefix, name in THERMISTORS:
+            out += emit_table(name, table(defines, prefix))
+    if not first:
+        out.append('#else')
+        out.append('#error "No thermistor table for this board, add its NTC parameters to its hw_conf"')
+        out.append('#endif')
+        out.append('')
+    out.append('#endif /* _THERMISTOR_TABLE_H_ */')
+    sys.stdout.write('\n'.join(out) + '\n')
+
+
+if __name__ == '__main__':
+    main(sys.argv[1:])